@@ -0,0 +1,120 @@
+#pragma once
+
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+// Benchmark.
+// Collects samples of named values over a fixed number of frames. Results are printed and appended to Benchmark.csv on destruction.
+class Benchmark {
+public:
+    // Constructor.
+    // name Configuration name written with each result.
+    // frameCount Number of frames to measure, zero disables benchmark.
+    Benchmark(const std::string& name, unsigned int frameCount)
+    {
+        mName = name;
+        mFrameCount = frameCount;
+        mFrame = 0;
+    }
+
+    // Destructor.
+    ~Benchmark()
+    {
+        if (mValueList.empty())
+            return;
+
+        // Latest baseline means from earlier runs.
+        std::vector<std::pair<std::string, double>> baselineList;
+        if (!mBaseline.empty())
+        {
+            std::ifstream baselineStream("Benchmark.csv");
+            std::string line;
+            while (std::getline(baselineStream, line))
+            {
+                std::stringstream lineStream(line);
+                std::string name, key, mean;
+                std::getline(lineStream, name, ',');
+                std::getline(lineStream, key, ',');
+                std::getline(lineStream, mean, ',');
+                if (name == mBaseline)
+                    baselineList.push_back({ key, std::atof(mean.c_str()) });
+            }
+        }
+
+        std::ofstream fileStream("Benchmark.csv", std::ios::app);
+        std::cout << "+++ Benchmark: " << mName << " (" << mFrame << " frames) +++" << std::endl;
+        for (Value& value : mValueList)
+        {
+            double mean = value.sum / value.count;
+            std::cout << value.key << " : mean " << mean << " | min " << value.min << " | max " << value.max;
+            auto it = std::find_if(baselineList.rbegin(), baselineList.rend(), [&value](const std::pair<std::string, double>& baseline) { return baseline.first == value.key; });
+            if (it != baselineList.rend() && it->second > 0.0)
+                std::cout << " | " << (1.0 - mean / it->second) * 100.0 << "% lower than " << mBaseline;
+            std::cout << std::endl;
+            fileStream << mName << "," << value.key << "," << mean << "," << value.min << "," << value.max << "," << value.count << "\n";
+        }
+        std::cout << "--- Benchmark ---" << std::endl;
+    }
+
+    // Compare means with latest results of other configuration in Benchmark.csv.
+    // name Configuration name of baseline.
+    void SetBaseline(const std::string& name)
+    {
+        mBaseline = name;
+    }
+
+    // Whether benchmark is measuring.
+    bool Enabled() const
+    {
+        return mFrameCount > 0 && mFrame < mFrameCount;
+    }
+
+    // Add sample of value.
+    // key Name of value.
+    // sample Sampled value.
+    void Sample(const std::string& key, double sample)
+    {
+        if (!Enabled())
+            return;
+
+        auto it = std::find_if(mValueList.begin(), mValueList.end(), [&key](const Value& value) { return value.key == key; });
+        if (it == mValueList.end())
+        {
+            mValueList.push_back({ key, 0.0, sample, sample, 0 });
+            it = mValueList.end() - 1;
+        }
+        it->sum += sample;
+        it->min = (std::min)(it->min, sample);
+        it->max = (std::max)(it->max, sample);
+        ++it->count;
+    }
+
+    // End measured frame.
+    // Returns whether all frames are measured.
+    bool EndFrame()
+    {
+        if (Enabled())
+            ++mFrame;
+        return mFrameCount > 0 && mFrame >= mFrameCount;
+    }
+
+private:
+    struct Value
+    {
+        std::string key;
+        double sum;
+        double min;
+        double max;
+        unsigned int count;
+    };
+    std::vector<Value> mValueList;
+    std::string mName;
+    std::string mBaseline;
+    unsigned int mFrameCount;
+    unsigned int mFrame;
+};
@@ -0,0 +1,167 @@
+#include "ComputePipeline.hpp"
+#include "vkTools.hpp"
+
+#include <assert.h>
+#include <algorithm>
+
+ComputePipeline::ComputePipeline(VkDevice device, const char* shaderPath, const std::vector<VkDescriptorType>& descriptorTypeList, const std::vector<uint32_t>& specializationList, unsigned int descriptorSetCount)
+{
+    mDevice = device;
+    mDescriptorTypeList = descriptorTypeList;
+
+    vkTools::CreateShaderModule(mDevice, shaderPath, mShaderModule);
+
+    std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList(mDescriptorTypeList.size());
+    for (std::size_t i = 0; i < mDescriptorTypeList.size(); ++i)
+    {
+        VkDescriptorSetLayoutBinding& descriptorSetLayoutBinding = descriptorSetLayoutBindingList[i];
+        descriptorSetLayoutBinding.descriptorCount = 1;
+        descriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+        descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        descriptorSetLayoutBinding.descriptorType = mDescriptorTypeList[i];
+        descriptorSetLayoutBinding.binding = static_cast<uint32_t>(i);
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = 0;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = descriptorSetLayoutBindingList.size();
+    descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindingList.data();
+    vkTools::VkErrorCheck(vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, nullptr, &mDescriptorSetLayout));
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = NULL;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &mDescriptorSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+    pipelineLayoutCreateInfo.pPushConstantRanges = NULL;
+    vkTools::VkErrorCheck(vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout));
+
+    // Sets are typically bound with each state of a triple buffered swap buffer.
+    mDescriptorSetCache = new DescriptorSetCache(mDevice, mDescriptorSetLayout, mDescriptorTypeList, 4 * descriptorSetCount);
+    DescriptorSetCache::Descriptor emptyDescriptor = DescriptorSetCache::BufferDescriptor(VK_NULL_HANDLE);
+    mDescriptorList.assign(descriptorSetCount, std::vector<DescriptorSetCache::Descriptor>(mDescriptorTypeList.size(), emptyDescriptor));
+    mDescriptorSetList.assign(descriptorSetCount, VK_NULL_HANDLE);
+    mRangeList.assign(mDescriptorTypeList.size(), VK_WHOLE_SIZE);
+    for (std::size_t i = 0; i < mDescriptorTypeList.size(); ++i)
+        if (mDescriptorTypeList[i] == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || mDescriptorTypeList[i] == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+            mDynamicBindingList.push_back(static_cast<uint32_t>(i));
+    mDynamicOffsetList.assign(mDynamicBindingList.size(), 0);
+
+    // Specialization constant i is read from word i.
+    std::vector<VkSpecializationMapEntry> specializationMapEntryList(specializationList.size());
+    for (std::size_t i = 0; i < specializationList.size(); ++i)
+    {
+        specializationMapEntryList[i].constantID = static_cast<uint32_t>(i);
+        specializationMapEntryList[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+        specializationMapEntryList[i].size = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specializationInfo;
+    specializationInfo.mapEntryCount = specializationMapEntryList.size();
+    specializationInfo.pMapEntries = specializationMapEntryList.data();
+    specializationInfo.dataSize = specializationList.size() * sizeof(uint32_t);
+    specializationInfo.pData = specializationList.data();
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo;
+    computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineCreateInfo.pNext = NULL;
+    computePipelineCreateInfo.flags = 0;
+    computePipelineCreateInfo.stage = vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mShaderModule, VK_SHADER_STAGE_COMPUTE_BIT, "main");
+    computePipelineCreateInfo.stage.pSpecializationInfo = specializationList.empty() ? NULL : &specializationInfo;
+    computePipelineCreateInfo.layout = mPipelineLayout;
+    computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    computePipelineCreateInfo.basePipelineIndex = NULL;
+    vkTools::VkErrorCheck(vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &mPipeline));
+}
+
+ComputePipeline::~ComputePipeline()
+{
+    vkDestroyShaderModule(mDevice, mShaderModule, nullptr);
+
+    vkDestroyPipeline(mDevice, mPipeline, nullptr);
+    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+    delete mDescriptorSetCache;
+    vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+}
+
+void ComputePipeline::UpdateDescriptorSet(const std::vector<VkBuffer>& bufferList, unsigned int descriptorSet)
+{
+    assert(bufferList.size() <= mDescriptorTypeList.size());
+    assert(descriptorSet < mDescriptorSetList.size());
+
+    std::vector<DescriptorSetCache::Descriptor>& descriptorList = mDescriptorList[descriptorSet];
+    for (std::size_t i = 0; i < bufferList.size(); ++i)
+    {
+        if (descriptorList[i].buffer == bufferList[i] && descriptorList[i].range == mRangeList[i])
+            continue;
+        descriptorList[i] = DescriptorSetCache::BufferDescriptor(bufferList[i], mRangeList[i]);
+        mDescriptorSetList[descriptorSet] = VK_NULL_HANDLE;
+    }
+}
+
+void ComputePipeline::SetDynamicUniform(uint32_t binding, VkDeviceSize range, uint32_t offset)
+{
+    assert(binding < mDescriptorTypeList.size());
+    assert(mDescriptorTypeList[binding] == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || mDescriptorTypeList[binding] == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+
+    mRangeList[binding] = range;
+    for (std::size_t i = 0; i < mDynamicBindingList.size(); ++i)
+        if (mDynamicBindingList[i] == binding)
+            mDynamicOffsetList[i] = offset;
+}
+
+void ComputePipeline::InvalidateDescriptorSets()
+{
+    mDescriptorSetCache->Clear();
+    mDescriptorSetList.assign(mDescriptorSetList.size(), VK_NULL_HANDLE);
+}
+
+void ComputePipeline::UpdateImageDescriptor(uint32_t binding, VkImageView imageView, VkSampler sampler, unsigned int descriptorSet)
+{
+    assert(binding < mDescriptorTypeList.size());
+    assert(mDescriptorTypeList[binding] == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    assert(descriptorSet < mDescriptorSetList.size());
+
+    DescriptorSetCache::Descriptor& descriptor = mDescriptorList[descriptorSet][binding];
+    if (descriptor.imageView == imageView && descriptor.sampler == sampler)
+        return;
+    descriptor.buffer = VK_NULL_HANDLE;
+    descriptor.range = 0;
+    descriptor.imageView = imageView;
+    descriptor.sampler = sampler;
+    mDescriptorSetList[descriptorSet] = VK_NULL_HANDLE;
+}
+
+void ComputePipeline::Dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ, unsigned int descriptorSet)
+{
+    Bind(commandBuffer, descriptorSet);
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+void ComputePipeline::DispatchLinear(VkCommandBuffer commandBuffer, uint32_t groupCount, unsigned int descriptorSet)
+{
+    // Fewest rows, evenly filled, so few groups are past the range.
+    uint32_t groupCountY = (std::max)((groupCount + mMaxGroupCount - 1) / mMaxGroupCount, 1u);
+    Dispatch(commandBuffer, (groupCount + groupCountY - 1) / groupCountY, groupCountY, 1, descriptorSet);
+}
+
+void ComputePipeline::DispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, unsigned int descriptorSet)
+{
+    Bind(commandBuffer, descriptorSet);
+    vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+}
+
+void ComputePipeline::Bind(VkCommandBuffer commandBuffer, unsigned int descriptorSet)
+{
+    assert(descriptorSet < mDescriptorSetList.size());
+
+    if (mDescriptorSetList[descriptorSet] == VK_NULL_HANDLE)
+        mDescriptorSetList[descriptorSet] = mDescriptorSetCache->Get(mDescriptorList[descriptorSet]);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &mDescriptorSetList[descriptorSet], mDynamicOffsetList.size(), mDynamicOffsetList.data());
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "DescriptorSetCache.hpp"
+
+// Compute shader with pipeline, layout and descriptor sets.
+class ComputePipeline
+{
+    public:
+        // Constructor.
+        // device Vulkan device.
+        // shaderPath Path to compiled SPIR-V shader.
+        // descriptorTypeList Type of each descriptor, in binding order.
+        // specializationList Value of each specialization constant, in constant id order. DEFAULT [{}]
+        // descriptorSetCount Number of descriptor sets that may be updated independently. DEFAULT [1]
+        ComputePipeline(VkDevice device, const char* shaderPath, const std::vector<VkDescriptorType>& descriptorTypeList, const std::vector<uint32_t>& specializationList = {}, unsigned int descriptorSetCount = 1);
+
+        // Destructor.
+        ~ComputePipeline();
+
+        // Set storage buffer descriptors. Whole buffer is bound.
+        // Resources select a cached descriptor set when bound, written only first time the combination is seen.
+        // bufferList Buffer of each binding, in binding order.
+        // descriptorSet Index of descriptor set to update. DEFAULT [0]
+        void UpdateDescriptorSet(const std::vector<VkBuffer>& bufferList, unsigned int descriptorSet = 0);
+
+        // Set block of dynamic buffer binding, at offset applied whenever pipeline is bound. Set before buffer of binding is updated.
+        // binding Binding of descriptor, of type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC or VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC.
+        // range Size of block in bytes.
+        // offset Offset of block in bytes.
+        void SetDynamicUniform(uint32_t binding, VkDeviceSize range, uint32_t offset);
+
+        // Forget cached descriptor sets. Call when a bound buffer is destroyed, its handle may be reused.
+        void InvalidateDescriptorSets();
+
+        // Set combined image sampler descriptor. Image must be in shader read only layout.
+        // binding Binding of descriptor, of type VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER.
+        // imageView Image view to sample.
+        // sampler Sampler.
+        // descriptorSet Index of descriptor set to update. DEFAULT [0]
+        void UpdateImageDescriptor(uint32_t binding, VkImageView imageView, VkSampler sampler, unsigned int descriptorSet = 0);
+
+        // Bind pipeline and dispatch.
+        // commandBuffer Command buffer to record.
+        // groupCountX Number of work groups in X.
+        // groupCountY Number of work groups in Y. DEFAULT [1]
+        // groupCountZ Number of work groups in Z. DEFAULT [1]
+        // descriptorSet Index of descriptor set to bind. DEFAULT [0]
+        void Dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1, unsigned int descriptorSet = 0);
+
+        // Bind pipeline and dispatch a range of work groups, split over X and Y so neither exceeds mMaxGroupCount.
+        // Shaders index work groups as gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x, and skip indices past groupCount.
+        // commandBuffer Command buffer to record.
+        // groupCount Number of work groups.
+        // descriptorSet Index of descriptor set to bind. DEFAULT [0]
+        void DispatchLinear(VkCommandBuffer commandBuffer, uint32_t groupCount, unsigned int descriptorSet = 0);
+
+        // Bind pipeline and dispatch with group count read from buffer.
+        // commandBuffer Command buffer to record.
+        // buffer Buffer holding VkDispatchIndirectCommand.
+        // offset Offset of command in bytes.
+        // descriptorSet Index of descriptor set to bind. DEFAULT [0]
+        void DispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, unsigned int descriptorSet = 0);
+
+        // Work group count of each dimension supported by every device, minimum of maxComputeWorkGroupCount.
+        static const uint32_t mMaxGroupCount = 65535;
+
+        VkPipeline mPipeline;
+        VkPipelineLayout mPipelineLayout;
+
+    private:
+        void Bind(VkCommandBuffer commandBuffer, unsigned int descriptorSet);
+
+        VkDevice mDevice;
+
+        VkShaderModule mShaderModule;
+
+        std::vector<VkDescriptorType> mDescriptorTypeList;
+        VkDescriptorSetLayout mDescriptorSetLayout;
+        DescriptorSetCache* mDescriptorSetCache;
+
+        // Resources of each binding of each set, and cached set of them. VK_NULL_HANDLE when resources changed since bound.
+        std::vector<std::vector<DescriptorSetCache::Descriptor>> mDescriptorList;
+        std::vector<VkDescriptorSet> mDescriptorSetList;
+
+        // Block size of each binding, and offset of each dynamic binding in binding order.
+        std::vector<VkDeviceSize> mRangeList;
+        std::vector<uint32_t> mDynamicBindingList;
+        std::vector<uint32_t> mDynamicOffsetList;
+};
@@ -0,0 +1,150 @@
+#include "DescriptorSetCache.hpp"
+#include "vkTools.hpp"
+
+#include <assert.h>
+#include <tuple>
+
+unsigned int DescriptorSetCache::sWriteCount = 0;
+
+bool DescriptorSetCache::Descriptor::operator==(const Descriptor& other) const
+{
+    return buffer == other.buffer && range == other.range && imageView == other.imageView && sampler == other.sampler;
+}
+
+bool DescriptorSetCache::Descriptor::operator<(const Descriptor& other) const
+{
+    return std::tie(buffer, range, imageView, sampler) < std::tie(other.buffer, other.range, other.imageView, other.sampler);
+}
+
+DescriptorSetCache::DescriptorSetCache(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, const std::vector<VkDescriptorType>& descriptorTypeList, unsigned int poolSetCount)
+{
+    assert(poolSetCount > 0);
+    mDevice = device;
+    mDescriptorSetLayout = descriptorSetLayout;
+    mDescriptorTypeList = descriptorTypeList;
+    mPoolSetCount = poolSetCount;
+    mAllocatedSetCount = 0;
+    CreatePool();
+}
+
+DescriptorSetCache::~DescriptorSetCache()
+{
+    // Sets are freed with their pool.
+    for (VkDescriptorPool descriptorPool : mDescriptorPoolList)
+        vkDestroyDescriptorPool(mDevice, descriptorPool, nullptr);
+}
+
+VkDescriptorSet DescriptorSetCache::Get(const std::vector<Descriptor>& descriptorList)
+{
+    assert(descriptorList.size() <= mDescriptorTypeList.size());
+
+    auto it = mDescriptorSetMap.find(descriptorList);
+    if (it != mDescriptorSetMap.end())
+        return it->second;
+
+    if (mAllocatedSetCount == mPoolSetCount)
+        CreatePool();
+
+    VkDescriptorSet descriptorSet;
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.pNext = NULL;
+    descriptorSetAllocateInfo.descriptorPool = mDescriptorPoolList.back();
+    descriptorSetAllocateInfo.pSetLayouts = &mDescriptorSetLayout;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    vkTools::VkErrorCheck(vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &descriptorSet));
+    ++mAllocatedSetCount;
+
+    std::vector<VkDescriptorBufferInfo> descriptorBufferInfoList(descriptorList.size());
+    std::vector<VkDescriptorImageInfo> descriptorImageInfoList(descriptorList.size());
+    std::vector<VkWriteDescriptorSet> writeDescriptorSetList;
+    for (std::size_t i = 0; i < descriptorList.size(); ++i)
+    {
+        const Descriptor& descriptor = descriptorList[i];
+        VkWriteDescriptorSet writeDescriptorSet;
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.pNext = NULL;
+        writeDescriptorSet.dstSet = descriptorSet;
+        writeDescriptorSet.dstArrayElement = 0;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = mDescriptorTypeList[i];
+        writeDescriptorSet.pImageInfo = NULL;
+        writeDescriptorSet.pTexelBufferView = NULL;
+        writeDescriptorSet.dstBinding = static_cast<uint32_t>(i);
+        writeDescriptorSet.pBufferInfo = NULL;
+        if (descriptor.buffer != VK_NULL_HANDLE)
+        {
+            VkDescriptorBufferInfo& descriptorBufferInfo = descriptorBufferInfoList[i];
+            descriptorBufferInfo.buffer = descriptor.buffer;
+            descriptorBufferInfo.offset = 0;
+            descriptorBufferInfo.range = descriptor.range;
+            writeDescriptorSet.pBufferInfo = &descriptorBufferInfo;
+        }
+        else if (descriptor.imageView != VK_NULL_HANDLE)
+        {
+            // Storage images are written in general layout, sampled images are read only.
+            VkDescriptorImageInfo& descriptorImageInfo = descriptorImageInfoList[i];
+            descriptorImageInfo.sampler = descriptor.sampler;
+            descriptorImageInfo.imageView = descriptor.imageView;
+            descriptorImageInfo.imageLayout = mDescriptorTypeList[i] == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            writeDescriptorSet.pImageInfo = &descriptorImageInfo;
+        }
+        else
+            continue;
+        writeDescriptorSetList.push_back(writeDescriptorSet);
+    }
+    vkUpdateDescriptorSets(mDevice, writeDescriptorSetList.size(), writeDescriptorSetList.data(), 0, NULL);
+    sWriteCount += (unsigned int)writeDescriptorSetList.size();
+
+    mDescriptorSetMap[descriptorList] = descriptorSet;
+    return descriptorSet;
+}
+
+void DescriptorSetCache::Clear()
+{
+    mDescriptorSetMap.clear();
+}
+
+unsigned int DescriptorSetCache::GetWriteCount()
+{
+    return sWriteCount;
+}
+
+DescriptorSetCache::Descriptor DescriptorSetCache::BufferDescriptor(VkBuffer buffer, VkDeviceSize range)
+{
+    Descriptor descriptor;
+    descriptor.buffer = buffer;
+    descriptor.range = range;
+    descriptor.imageView = VK_NULL_HANDLE;
+    descriptor.sampler = VK_NULL_HANDLE;
+    return descriptor;
+}
+
+void DescriptorSetCache::CreatePool()
+{
+    std::map<VkDescriptorType, uint32_t> descriptorTypeCountMap;
+    for (VkDescriptorType descriptorType : mDescriptorTypeList)
+        descriptorTypeCountMap[descriptorType] += mPoolSetCount;
+
+    std::vector<VkDescriptorPoolSize> descriptorPoolSizeList;
+    for (auto& it : descriptorTypeCountMap)
+    {
+        VkDescriptorPoolSize descriptorPoolSize;
+        descriptorPoolSize.type = it.first;
+        descriptorPoolSize.descriptorCount = it.second;
+        descriptorPoolSizeList.push_back(descriptorPoolSize);
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.pNext = NULL;
+    descriptorPoolCreateInfo.flags = 0;
+    descriptorPoolCreateInfo.maxSets = mPoolSetCount;
+    descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizeList.data();
+    descriptorPoolCreateInfo.poolSizeCount = descriptorPoolSizeList.size();
+
+    VkDescriptorPool descriptorPool;
+    vkTools::VkErrorCheck(vkCreateDescriptorPool(mDevice, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
+    mDescriptorPoolList.push_back(descriptorPool);
+    mAllocatedSetCount = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+
+// Descriptor sets of one layout, each written once for a combination of bound resources and reused after.
+// Sets are never rewritten, so a set may be bound while an earlier command buffer binding it executes.
+class DescriptorSetCache
+{
+    public:
+        // Resource of one binding. Buffer and range of buffer descriptors, image view and sampler of image descriptors.
+        struct Descriptor
+        {
+            VkBuffer buffer;
+            VkDeviceSize range;
+            VkImageView imageView;
+            VkSampler sampler;
+            bool operator==(const Descriptor& other) const;
+            bool operator<(const Descriptor& other) const;
+        };
+
+        // Constructor.
+        // device Vulkan device.
+        // descriptorSetLayout Layout of sets.
+        // descriptorTypeList Type of each descriptor of layout, in binding order.
+        // poolSetCount Number of sets of each descriptor pool, more pools are created when full.
+        DescriptorSetCache(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, const std::vector<VkDescriptorType>& descriptorTypeList, unsigned int poolSetCount);
+
+        // Destructor.
+        ~DescriptorSetCache();
+
+        // Get set of resources, allocated and written first time combination is seen.
+        // descriptorList Resource of each binding, in binding order. Bindings without resource are not written.
+        VkDescriptorSet Get(const std::vector<Descriptor>& descriptorList);
+
+        // Forget sets, so later gets allocate new ones. Call when a bound resource is destroyed, its handle may be reused.
+        // Sets stay allocated until cache is destroyed, as recorded command buffers may still bind them.
+        void Clear();
+
+        // Number of descriptors written by every cache since start.
+        static unsigned int GetWriteCount();
+
+        // Buffer descriptor.
+        // buffer Buffer to bind.
+        // range Size of bound block in bytes, dynamic buffers are bound at offsets given when set is bound. DEFAULT [VK_WHOLE_SIZE]
+        static Descriptor BufferDescriptor(VkBuffer buffer, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    private:
+        void CreatePool();
+
+        VkDevice mDevice;
+        VkDescriptorSetLayout mDescriptorSetLayout;
+        std::vector<VkDescriptorType> mDescriptorTypeList;
+
+        unsigned int mPoolSetCount;
+        // Sets allocated from last pool.
+        unsigned int mAllocatedSetCount;
+        std::vector<VkDescriptorPool> mDescriptorPoolList;
+
+        std::map<std::vector<Descriptor>, VkDescriptorSet> mDescriptorSetMap;
+
+        static unsigned int sWriteCount;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "Particle.hpp"
+
+// Golden state.
+// Compares particle states slot by slot, against a reference update or a snapshot of an earlier run.
+// Positions and velocities are compared, colors are not as synthetic load accumulates rounding of its loop.
+class GoldenState {
+public:
+    // Constructor.
+    // absoluteTolerance Components this close are equal, for values near zero. DEFAULT [1e-4]
+    // ulpTolerance Components this few representable floats apart are equal. DEFAULT [64]
+    GoldenState(float absoluteTolerance = 1e-4f, unsigned int ulpTolerance = 64)
+    {
+        mAbsoluteTolerance = absoluteTolerance;
+        mUlpTolerance = ulpTolerance;
+    }
+
+    // Compare state with reference and print report.
+    // name Name of comparison in report.
+    // indexList Slots of alive particles in ascending order.
+    // particleList Particle of each slot.
+    // referenceIndexList Slots of reference.
+    // referenceParticleList Particles of reference.
+    // Returns whether alive slots are equal and every component is within tolerance.
+    bool Compare(const std::string& name, const std::vector<uint32_t>& indexList, const std::vector<Particle>& particleList,
+        const std::vector<uint32_t>& referenceIndexList, const std::vector<Particle>& referenceParticleList) const
+    {
+        const unsigned int maxReportCount = 8;
+        const char* componentName[] = { "position.x", "position.y", "position.z", "lifetime", "velocity.x", "velocity.y", "velocity.z", "mass" };
+
+        std::cout << "+++ Golden state: " << name << " +++" << std::endl;
+        bool equal = indexList == referenceIndexList;
+        if (!equal)
+            std::cout << "Alive particles : " << indexList.size() << " | reference " << referenceIndexList.size() << " | slots differ" << std::endl;
+
+        float maxError = 0.f;
+        uint64_t maxUlps = 0;
+        unsigned int mismatchCount = 0;
+        std::size_t count = (std::min)(particleList.size(), referenceParticleList.size());
+        if (equal)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                float component[8], referenceComponent[8];
+                std::memcpy(component, &particleList[i].position, sizeof(component));
+                std::memcpy(referenceComponent, &referenceParticleList[i].position, sizeof(referenceComponent));
+                bool particleEqual = true;
+                for (unsigned int c = 0; c < 8; ++c)
+                {
+                    float error = std::abs(component[c] - referenceComponent[c]);
+                    uint64_t ulps = UlpDistance(component[c], referenceComponent[c]);
+                    maxError = (std::max)(maxError, error);
+                    // Values near zero are many ulps apart within absolute tolerance.
+                    if (error <= mAbsoluteTolerance)
+                        continue;
+                    maxUlps = (std::max)(maxUlps, ulps);
+                    if (ulps <= mUlpTolerance)
+                        continue;
+                    if (particleEqual && mismatchCount < maxReportCount)
+                        std::cout << "Slot " << indexList[i] << " " << componentName[c] << " : " << component[c] << " | reference " << referenceComponent[c] << " | " << ulps << " ulps" << std::endl;
+                    particleEqual = false;
+                }
+                if (!particleEqual)
+                    ++mismatchCount;
+            }
+            equal = mismatchCount == 0;
+        }
+
+        std::cout << "Particles : " << count << " | mismatches " << mismatchCount << " | max error " << maxError << " | max ulps " << maxUlps << std::endl;
+        std::cout << "--- Golden state: " << (equal ? "PASS" : "FAIL") << " ---" << std::endl;
+        return equal;
+    }
+
+    // Write snapshot file.
+    // path Path of file.
+    // indexList Slots of alive particles in ascending order.
+    // particleList Particle of each slot.
+    // Returns whether file was written.
+    static bool Save(const std::string& path, const std::vector<uint32_t>& indexList, const std::vector<Particle>& particleList)
+    {
+        std::ofstream fileStream(path, std::ios::binary);
+        if (!fileStream)
+            return false;
+        uint32_t header[3] = { mMagic, mVersion, (uint32_t)indexList.size() };
+        fileStream.write((const char*)header, sizeof(header));
+        fileStream.write((const char*)indexList.data(), indexList.size() * sizeof(uint32_t));
+        fileStream.write((const char*)particleList.data(), particleList.size() * sizeof(Particle));
+        return fileStream.good();
+    }
+
+    // Read snapshot file.
+    // path Path of file.
+    // indexList Filled with slots of alive particles.
+    // particleList Filled with particle of each slot.
+    // Returns false if file is missing or invalid.
+    static bool Load(const std::string& path, std::vector<uint32_t>& indexList, std::vector<Particle>& particleList)
+    {
+        std::ifstream fileStream(path, std::ios::binary);
+        if (!fileStream)
+            return false;
+        uint32_t header[3];
+        fileStream.read((char*)header, sizeof(header));
+        if (!fileStream || header[0] != mMagic || header[1] != mVersion)
+            return false;
+        indexList.resize(header[2]);
+        particleList.resize(header[2]);
+        fileStream.read((char*)indexList.data(), indexList.size() * sizeof(uint32_t));
+        fileStream.read((char*)particleList.data(), particleList.size() * sizeof(Particle));
+        return fileStream.good();
+    }
+
+private:
+    // Number of representable floats between a and b, zero for equal values of either sign.
+    static uint64_t UlpDistance(float a, float b)
+    {
+        if (std::isnan(a) || std::isnan(b))
+            return UINT64_MAX;
+        int32_t ia, ib;
+        std::memcpy(&ia, &a, sizeof(float));
+        std::memcpy(&ib, &b, sizeof(float));
+        // Sign magnitude to ordered integers.
+        int64_t oa = ia < 0 ? (int64_t)INT32_MIN - ia : ia;
+        int64_t ob = ib < 0 ? (int64_t)INT32_MIN - ib : ib;
+        return (uint64_t)(oa > ob ? oa - ob : ob - oa);
+    }
+
+    static const uint32_t mMagic = 0x53535047; // "GPSS"
+    static const uint32_t mVersion = 1;
+
+    float mAbsoluteTolerance;
+    unsigned int mUlpTolerance;
+};
@@ -4,8 +4,29 @@
 
 struct Particle
 {
+    // w Remaining lifetime in seconds, 0 for immortal particles.
     glm::vec4 position = glm::vec4(0.f, 0.f, 0.f, 0.f);
+    // w Mass, attracts and is attracted by other particles with ParticleUpdateSystem::MODE_GRAVITY.
     glm::vec4 velocity = glm::vec4(0.f, 0.f, 0.f, 0.f);
     glm::vec4 color = glm::vec4(1.f, 1.f, 1.f, 1.f);
     glm::vec4 scale = glm::vec4(1.f, 1.f, 0.f, 0.f);
 };
+
+// Spawns particles on the GPU. Layout matches Particles_Emit_CS.
+struct ParticleEmitter
+{
+    // xyz Spawn center, w spawn radius.
+    glm::vec4 position = glm::vec4(0.f, 0.f, 0.f, 0.f);
+    // xyz Base velocity, w random speed added in random direction.
+    glm::vec4 velocity = glm::vec4(0.f, 0.f, 0.f, 0.f);
+    glm::vec4 color = glm::vec4(1.f, 1.f, 1.f, 1.f);
+    glm::vec4 scale = glm::vec4(1.f, 1.f, 0.f, 0.f);
+    // Particles spawned per second.
+    float rate = 0.f;
+    // Lifetime of spawned particles in seconds.
+    float lifetime = 1.f;
+    // Particles to spawn this frame, set by ParticleUpdateSystem.
+    unsigned int emitCount = 0;
+    // Random seed of this frame, set by ParticleUpdateSystem.
+    unsigned int seed = 0;
+};
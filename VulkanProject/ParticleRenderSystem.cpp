@@ -3,32 +3,160 @@
 #include "Scene.hpp"
 #include "FrameBuffer.hpp"
 #include "StorageSwapBuffer.hpp"
+#include "StorageColdBuffer.hpp"
 #include "Camera.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include "vkTools.hpp"
+#include "UniformRing.hpp"
+#include "ComputePipeline.hpp"
+#include "PrefixSum.hpp"
+#include <cstddef>
+#include <limits>
 
-ParticleRenderSystem::ParticleRenderSystem(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int width, unsigned int height, VkFormat format, VkRenderPass renderPass)
+// Threads of culling pass. Work groups of 10M particles stay below the guaranteed dispatch limit.
+static const unsigned int gCullWorkGroupSize = 256;
+// Width and height of tiles of tiled blending in pixels, one thread per pixel.
+static const unsigned int gTileSize = 16;
+// Initial bin entries of tiled blending per visible particle, grown when a frame needs more.
+static const unsigned int gTileBinsPerParticle = 4;
+
+ParticleRenderSystem::ParticleRenderSystem(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int width, unsigned int height, VkFormat format, VkRenderPass renderPass, unsigned int frameCount, bool viewBuffer)
 {
+    assert(frameCount > 0);
     mDevice = device;
     mPhysicalDevice = physicalDevice;
     mExtent.width = width;
     mExtent.height = height;
     mFormat = format;
     mRenderPass = renderPass;
+    mFrameCount = frameCount;
+    mFrameIndex = 0;
+    mViewBuffer = viewBuffer;
+    mRenderMode = RENDER_MODE_GEOMETRY_SHADER;
+    mFrustumCulling = false;
+    mPointDiameter = 0.f;
+    mDiscardCoverage = 0.f;
+    mComputeSplatting = false;
+    mTiledBlending = false;
+    mBinCapacity = 0;
+    mBinBuffer = VK_NULL_HANDLE;
+    mBinBufferMemory = VK_NULL_HANDLE;
+    mVisibleCount = 0;
+    mVisibleBuffer = VK_NULL_HANDLE;
+    mVisibleBufferMemory = VK_NULL_HANDLE;
+
+    // Bound even when view is pushed, geometry shader declares both.
+    mUniformRing = new UniformRing(mDevice, mPhysicalDevice, sizeof(MetaData), mFrameCount);
+    mMetaDataOffset = 0;
 
-    // Create meta buffer.
+    // Draw of each render mode and of points. Instance count of quads copied from alive count each frame, or every count written by culling pass.
     uint32_t minOffsetAligment;
-    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(MetaData),
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        mMetaDataBuffer, mMetaDataBufferMemory, minOffsetAligment
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(VkDrawIndirectCommand) * (RENDER_MODE_COUNT + 1),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mDrawArgumentsBuffer, mDrawArgumentsBufferMemory, minOffsetAligment
     );
-    assert(sizeof(MetaData) % minOffsetAligment == 0);
+
+    // Create culling pipeline.
+    {
+        std::vector<VkDescriptorType> descriptorTypeList{
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Particles or positions.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Scales.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Alive indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Indirect arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Visible indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Draw arguments.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Meta data.
+        };
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? 1 : 0;
+            mCullPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Cull_CS.spv", descriptorTypeList, { gCullWorkGroupSize, soa });
+        }
+    }
+
+    // Create splatting pipeline, with red, green and blue of each pixel.
+    {
+        vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * 3 * mExtent.width * mExtent.height,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            mAccumulationBuffer, mAccumulationBufferMemory, minOffsetAligment
+        );
+
+        std::vector<VkDescriptorType> descriptorTypeList{
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Particles or positions.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Colors.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Scales.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Visible indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Draw arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Accumulated color.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Meta data.
+        };
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? 1 : 0;
+            mSplatPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Splat_CS.spv", descriptorTypeList, { gCullWorkGroupSize, soa });
+        }
+    }
+
+    // Create tiled blending pipelines, with tiles covering frame buffer.
+    {
+        mTileCountX = (mExtent.width + gTileSize - 1) / gTileSize;
+        mTileCountY = (mExtent.height + gTileSize - 1) / gTileSize;
+        unsigned int tileCount = mTileCountX * mTileCountY;
+        vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * tileCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            mTileCountBuffer, mTileCountBufferMemory, minOffsetAligment
+        );
+        vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * tileCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            mTileOffsetBuffer, mTileOffsetBufferMemory, minOffsetAligment
+        );
+        // Block sums are scanned in one work group.
+        assert(tileCount <= gTileSize * gTileSize * gTileSize * gTileSize);
+        mTilePrefixSum = new PrefixSum(mDevice, mPhysicalDevice, tileCount, gTileSize * gTileSize);
+
+        // Blocks have the same offset every frame of their region. Bin count precedes overdraw.
+        unsigned int overdrawSize = sizeof(uint32_t) + sizeof(float) * tileCount;
+        mOverdrawRing = new UniformRing(mDevice, mPhysicalDevice, overdrawSize, mFrameCount);
+        mBinCountList.resize(mFrameCount);
+        mOverdrawList.resize(mFrameCount);
+        mOverdrawOffsetList.resize(mFrameCount);
+        mOverdrawFrameList.assign(mFrameCount, -1);
+        for (unsigned int i = 0; i < mFrameCount; ++i)
+        {
+            mOverdrawRing->BeginFrame(i);
+            mBinCountList[i] = static_cast<const uint32_t*>(mOverdrawRing->Reserve(overdrawSize, mOverdrawOffsetList[i]));
+            mOverdrawList[i] = reinterpret_cast<const float*>(mBinCountList[i] + 1);
+        }
+
+        std::vector<VkDescriptorType> descriptorTypeList{
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Particles or positions.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Colors.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Scales.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Visible indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Draw arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Tile counts.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Tile offsets.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Bins.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Accumulated color.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, // Bin count and overdraw.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Meta data.
+        };
+        for (uint32_t pass = 0; pass < 3; ++pass)
+            for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+            {
+                uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? 1 : 0;
+                mTilePipeline[pass][layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Tile_CS.spv", descriptorTypeList, { gTileSize * gTileSize, soa, pass, gTileSize });
+            }
+    }
 
     // Create render pipeline.
     {
         vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Render_VS.spv", mVertexShaderModule);
+        vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Render_Quad_VS.spv", mQuadVertexShaderModule);
         vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Render_GS.spv", mGeometryShaderModule);
         vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Render_PS.spv", mPixelShaderModule);
+        vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Render_Point_VS.spv", mPointVertexShaderModule);
+        vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Render_Point_PS.spv", mPointPixelShaderModule);
 
         VkDescriptorSetLayoutBinding particleBufferSetLayoutBinding;
         particleBufferSetLayoutBinding.descriptorCount = 1;
@@ -36,13 +164,27 @@ ParticleRenderSystem::ParticleRenderSystem(VkDevice device, VkPhysicalDevice phy
         particleBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         particleBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         particleBufferSetLayoutBinding.binding = 0;
+        VkDescriptorSetLayoutBinding aliveBufferSetLayoutBinding;
+        aliveBufferSetLayoutBinding.descriptorCount = 1;
+        aliveBufferSetLayoutBinding.pImmutableSamplers = nullptr;
+        aliveBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        aliveBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        aliveBufferSetLayoutBinding.binding = 1;
+        std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList{ particleBufferSetLayoutBinding, aliveBufferSetLayoutBinding };
+        // Position, color and scale streams of structure of arrays layout.
+        for (uint32_t binding = 2; binding <= 4; ++binding)
+        {
+            VkDescriptorSetLayoutBinding streamBufferSetLayoutBinding = particleBufferSetLayoutBinding;
+            streamBufferSetLayoutBinding.binding = binding;
+            descriptorSetLayoutBindingList.push_back(streamBufferSetLayoutBinding);
+        }
         VkDescriptorSetLayoutBinding metaBufferSetLayoutBinding;
         metaBufferSetLayoutBinding.descriptorCount = 1;
         metaBufferSetLayoutBinding.pImmutableSamplers = nullptr;
-        metaBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_GEOMETRY_BIT;
-        metaBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        metaBufferSetLayoutBinding.binding = 1;
-        std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList{ particleBufferSetLayoutBinding, metaBufferSetLayoutBinding };
+        metaBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+        metaBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        metaBufferSetLayoutBinding.binding = 5;
+        descriptorSetLayoutBindingList.push_back(metaBufferSetLayoutBinding);
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
         descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -53,72 +195,283 @@ ParticleRenderSystem::ParticleRenderSystem(VkDevice device, VkPhysicalDevice phy
         vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, nullptr, &mPipelineDescriptorSetLayout);
 
         std::vector<VkDescriptorSetLayout> descriptorSetLayoutList{ mPipelineDescriptorSetLayout };
+        // Meta data of geometry shader, or of vertex shader of instanced quads, when pushed.
+        VkPushConstantRange pushConstantRange;
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(MetaData);
         VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
         pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutCreateInfo.pNext = NULL;
         pipelineLayoutCreateInfo.flags = 0;
         pipelineLayoutCreateInfo.setLayoutCount = descriptorSetLayoutList.size();
         pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayoutList.data();
-        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-        pipelineLayoutCreateInfo.pPushConstantRanges = NULL;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
         vkTools::VkErrorCheck(vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout));
          
-        VkDescriptorPoolSize descriptorPoolSize;
-        descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorPoolSize.descriptorCount = descriptorSetLayoutBindingList.size();
-        std::vector<VkDescriptorPoolSize> descriptorPoolSizeList{ descriptorPoolSize };
-
-        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
-        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        descriptorPoolCreateInfo.pNext = NULL;
-        descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-        descriptorPoolCreateInfo.maxSets = 1;
-        descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizeList.data();
-        descriptorPoolCreateInfo.poolSizeCount = descriptorPoolSizeList.size();
-        vkTools::VkErrorCheck(vkCreateDescriptorPool(mDevice, &descriptorPoolCreateInfo, nullptr, &mPipelineDescriptorPool));
-
-        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
-        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        descriptorSetAllocateInfo.pNext = NULL;
-        descriptorSetAllocateInfo.descriptorPool = mPipelineDescriptorPool;
-        descriptorSetAllocateInfo.pSetLayouts = &mPipelineDescriptorSetLayout;
-        descriptorSetAllocateInfo.descriptorSetCount = 1;
-        vkTools::VkErrorCheck(vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &mPipelineDescriptorSet));
+        // One set for each state of triple buffered particles in each frame in flight.
+        std::vector<VkDescriptorType> descriptorTypeList;
+        for (const VkDescriptorSetLayoutBinding& descriptorSetLayoutBinding : descriptorSetLayoutBindingList)
+            descriptorTypeList.push_back(descriptorSetLayoutBinding.descriptorType);
+        mPipelineDescriptorSetCache = new DescriptorSetCache(mDevice, mPipelineDescriptorSetLayout, descriptorTypeList, 3 * mFrameCount);
+        mPipelineDescriptorList.resize(descriptorTypeList.size());
 
         std::vector<VkPipelineShaderStageCreateInfo> pipelineShaderStageCreateInfoList{
             vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mVertexShaderModule, VK_SHADER_STAGE_VERTEX_BIT, "main"),
             vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mGeometryShaderModule, VK_SHADER_STAGE_GEOMETRY_BIT, "main"),
             vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mPixelShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT, "main"),
         };
+        std::vector<VkPipelineShaderStageCreateInfo> quadPipelineShaderStageCreateInfoList{
+            vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mQuadVertexShaderModule, VK_SHADER_STAGE_VERTEX_BIT, "main"),
+            vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mPixelShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT, "main"),
+        };
+        std::vector<VkPipelineShaderStageCreateInfo> pointPipelineShaderStageCreateInfoList{
+            vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mPointVertexShaderModule, VK_SHADER_STAGE_VERTEX_BIT, "main"),
+            vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mPointPixelShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT, "main"),
+        };
+
+        // Vertex shader constant 0 selects structure of arrays layout. Geometry shader constant 0, or quad and point vertex shader constant 1, reads view from buffer.
+        VkBool32 viewBuffer = mViewBuffer ? VK_TRUE : VK_FALSE;
+        VkBool32 constantList[2] = { VK_FALSE, viewBuffer };
+        VkSpecializationMapEntry specializationMapEntryList[2];
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            specializationMapEntryList[i].constantID = i;
+            specializationMapEntryList[i].offset = i * sizeof(VkBool32);
+            specializationMapEntryList[i].size = sizeof(VkBool32);
+        }
+        VkSpecializationInfo specializationInfo;
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = specializationMapEntryList;
+        specializationInfo.dataSize = sizeof(VkBool32);
+        specializationInfo.pData = &constantList[0];
+        VkSpecializationInfo geometrySpecializationInfo = specializationInfo;
+        geometrySpecializationInfo.pData = &constantList[1];
+        VkSpecializationInfo quadSpecializationInfo = specializationInfo;
+        quadSpecializationInfo.mapEntryCount = 2;
+        quadSpecializationInfo.dataSize = sizeof(constantList);
+        pipelineShaderStageCreateInfoList[0].pSpecializationInfo = &specializationInfo;
+        pipelineShaderStageCreateInfoList[1].pSpecializationInfo = &geometrySpecializationInfo;
+        quadPipelineShaderStageCreateInfoList[0].pSpecializationInfo = &quadSpecializationInfo;
+        pointPipelineShaderStageCreateInfoList[0].pSpecializationInfo = &quadSpecializationInfo;
+
+        // Constants are read when pipeline is created.
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            constantList[0] = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+            vkTools::CreateGraphicsPipeline(mDevice, mExtent, pipelineShaderStageCreateInfoList, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, VK_FRONT_FACE_CLOCKWISE, mRenderPass, mPipelineLayout, mPipeline[RENDER_MODE_GEOMETRY_SHADER][layout]);
+            vkTools::CreateGraphicsPipeline(mDevice, mExtent, quadPipelineShaderStageCreateInfoList, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_FRONT_FACE_CLOCKWISE, mRenderPass, mPipelineLayout, mPipeline[RENDER_MODE_INSTANCED_QUADS][layout]);
+            vkTools::CreateGraphicsPipeline(mDevice, mExtent, pointPipelineShaderStageCreateInfoList, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, VK_FRONT_FACE_CLOCKWISE, mRenderPass, mPipelineLayout, mPointPipeline[layout]);
+        }
+    }
+
+    // Create resolve pipeline.
+    {
+        vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Splat_Resolve_VS.spv", mResolveVertexShaderModule);
+        vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Splat_Resolve_PS.spv", mResolvePixelShaderModule);
+
+        VkDescriptorSetLayoutBinding accumulationBufferSetLayoutBinding;
+        accumulationBufferSetLayoutBinding.descriptorCount = 1;
+        accumulationBufferSetLayoutBinding.pImmutableSamplers = nullptr;
+        accumulationBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        accumulationBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        accumulationBufferSetLayoutBinding.binding = 0;
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.pNext = 0;
+        descriptorSetLayoutCreateInfo.flags = 0;
+        descriptorSetLayoutCreateInfo.bindingCount = 1;
+        descriptorSetLayoutCreateInfo.pBindings = &accumulationBufferSetLayoutBinding;
+        vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, nullptr, &mResolveDescriptorSetLayout);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCreateInfo.pNext = NULL;
+        pipelineLayoutCreateInfo.flags = 0;
+        pipelineLayoutCreateInfo.setLayoutCount = 1;
+        pipelineLayoutCreateInfo.pSetLayouts = &mResolveDescriptorSetLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+        pipelineLayoutCreateInfo.pPushConstantRanges = NULL;
+        vkTools::VkErrorCheck(vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mResolvePipelineLayout));
+
+        // Accumulation buffer is never replaced, so its set is written once.
+        mResolveDescriptorSetCache = new DescriptorSetCache(mDevice, mResolveDescriptorSetLayout, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER }, 1);
+        mResolveDescriptorSet = mResolveDescriptorSetCache->Get({ DescriptorSetCache::BufferDescriptor(mAccumulationBuffer) });
+
+        std::vector<VkPipelineShaderStageCreateInfo> pipelineShaderStageCreateInfoList{
+            vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mResolveVertexShaderModule, VK_SHADER_STAGE_VERTEX_BIT, "main"),
+            vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mResolvePixelShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT, "main"),
+        };
 
-        vkTools::CreateGraphicsPipeline(mDevice, mExtent, pipelineShaderStageCreateInfoList, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, VK_FRONT_FACE_CLOCKWISE, mRenderPass, mPipelineLayout, mPipeline);
+        // Pixel shader constant 0 is width of frame buffer.
+        uint32_t frameWidth = mExtent.width;
+        VkSpecializationMapEntry specializationMapEntry;
+        specializationMapEntry.constantID = 0;
+        specializationMapEntry.offset = 0;
+        specializationMapEntry.size = sizeof(uint32_t);
+        VkSpecializationInfo specializationInfo;
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &specializationMapEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &frameWidth;
+        pipelineShaderStageCreateInfoList[1].pSpecializationInfo = &specializationInfo;
+
+        vkTools::CreateGraphicsPipeline(mDevice, mExtent, pipelineShaderStageCreateInfoList, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FRONT_FACE_CLOCKWISE, mRenderPass, mResolvePipelineLayout, mResolvePipeline);
     }
 }
 
 ParticleRenderSystem::~ParticleRenderSystem()
 {
-    vkFreeMemory(mDevice, mMetaDataBufferMemory, nullptr);
-    vkDestroyBuffer(mDevice, mMetaDataBuffer, nullptr);
+    delete mUniformRing;
+
+    vkFreeMemory(mDevice, mDrawArgumentsBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mDrawArgumentsBuffer, nullptr);
+
+    DestroyVisibleBuffer();
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        delete mCullPipeline[layout];
+
+    vkFreeMemory(mDevice, mAccumulationBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mAccumulationBuffer, nullptr);
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        delete mSplatPipeline[layout];
+    vkDestroyShaderModule(mDevice, mResolveVertexShaderModule, nullptr);
+    vkDestroyShaderModule(mDevice, mResolvePixelShaderModule, nullptr);
+    vkDestroyPipeline(mDevice, mResolvePipeline, nullptr);
+    vkDestroyPipelineLayout(mDevice, mResolvePipelineLayout, nullptr);
+    delete mResolveDescriptorSetCache;
+    vkDestroyDescriptorSetLayout(mDevice, mResolveDescriptorSetLayout, nullptr);
+
+    vkFreeMemory(mDevice, mTileCountBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mTileCountBuffer, nullptr);
+    vkFreeMemory(mDevice, mTileOffsetBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mTileOffsetBuffer, nullptr);
+    delete mTilePrefixSum;
+    delete mOverdrawRing;
+    for (unsigned int pass = 0; pass < 3; ++pass)
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+            delete mTilePipeline[pass][layout];
 
     vkDestroyShaderModule(mDevice, mVertexShaderModule, nullptr);
+    vkDestroyShaderModule(mDevice, mQuadVertexShaderModule, nullptr);
     vkDestroyShaderModule(mDevice, mGeometryShaderModule, nullptr);
     vkDestroyShaderModule(mDevice, mPixelShaderModule, nullptr);
+    vkDestroyShaderModule(mDevice, mPointVertexShaderModule, nullptr);
+    vkDestroyShaderModule(mDevice, mPointPixelShaderModule, nullptr);
 
-    vkDestroyPipeline(mDevice, mPipeline, nullptr);
+    for (unsigned int renderMode = 0; renderMode < RENDER_MODE_COUNT; ++renderMode)
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+            vkDestroyPipeline(mDevice, mPipeline[renderMode][layout], nullptr);
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        vkDestroyPipeline(mDevice, mPointPipeline[layout], nullptr);
     vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+    delete mPipelineDescriptorSetCache;
     vkDestroyDescriptorSetLayout(mDevice, mPipelineDescriptorSetLayout, nullptr);
-    vkFreeDescriptorSets(mDevice, mPipelineDescriptorPool, 1, &mPipelineDescriptorSet);
-    vkDestroyDescriptorPool(mDevice, mPipelineDescriptorPool, nullptr);
 }
 
-void ParticleRenderSystem::Render(VkCommandBuffer commandBuffer, Scene* scene, Camera* camera)
+void ParticleRenderSystem::SetRenderMode(RenderMode renderMode)
 {
-    assert(camera->mpFrameBuffer->mWidth == mExtent.width && camera->mpFrameBuffer->mHeight == mExtent.height);
+    mRenderMode = renderMode;
+}
+
+ParticleRenderSystem::RenderMode ParticleRenderSystem::GetRenderMode() const
+{
+    return mRenderMode;
+}
+
+void ParticleRenderSystem::SetFrustumCulling(bool frustumCulling)
+{
+    mFrustumCulling = frustumCulling;
+}
+
+bool ParticleRenderSystem::GetFrustumCulling() const
+{
+    return mFrustumCulling;
+}
+
+void ParticleRenderSystem::SetLevelOfDetail(float pointDiameter, float discardCoverage)
+{
+    mPointDiameter = pointDiameter;
+    mDiscardCoverage = discardCoverage;
+}
+
+void ParticleRenderSystem::SetComputeSplatting(bool computeSplatting)
+{
+    mComputeSplatting = computeSplatting;
+}
+
+void ParticleRenderSystem::SetTiledBlending(bool tiledBlending)
+{
+    mTiledBlending = tiledBlending;
+}
+
+void ParticleRenderSystem::GetTileCount(unsigned int& tileCountX, unsigned int& tileCountY) const
+{
+    tileCountX = mTileCountX;
+    tileCountY = mTileCountY;
+}
+
+bool ParticleRenderSystem::ReadTileOverdraw(unsigned int frameIndex, std::vector<float>& overdrawList) const
+{
+    unsigned int frameSlot = frameIndex % mFrameCount;
+    if (mOverdrawFrameList[frameSlot] < 0)
+        return false;
+
+    const float* overdraw = mOverdrawList[frameSlot];
+    overdrawList.assign(overdraw, overdraw + mTileCountX * mTileCountY);
+    return true;
+}
+
+void ParticleRenderSystem::Render(VkCommandBuffer commandBuffer, Scene* scene, Camera* camera, unsigned int frameIndex)
+{
+    Prepare(camera, frameIndex);
+    Record(commandBuffer, scene, camera);
+}
 
+void ParticleRenderSystem::Prepare(Camera* camera, unsigned int frameIndex)
+{
+    mFrameIndex = frameIndex;
     mMetaData.vpMatrix = glm::transpose(camera->mProjectionMatrix * camera->mViewMatrix);
     mMetaData.lensPosition = glm::vec4(camera->mPosition, 0.f);
     mMetaData.lensUpDirection = glm::vec4(camera->mUpDirection, 0.f);
-    vkTools::WriteBuffer(commandBuffer, mDevice, mMetaDataBufferMemory, &mMetaData, sizeof(MetaData), 0);
+    // Without level of detail, splatting takes every visible particle as point.
+    float pointDiameter = mPointDiameter > 0.f || !mComputeSplatting ? mPointDiameter : std::numeric_limits<float>::max();
+    mMetaData.lodParameters = glm::vec4(mExtent.width, mExtent.height, mFrustumCulling ? pointDiameter : 0.f, mDiscardCoverage);
+
+    // Region of other frames in flight may be in use. Culling pass reads view from buffer.
+    if (mViewBuffer || mFrustumCulling)
+    {
+        mUniformRing->BeginFrame(frameIndex);
+        mMetaDataOffset = mUniformRing->Push(&mMetaData, sizeof(MetaData));
+    }
+}
+
+void ParticleRenderSystem::Record(VkCommandBuffer commandBuffer, Scene* scene, Camera* camera)
+{
+    assert(camera->mpFrameBuffer->mWidth == mExtent.width && camera->mpFrameBuffer->mHeight == mExtent.height);
+
+    // Bins overflowed by completed frame of block grow to its bin count, with headroom. Prerecorded commands keep the bins they were recorded with.
+    unsigned int frameSlot = mFrameIndex % mFrameCount;
+    bool growBins = false;
+    if (mFrustumCulling && mTiledBlending && !mViewBuffer && mOverdrawFrameList[frameSlot] >= 0 && *mBinCountList[frameSlot] > mBinCapacity)
+    {
+        mBinCapacity = *mBinCountList[frameSlot] + *mBinCountList[frameSlot] / 2;
+        growBins = true;
+    }
+
+    // Resubmitted commands write overdraw block of frame too.
+    if (mFrustumCulling && mTiledBlending)
+        mOverdrawFrameList[frameSlot] = mFrameIndex;
+
+    // Resubmitted commands leave frame buffer in layout they were recorded with.
+    if (commandBuffer == VK_NULL_HANDLE)
+    {
+        camera->mpFrameBuffer->mImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        SwapSceneBuffers(scene);
+        return;
+    }
 
     VkRenderPassBeginInfo renderPassBeginInfo;
     renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -132,47 +485,282 @@ void ParticleRenderSystem::Render(VkCommandBuffer commandBuffer, Scene* scene, C
     renderPassBeginInfo.clearValueCount = 0;
     renderPassBeginInfo.pClearValues = NULL;
 
-    {   // vkUpdateDescriptorSets.
-        VkDescriptorBufferInfo particleBufferInputDescriptorBufferInfo;
-        VkWriteDescriptorSet particleBufferInputWriteDescriptorSet;
-        particleBufferInputDescriptorBufferInfo.buffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
-        particleBufferInputDescriptorBufferInfo.offset = 0;
-        particleBufferInputDescriptorBufferInfo.range = scene->mParticleBuffer->GetInputBuffer()->GetSize();
-        particleBufferInputWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        particleBufferInputWriteDescriptorSet.pNext = NULL;
-        particleBufferInputWriteDescriptorSet.dstSet = mPipelineDescriptorSet;
-        particleBufferInputWriteDescriptorSet.dstArrayElement = 0;
-        particleBufferInputWriteDescriptorSet.descriptorCount = 1;
-        particleBufferInputWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        particleBufferInputWriteDescriptorSet.pImageInfo = NULL;
-        particleBufferInputWriteDescriptorSet.dstBinding = 0;
-        particleBufferInputWriteDescriptorSet.pBufferInfo = &particleBufferInputDescriptorBufferInfo;
-
-        VkDescriptorBufferInfo metaBufferInputDescriptorBufferInfo;
-        VkWriteDescriptorSet metaBufferInputWriteDescriptorSet;
-        metaBufferInputDescriptorBufferInfo.buffer = mMetaDataBuffer;
-        metaBufferInputDescriptorBufferInfo.offset = 0;
-        metaBufferInputDescriptorBufferInfo.range = sizeof(MetaData);
-        metaBufferInputWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        metaBufferInputWriteDescriptorSet.pNext = NULL;
-        metaBufferInputWriteDescriptorSet.dstSet = mPipelineDescriptorSet;
-        metaBufferInputWriteDescriptorSet.dstArrayElement = 0;
-        metaBufferInputWriteDescriptorSet.descriptorCount = 1;
-        metaBufferInputWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        metaBufferInputWriteDescriptorSet.pImageInfo = NULL;
-        metaBufferInputWriteDescriptorSet.dstBinding = 1;
-        metaBufferInputWriteDescriptorSet.pBufferInfo = &metaBufferInputDescriptorBufferInfo;
-
-        std::vector<VkWriteDescriptorSet> writeDescriptorSetList{ particleBufferInputWriteDescriptorSet, metaBufferInputWriteDescriptorSet };
-        vkUpdateDescriptorSets(mDevice, writeDescriptorSetList.size(), writeDescriptorSetList.data(), 0, NULL);
+    // Visible indices of capacity of scene, bound below.
+    if (mFrustumCulling && (mVisibleBuffer == VK_NULL_HANDLE || mVisibleCount != scene->mMaxParticleCount || (mTiledBlending && mBinBuffer == VK_NULL_HANDLE) || growBins))
+    {
+        // Scene capacity or bin capacity changed, buffer may still be in use.
+        vkDeviceWaitIdle(mDevice);
+        DestroyVisibleBuffer();
+        CreateVisibleBuffer(scene->mMaxParticleCount);
+        // New buffer may reuse handle of destroyed one.
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            mCullPipeline[layout]->InvalidateDescriptorSets();
+            mSplatPipeline[layout]->InvalidateDescriptorSets();
+            for (unsigned int pass = 0; pass < 3; ++pass)
+                mTilePipeline[pass][layout]->InvalidateDescriptorSets();
+        }
+        mPipelineDescriptorSetCache->Clear();
+    }
+
+    // Descriptor set of buffers, written first time they are bound together.
+    VkDescriptorSet descriptorSet;
+    {
+        bool soa = scene->mParticleLayout == Scene::PARTICLE_LAYOUT_SOA;
+        VkBuffer particleBuffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
+        // Bindings of the unused layout are never read, but must be valid.
+        mPipelineDescriptorList[0] = DescriptorSetCache::BufferDescriptor(particleBuffer);
+        mPipelineDescriptorList[1] = DescriptorSetCache::BufferDescriptor(mFrustumCulling ? mVisibleBuffer : scene->mAliveIndexBuffer->GetInputBuffer()->mBuffer);
+        mPipelineDescriptorList[2] = DescriptorSetCache::BufferDescriptor(particleBuffer);
+        mPipelineDescriptorList[3] = DescriptorSetCache::BufferDescriptor(soa ? scene->mColorBuffer->GetInputBuffer()->mBuffer : particleBuffer);
+        mPipelineDescriptorList[4] = DescriptorSetCache::BufferDescriptor(soa ? scene->mScaleBuffer->GetInputBuffer()->mBuffer : particleBuffer);
+        mPipelineDescriptorList[5] = DescriptorSetCache::BufferDescriptor(mUniformRing->mBuffer, sizeof(MetaData));
+        descriptorSet = mPipelineDescriptorSetCache->Get(mPipelineDescriptorList);
+    }
+
+    // Input is written by update on another queue family.
+    scene->AcquireRenderBuffers(commandBuffer);
+
+    // Alive count written by GPU is vertex count of points, or instance count of quads. Culling pass writes visible count of both.
+    VkBuffer drawArgumentsBuffer = scene->mIndirectBuffer->GetInputBuffer()->mBuffer;
+    VkDeviceSize drawArgumentsOffset = offsetof(Scene::IndirectArguments, draw);
+    if (mFrustumCulling)
+    {
+        CullSceneParticles(commandBuffer, scene);
+        // Splatted and tiled particles are accumulated into color of each pixel, added to frame buffer by resolve.
+        if (mComputeSplatting || mTiledBlending)
+        {
+            // Resolve of earlier frame reads accumulated color.
+            vkTools::PipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            vkCmdFillBuffer(commandBuffer, mAccumulationBuffer, 0, VK_WHOLE_SIZE, 0);
+            vkTools::PipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        }
+        if (mComputeSplatting)
+            SplatSceneParticles(commandBuffer, scene);
+        if (mTiledBlending)
+            BlendSceneParticlesTiled(commandBuffer, scene);
+        drawArgumentsBuffer = mDrawArgumentsBuffer;
+        drawArgumentsOffset = sizeof(VkDrawIndirectCommand) * mRenderMode;
+    }
+    else if (mRenderMode == RENDER_MODE_INSTANCED_QUADS)
+    {
+        // Draw of earlier frame reads arguments.
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        VkDrawIndirectCommand drawCommand;
+        drawCommand.vertexCount = 4;
+        drawCommand.instanceCount = 0;
+        drawCommand.firstVertex = 0;
+        drawCommand.firstInstance = 0;
+        vkCmdUpdateBuffer(commandBuffer, mDrawArgumentsBuffer, sizeof(VkDrawIndirectCommand), sizeof(VkDrawIndirectCommand), &drawCommand);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        vkTools::CopyBuffer(commandBuffer, drawArgumentsBuffer, mDrawArgumentsBuffer, sizeof(uint32_t),
+            offsetof(Scene::IndirectArguments, draw) + offsetof(VkDrawIndirectCommand, vertexCount), sizeof(VkDrawIndirectCommand) + offsetof(VkDrawIndirectCommand, instanceCount));
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        drawArgumentsBuffer = mDrawArgumentsBuffer;
+        drawArgumentsOffset = sizeof(VkDrawIndirectCommand);
     }
 
     camera->mpFrameBuffer->TransitionImageLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mPipelineDescriptorSet, 0, NULL);
-    vkCmdDraw(commandBuffer, scene->mParticleCount, 1, 0, 0);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline[mRenderMode][scene->mParticleLayout]);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &descriptorSet, 1, &mMetaDataOffset);
+    if (!mViewBuffer)
+        vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0, sizeof(MetaData), &mMetaData);
+    // Quads blended by tiled passes have their count zeroed, unless bins overflowed.
+    vkCmdDrawIndirect(commandBuffer, drawArgumentsBuffer, drawArgumentsOffset, 1, sizeof(VkDrawIndirectCommand));
+    // Points share layout, descriptor set and push constants of quads, unless splatted.
+    if (mFrustumCulling && mPointDiameter > 0.f && !mComputeSplatting)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPointPipeline[scene->mParticleLayout]);
+        vkCmdDrawIndirect(commandBuffer, mDrawArgumentsBuffer, sizeof(VkDrawIndirectCommand) * RENDER_MODE_COUNT, 1, sizeof(VkDrawIndirectCommand));
+    }
+    // Splatted and tiled color is added to frame buffer.
+    if (mFrustumCulling && (mComputeSplatting || mTiledBlending))
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mResolvePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mResolvePipelineLayout, 0, 1, &mResolveDescriptorSet, 0, nullptr);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    }
     vkCmdEndRenderPass(commandBuffer);
 
+    // Output of later update.
+    scene->ReleaseRenderBuffers(commandBuffer);
+
+    SwapSceneBuffers(scene);
+}
+
+void ParticleRenderSystem::SwapSceneBuffers(Scene* scene)
+{
     scene->mParticleBuffer->Swap();
+    // Cold streams follow states of particle buffer.
+    if (scene->mVelocityBuffer != nullptr)
+        scene->mVelocityBuffer->Swap();
+    scene->mAliveIndexBuffer->Swap();
+    scene->mIndirectBuffer->Swap();
+}
+
+void ParticleRenderSystem::CullSceneParticles(VkCommandBuffer commandBuffer, Scene* scene)
+{
+    unsigned int layout = scene->mParticleLayout;
+    bool soa = layout == Scene::PARTICLE_LAYOUT_SOA;
+    VkBuffer particleBuffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
+    std::vector<VkBuffer> bufferList{
+        particleBuffer,
+        soa ? scene->mScaleBuffer->GetInputBuffer()->mBuffer : particleBuffer,
+        scene->mAliveIndexBuffer->GetInputBuffer()->mBuffer,
+        scene->mIndirectBuffer->GetInputBuffer()->mBuffer,
+        mVisibleBuffer,
+        mDrawArgumentsBuffer,
+        mUniformRing->mBuffer
+    };
+
+    // Draw of earlier frame reads visible indices and arguments.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    // Visible counts are accumulated by pass. Points are compacted after capacity of quads.
+    VkDrawIndirectCommand drawCommandList[RENDER_MODE_COUNT + 1];
+    drawCommandList[RENDER_MODE_GEOMETRY_SHADER] = { 0, 1, 0, 0 };
+    drawCommandList[RENDER_MODE_INSTANCED_QUADS] = { 4, 0, 0, 0 };
+    drawCommandList[RENDER_MODE_COUNT] = { 0, 1, mVisibleCount, 0 };
+    vkCmdUpdateBuffer(commandBuffer, mDrawArgumentsBuffer, 0, sizeof(drawCommandList), drawCommandList);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Alive count is only known on GPU, threads past it exit.
+    mCullPipeline[layout]->SetDynamicUniform(6, sizeof(MetaData), mMetaDataOffset);
+    mCullPipeline[layout]->UpdateDescriptorSet(bufferList);
+    mCullPipeline[layout]->DispatchLinear(commandBuffer, (mVisibleCount + gCullWorkGroupSize - 1) / gCullWorkGroupSize);
+    // Read by draws, and by splatting pass.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void ParticleRenderSystem::SplatSceneParticles(VkCommandBuffer commandBuffer, Scene* scene)
+{
+    unsigned int layout = scene->mParticleLayout;
+    bool soa = layout == Scene::PARTICLE_LAYOUT_SOA;
+    VkBuffer particleBuffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
+    std::vector<VkBuffer> bufferList{
+        particleBuffer,
+        soa ? scene->mColorBuffer->GetInputBuffer()->mBuffer : particleBuffer,
+        soa ? scene->mScaleBuffer->GetInputBuffer()->mBuffer : particleBuffer,
+        mVisibleBuffer,
+        mDrawArgumentsBuffer,
+        mAccumulationBuffer,
+        mUniformRing->mBuffer
+    };
+
+    // Point count is only known on GPU, threads past it exit.
+    mSplatPipeline[layout]->SetDynamicUniform(6, sizeof(MetaData), mMetaDataOffset);
+    mSplatPipeline[layout]->UpdateDescriptorSet(bufferList);
+    mSplatPipeline[layout]->DispatchLinear(commandBuffer, (mVisibleCount + gCullWorkGroupSize - 1) / gCullWorkGroupSize);
+    // Read by resolve, and added to by tiled blending.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void ParticleRenderSystem::BlendSceneParticlesTiled(VkCommandBuffer commandBuffer, Scene* scene)
+{
+    unsigned int layout = scene->mParticleLayout;
+    bool soa = layout == Scene::PARTICLE_LAYOUT_SOA;
+    VkBuffer particleBuffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
+    std::vector<VkBuffer> bufferList{
+        particleBuffer,
+        soa ? scene->mColorBuffer->GetInputBuffer()->mBuffer : particleBuffer,
+        soa ? scene->mScaleBuffer->GetInputBuffer()->mBuffer : particleBuffer,
+        mVisibleBuffer,
+        mDrawArgumentsBuffer,
+        mTileCountBuffer,
+        mTileOffsetBuffer,
+        mBinBuffer,
+        mAccumulationBuffer,
+        mOverdrawRing->mBuffer,
+        mUniformRing->mBuffer
+    };
+    unsigned int tileCount = mTileCountX * mTileCountY;
+    uint32_t overdrawOffset = mOverdrawOffsetList[mFrameIndex % mFrameCount];
+    for (unsigned int pass = 0; pass < 3; ++pass)
+    {
+        mTilePipeline[pass][layout]->SetDynamicUniform(9, sizeof(uint32_t) + sizeof(float) * tileCount, overdrawOffset);
+        mTilePipeline[pass][layout]->SetDynamicUniform(10, sizeof(MetaData), mMetaDataOffset);
+        mTilePipeline[pass][layout]->UpdateDescriptorSet(bufferList);
+    }
+
+    // Blend of earlier frame reads counts, offsets and bins.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(commandBuffer, mTileCountBuffer, 0, VK_WHOLE_SIZE, 0);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Count quads of each tile, then bins start at prefix sum of counts. Quad count is only known on GPU, threads past it exit.
+    unsigned int groupCount = (mVisibleCount + gTileSize * gTileSize - 1) / (gTileSize * gTileSize);
+    mTilePipeline[0][layout]->DispatchLinear(commandBuffer, groupCount);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    mTilePrefixSum->Scan(commandBuffer, mTileCountBuffer, mTileOffsetBuffer);
+
+    mTilePipeline[1][layout]->DispatchLinear(commandBuffer, groupCount);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // One work group per tile.
+    mTilePipeline[2][layout]->Dispatch(commandBuffer, tileCount);
+    // Color is read by resolve, quad counts by draw, bin count and overdraw by host once fence of frame is signaled.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+}
+
+void ParticleRenderSystem::CreateVisibleBuffer(unsigned int maxParticleCount)
+{
+    mVisibleCount = maxParticleCount;
+    uint32_t minOffsetAligment;
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * 2 * glm::max(mVisibleCount, 1u),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mVisibleBuffer, mVisibleBufferMemory, minOffsetAligment
+    );
+    if (mTiledBlending)
+    {
+        mBinCapacity = (std::max)(mBinCapacity, gTileBinsPerParticle * glm::max(mVisibleCount, 1u));
+        vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * 2 * mBinCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            mBinBuffer, mBinBufferMemory, minOffsetAligment
+        );
+    }
+}
+
+void ParticleRenderSystem::DestroyVisibleBuffer()
+{
+    if (mVisibleBuffer == VK_NULL_HANDLE)
+        return;
+    vkFreeMemory(mDevice, mVisibleBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mVisibleBuffer, nullptr);
+    mVisibleBuffer = VK_NULL_HANDLE;
+    mVisibleBufferMemory = VK_NULL_HANDLE;
+    mVisibleCount = 0;
+    if (mBinBuffer == VK_NULL_HANDLE)
+        return;
+    vkFreeMemory(mDevice, mBinBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mBinBuffer, nullptr);
+    mBinBuffer = VK_NULL_HANDLE;
+    mBinBufferMemory = VK_NULL_HANDLE;
 }
@@ -2,30 +2,125 @@
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
+#include <vector>
+#include "DescriptorSetCache.hpp"
 
 class Scene;
 class StorageBuffer;
 class FrameBuffer;
 class Camera;
+class UniformRing;
+class ComputePipeline;
+class PrefixSum;
 
 class ParticleRenderSystem
 {
     public:
+        // Expansion of particles to billboard quads.
+        enum RenderMode
+        {
+            // Point per alive particle, expanded to quad by geometry shader.
+            RENDER_MODE_GEOMETRY_SHADER = 0,
+            // Instance of 4 strip vertices per alive particle, pulled from particle buffers by vertex shader without geometry shader.
+            RENDER_MODE_INSTANCED_QUADS = 1,
+            RENDER_MODE_COUNT = 2
+        };
+
         // Constructor.
         // device Vulkan device.
         // physicalDevice Vulkan physical device.
-        ParticleRenderSystem(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int width, unsigned int height, VkFormat format, VkRenderPass renderPass);
+        // frameCount Number of frames in flight, each with own uniform ring region. DEFAULT [1]
+        // viewBuffer Read view from uniform ring instead of push constants, so recorded command buffers can be resubmitted as camera moves. DEFAULT [false]
+        ParticleRenderSystem(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int width, unsigned int height, VkFormat format, VkRenderPass renderPass, unsigned int frameCount = 1, bool viewBuffer = false);
 
         // Destructor.
         ~ParticleRenderSystem();
 
-        // Render particles.
+        // Set expansion of particles to quads, used by next record.
+        // renderMode Render mode. DEFAULT [RENDER_MODE_GEOMETRY_SHADER]
+        void SetRenderMode(RenderMode renderMode);
+
+        // Get expansion of particles to quads.
+        // Returns render mode.
+        RenderMode GetRenderMode() const;
+
+        // Set culling of particles outside view frustum by compute pass before draw, used by next record.
+        // Visible indices are compacted and drawn indirectly, so vertex work scales with particles in view.
+        // Pass runs on render queue, whose family must support compute.
+        // frustumCulling Whether to cull. DEFAULT [false]
+        void SetFrustumCulling(bool frustumCulling);
+
+        // Get culling of particles outside view frustum.
+        // Returns whether culled.
+        bool GetFrustumCulling() const;
+
+        // Set level of detail by projected size, classified by culling pass, used by next record with frustum culling.
+        // Particles smaller than pointDiameter pixels are drawn as single pixel points weighted by coverage, those covering less than discardCoverage pixels are not drawn.
+        // pointDiameter Diameter in pixels below which particles are points, 0 draws every particle as quad. DEFAULT [0]
+        // discardCoverage Area in pixels below which particles are discarded. DEFAULT [0]
+        void SetLevelOfDetail(float pointDiameter, float discardCoverage);
+
+        // Set splatting of points by compute pass, used by next record with frustum culling.
+        // Points of level of detail, or every visible particle without level of detail, are projected to one pixel each and accumulated with integer atomics.
+        // Accumulated color is resolved into frame buffer by a full screen draw, added to quads drawn before it.
+        // computeSplatting Whether to splat. DEFAULT [false]
+        void SetComputeSplatting(bool computeSplatting);
+
+        // Set blending of quads by tiled compute passes instead of raster, used by next record with frustum culling.
+        // Quads are binned to screen tiles, each bin is sorted back to front and blended in one work group, with one write of each pixel resolved into frame buffer.
+        // Bins hold a fixed number of quads per particle on average. A frame whose quads overflow them is drawn by raster instead, and bins grow to it before a later frame is recorded.
+        // Prerecorded command buffers keep their bins, so frames they overflow are always drawn by raster.
+        // tiledBlending Whether to blend in tiles. DEFAULT [false]
+        void SetTiledBlending(bool tiledBlending);
+
+        // Get number of screen tiles of tiled blending.
+        // tileCountX Set to number of tiles along width.
+        // tileCountY Set to number of tiles along height.
+        void GetTileCount(unsigned int& tileCountX, unsigned int& tileCountY) const;
+
+        // Read overdraw of each tile of last frame recorded with tiled blending into block of frame, frameCount frames ago. Its commands must be complete.
+        // frameIndex Index of frame.
+        // overdrawList Set to quad fragments per pixel of each tile, row by row. Zero if frame overflowed bins and was drawn by raster.
+        // Returns false if block has not been recorded.
+        bool ReadTileOverdraw(unsigned int frameIndex, std::vector<float>& overdrawList) const;
+
+        // Render particles. Same as Prepare followed by Record.
         // commandBuffer Command buffer to render.
         // scene Scene to render.
         // camera Camera to render from.
-        void Render(VkCommandBuffer commandBuffer, Scene* scene, Camera* camera);
+        // frameIndex Index of frame. Command buffers of the previous frameCount - 1 frames may still execute.
+        void Render(VkCommandBuffer commandBuffer, Scene* scene, Camera* camera, unsigned int frameIndex);
+
+        // Prepare render of frame without recording. Writes view of camera to uniform ring with view buffer or frustum culling.
+        // camera Camera to render from.
+        // frameIndex Index of frame. Command buffers of the previous frameCount - 1 frames may still execute.
+        void Prepare(Camera* camera, unsigned int frameIndex);
+
+        // Record prepared render. Swaps buffers of scene.
+        // commandBuffer Command buffer to record. VK_NULL_HANDLE only swaps, when commands of this frame in flight recorded for equal swap state of scene are resubmitted.
+        // scene Scene to render.
+        // camera Camera to render from, as prepared.
+        void Record(VkCommandBuffer commandBuffer, Scene* scene, Camera* camera);
 
     private:
+        // Output of update becomes input of next frame.
+        void SwapSceneBuffers(Scene* scene);
+
+        // Record culling of input particles of scene into visible indices and draw arguments.
+        void CullSceneParticles(VkCommandBuffer commandBuffer, Scene* scene);
+
+        // Record splatting of points compacted by culling pass into accumulation buffer.
+        void SplatSceneParticles(VkCommandBuffer commandBuffer, Scene* scene);
+
+        // Record binning, sort and blend of quads compacted by culling pass into accumulation buffer.
+        void BlendSceneParticlesTiled(VkCommandBuffer commandBuffer, Scene* scene);
+
+        // Create visible index buffer of capacity, and bins of tiled blending.
+        void CreateVisibleBuffer(unsigned int maxParticleCount);
+
+        // Destroy visible index buffer and bins.
+        void DestroyVisibleBuffer();
+
         VkDevice mDevice;
         VkPhysicalDevice mPhysicalDevice;
         VkExtent2D mExtent;
@@ -33,21 +128,90 @@ class ParticleRenderSystem
         VkRenderPass mRenderPass;
 
         VkShaderModule mVertexShaderModule;
+        VkShaderModule mQuadVertexShaderModule;
         VkShaderModule mGeometryShaderModule;
         VkShaderModule mPixelShaderModule;
+        VkShaderModule mPointVertexShaderModule;
+        VkShaderModule mPointPixelShaderModule;
+        VkShaderModule mResolveVertexShaderModule;
+        VkShaderModule mResolvePixelShaderModule;
 
-        VkDescriptorPool mPipelineDescriptorPool;
-        VkDescriptorSet mPipelineDescriptorSet;
+        // Frames in flight, and frame prepared.
+        unsigned int mFrameCount;
+        unsigned int mFrameIndex;
+
+        // View of each frame in flight, bound at offset of current frame when view is not pushed or particles are culled.
+        bool mViewBuffer;
+        UniformRing* mUniformRing;
+        uint32_t mMetaDataOffset;
+
+        // Descriptor set of each combination of swapped buffers.
+        DescriptorSetCache* mPipelineDescriptorSetCache;
+        std::vector<DescriptorSetCache::Descriptor> mPipelineDescriptorList;
         VkDescriptorSetLayout mPipelineDescriptorSetLayout;
         VkPipelineLayout mPipelineLayout;
-        VkPipeline mPipeline;
+        // Pipeline per render mode and particle layout, vertex shader specialized.
+        RenderMode mRenderMode;
+        VkPipeline mPipeline[RENDER_MODE_COUNT][2];
+        // Pipeline of single pixel points of level of detail, per particle layout.
+        VkPipeline mPointPipeline[2];
+
+        // Diameter and coverage in pixels of level of detail.
+        float mPointDiameter;
+        float mDiscardCoverage;
+
+        // Draw arguments of each render mode, points then instanced quads, followed by draw of single pixel points.
+        VkBuffer mDrawArgumentsBuffer;
+        VkDeviceMemory mDrawArgumentsBufferMemory;
+
+        // Culling pass of each particle layout, and indices of visible particles it compacts, quads then points. Capacity follows scene.
+        bool mFrustumCulling;
+        ComputePipeline* mCullPipeline[2];
+        unsigned int mVisibleCount;
+        VkBuffer mVisibleBuffer;
+        VkDeviceMemory mVisibleBufferMemory;
+
+        // Splatting pass of each particle layout, and color of each pixel it accumulates.
+        bool mComputeSplatting;
+        ComputePipeline* mSplatPipeline[2];
+        VkBuffer mAccumulationBuffer;
+        VkDeviceMemory mAccumulationBufferMemory;
+        // Full screen draw adding accumulated color to frame buffer.
+        DescriptorSetCache* mResolveDescriptorSetCache;
+        VkDescriptorSet mResolveDescriptorSet;
+        VkDescriptorSetLayout mResolveDescriptorSetLayout;
+        VkPipelineLayout mResolvePipelineLayout;
+        VkPipeline mResolvePipeline;
+
+        // Count, bin and blend passes of tiled blending, of each particle layout.
+        bool mTiledBlending;
+        ComputePipeline* mTilePipeline[3][2];
+        unsigned int mTileCountX;
+        unsigned int mTileCountY;
+        // Quads overlapping each tile, and start of bin of each tile.
+        VkBuffer mTileCountBuffer;
+        VkDeviceMemory mTileCountBufferMemory;
+        VkBuffer mTileOffsetBuffer;
+        VkDeviceMemory mTileOffsetBufferMemory;
+        PrefixSum* mTilePrefixSum;
+        // Sort key and index of quads in bins, capacity follows visible indices and grows to bin count of overflowing frames.
+        unsigned int mBinCapacity;
+        VkBuffer mBinBuffer;
+        VkDeviceMemory mBinBufferMemory;
+        // Bin count and overdraw block of each frame in flight, mapped, and frame last recorded into it.
+        UniformRing* mOverdrawRing;
+        std::vector<const uint32_t*> mBinCountList;
+        std::vector<const float*> mOverdrawList;
+        std::vector<uint32_t> mOverdrawOffsetList;
+        std::vector<int64_t> mOverdrawFrameList;
 
+        // Push constants of geometry shader or quad vertex shader, written into command buffer by each draw, or block in uniform ring.
         struct MetaData
         {
             glm::mat4 vpMatrix;
             glm::vec4 lensPosition;
             glm::vec4 lensUpDirection;
+            // Frame buffer width and height, point diameter and discard coverage of level of detail.
+            glm::vec4 lodParameters;
         } mMetaData;
-        VkBuffer mMetaDataBuffer;
-        VkDeviceMemory mMetaDataBufferMemory;
 };
@@ -0,0 +1,123 @@
+#include "ParticleStatistics.hpp"
+#include "ComputePipeline.hpp"
+#include "UniformRing.hpp"
+#include "Scene.hpp"
+#include "StorageSwapBuffer.hpp"
+#include "vkTools.hpp"
+
+#include <assert.h>
+#include <algorithm>
+
+// Threads of both passes, power of two. Pass 0 runs at most this many work groups, so pass 1 reduces them in one.
+static const unsigned int gStatisticsWorkGroupSize = 256;
+
+ParticleStatistics::ParticleStatistics(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int maxParticleCount, unsigned int frameCount)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mFrameCount = frameCount;
+    mGroupCount = glm::clamp((maxParticleCount + gStatisticsWorkGroupSize - 1) / gStatisticsWorkGroupSize, 1u, gStatisticsWorkGroupSize);
+
+    uint32_t minOffsetAligment;
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(Result) * mGroupCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mPartialBuffer, mPartialBufferMemory, minOffsetAligment
+    );
+
+    // Blocks have the same offset every frame of their region.
+    mResultRing = new UniformRing(mDevice, mPhysicalDevice, sizeof(Result), mFrameCount);
+    mResultList.resize(mFrameCount);
+    mResultOffsetList.resize(mFrameCount);
+    mResultFrameList.assign(mFrameCount, -1);
+    for (unsigned int i = 0; i < mFrameCount; ++i)
+    {
+        mResultRing->BeginFrame(i);
+        mResultList[i] = static_cast<const Result*>(mResultRing->Reserve(sizeof(Result), mResultOffsetList[i]));
+    }
+
+    std::vector<VkDescriptorType> descriptorTypeList{
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Particles or positions.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Velocities.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Alive indices.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Indirect arguments.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Partials.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, // Result.
+    };
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+    {
+        uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? 1 : 0;
+        mReducePipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Statistics_CS.spv", descriptorTypeList, { gStatisticsWorkGroupSize, soa, 0, mGroupCount });
+        mResultPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Statistics_CS.spv", descriptorTypeList, { gStatisticsWorkGroupSize, soa, 1, mGroupCount });
+    }
+}
+
+ParticleStatistics::~ParticleStatistics()
+{
+    vkFreeMemory(mDevice, mPartialBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mPartialBuffer, nullptr);
+
+    delete mResultRing;
+
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+    {
+        delete mReducePipeline[layout];
+        delete mResultPipeline[layout];
+    }
+}
+
+void ParticleStatistics::Record(VkCommandBuffer commandBuffer, Scene* scene, unsigned int frameIndex)
+{
+    assert(scene->mParticleStorage != Scene::PARTICLE_STORAGE_IN_PLACE);
+    unsigned int frameSlot = frameIndex % mFrameCount;
+    mResultFrameList[frameSlot] = frameIndex;
+    if (commandBuffer == VK_NULL_HANDLE)
+        return;
+
+    unsigned int layout = scene->mParticleLayout;
+    VkBuffer particleBuffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
+    std::vector<VkBuffer> bufferList{
+        particleBuffer,
+        scene->mVelocityBuffer != nullptr ? scene->mVelocityBuffer->GetInputBuffer()->mBuffer : particleBuffer,
+        scene->mAliveIndexBuffer->GetInputBuffer()->mBuffer,
+        scene->mIndirectBuffer->GetInputBuffer()->mBuffer,
+        mPartialBuffer,
+        mResultRing->mBuffer
+    };
+
+    // Input was written by update or upload of an earlier submission. Partials of last frame are read by its result pass.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    mReducePipeline[layout]->SetDynamicUniform(5, sizeof(Result), mResultOffsetList[frameSlot]);
+    mReducePipeline[layout]->UpdateDescriptorSet(bufferList);
+    mReducePipeline[layout]->Dispatch(commandBuffer, mGroupCount);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    mResultPipeline[layout]->SetDynamicUniform(5, sizeof(Result), mResultOffsetList[frameSlot]);
+    mResultPipeline[layout]->UpdateDescriptorSet(bufferList);
+    mResultPipeline[layout]->Dispatch(commandBuffer, 1);
+    // Result is read by host once fence of frame is signaled.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+bool ParticleStatistics::Read(unsigned int frameIndex, Statistics& statistics) const
+{
+    unsigned int frameSlot = frameIndex % mFrameCount;
+    if (mResultFrameList[frameSlot] < 0)
+        return false;
+
+    const Result& result = *mResultList[frameSlot];
+    statistics.boundsMin = glm::vec3(result.boundsMin);
+    statistics.boundsMax = glm::vec3(result.boundsMax);
+    statistics.kineticEnergy = result.kineticEnergy;
+    statistics.meanSpeed = result.aliveCount > 0 ? result.speedSum / result.aliveCount : 0.f;
+    statistics.maxSpeed = result.maxSpeed;
+    statistics.aliveCount = result.aliveCount;
+    statistics.frameIndex = (unsigned int)mResultFrameList[frameSlot];
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class ComputePipeline;
+class UniformRing;
+class Scene;
+
+// Reduces alive particles of a scene on GPU to bounds, kinetic energy, speeds and alive count, in two work group reduction passes.
+// Results are written to a host visible ring with one block per frame in flight and read frames later, once their fence is signaled, without a readback stall.
+class ParticleStatistics
+{
+    public:
+        // Result of a frame.
+        struct Statistics
+        {
+            // Bounds of alive particle positions, infinite and inverted without particles.
+            glm::vec3 boundsMin;
+            glm::vec3 boundsMax;
+            // Sum of half mass times squared speed.
+            float kineticEnergy;
+            float meanSpeed;
+            float maxSpeed;
+            unsigned int aliveCount;
+            // Frame reduced.
+            unsigned int frameIndex;
+        };
+
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // maxParticleCount Max number of particles of scenes reduced.
+        // frameCount Number of frames in flight, each with own result block.
+        ParticleStatistics(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int maxParticleCount, unsigned int frameCount);
+
+        // Destructor.
+        ~ParticleStatistics();
+
+        // Record reduction of input particles of scene, those drawn this frame. Record on update queue before update, which owns input buffers then.
+        // Not supported with PARTICLE_STORAGE_IN_PLACE, whose buffer is owned by render until update acquires it.
+        // commandBuffer Command buffer of update queue, VK_NULL_HANDLE if commands recorded for frame frameCount frames ago are resubmitted.
+        // scene Scene to reduce.
+        // frameIndex Index of frame.
+        void Record(VkCommandBuffer commandBuffer, Scene* scene, unsigned int frameIndex);
+
+        // Read result of last frame recorded into block of frame, frameCount frames ago. Its commands must be complete.
+        // frameIndex Index of frame.
+        // statistics Set to result.
+        // Returns false if block has not been recorded.
+        bool Read(unsigned int frameIndex, Statistics& statistics) const;
+
+    private:
+        // Bounds and sums, as written by Particles_Statistics_CS.
+        struct Result
+        {
+            glm::vec4 boundsMin;
+            glm::vec4 boundsMax;
+            float kineticEnergy;
+            float speedSum;
+            float maxSpeed;
+            uint32_t aliveCount;
+        };
+
+        VkDevice mDevice;
+        VkPhysicalDevice mPhysicalDevice;
+
+        unsigned int mFrameCount;
+        unsigned int mGroupCount;
+
+        // Reduces particles to partial of each work group, of each particle layout.
+        ComputePipeline* mReducePipeline[2];
+        // Reduces partials to result, of each particle layout.
+        ComputePipeline* mResultPipeline[2];
+
+        VkBuffer mPartialBuffer;
+        VkDeviceMemory mPartialBufferMemory;
+
+        // Result block of each frame in flight, mapped, and frame last recorded into it.
+        UniformRing* mResultRing;
+        std::vector<const Result*> mResultList;
+        std::vector<uint32_t> mResultOffsetList;
+        std::vector<int64_t> mResultFrameList;
+};
@@ -3,171 +3,1228 @@
 #include "Scene.hpp"
 #include "FrameBuffer.hpp"
 #include "StorageSwapBuffer.hpp"
+#include "StorageColdBuffer.hpp"
 #include "Camera.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <unordered_map>
+#include <functional>
+#include "ComputePipeline.hpp"
+#include "PrefixSum.hpp"
+#include "RadixSort.hpp"
 #include "vkTools.hpp"
+#include "VkTimer.hpp"
+#include "SignedDistanceField.hpp"
+#include "VectorField.hpp"
+#include "Texture3D.hpp"
+#include "UniformRing.hpp"
 
-ParticleUpdateSystem::ParticleUpdateSystem(VkDevice device, VkPhysicalDevice physicalDevice)
+// Tuned work group sizes. Device ID 0 matches any device of vendor.
+static const struct
 {
+    uint32_t vendorID;
+    uint32_t deviceID;
+    unsigned int workGroupSize;
+} gWorkGroupSizeTable[] = {
+    { 0x10DE, 0, 256 }, // NVIDIA, 32 wide warps.
+    { 0x1002, 0, 256 }, // AMD, 64 wide wavefronts.
+    { 0x8086, 0, 128 }, // Intel.
+    { 0x13B5, 0, 64 },  // ARM.
+    { 0x5143, 0, 128 }, // Qualcomm.
+};
+static const unsigned int gDefaultWorkGroupSize = 64;
+
+// Meta data flags, match Particles_Update_CS.
+static const unsigned int gFlagSyntheticLoad = 1;
+static const unsigned int gFlagAcceleration = 2;
+static const unsigned int gFlagDistanceField = 4;
+static const unsigned int gFlagForceField = 8;
+static const unsigned int gFlagCollision = 16;
+static const unsigned int gFlagColorOutput = 32;
+static const unsigned int gFlagScaleOutput = 64;
+
+// Meta data flags of update with collision radius.
+static unsigned int GetCollisionFlags(float collisionRadius)
+{
+    return collisionRadius > 0.f ? gFlagCollision : 0;
+}
+
+// Particle access of update dispatched with meta data flags. Only collisions read neighbors.
+static ParticleUpdateSystem::ParticleAccess GetParticleAccess(unsigned int flags)
+{
+    return (flags & gFlagCollision) != 0 ? ParticleUpdateSystem::PARTICLE_ACCESS_NEIGHBORS : ParticleUpdateSystem::PARTICLE_ACCESS_SELF;
+}
+
+// Descriptor sets of pipelines dispatched once per substep. Substep 0 and then two alternating buffer sets.
+static const unsigned int gSubstepDescriptorSetCount = 3;
+
+ParticleUpdateSystem::ParticleUpdateSystem(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int workGroupSize, unsigned int gridCellCount, unsigned int frameCount)
+{
+    assert(frameCount > 0);
     mDevice = device;
     mPhysicalDevice = physicalDevice;
+    mFrameIndex = 0;
+    mFrameCount = frameCount;
+    mFrameSlot = 0;
+
+    // Clamp work group size to device limits.
+    {
+        VkPhysicalDeviceProperties physicalDeviceProperties;
+        vkGetPhysicalDeviceProperties(mPhysicalDevice, &physicalDeviceProperties);
+        mWorkGroupSize = workGroupSize == 0 ? FindWorkGroupSize(mPhysicalDevice) : workGroupSize;
+        mWorkGroupSize = (std::min)(mWorkGroupSize, physicalDeviceProperties.limits.maxComputeWorkGroupSize[0]);
+        mWorkGroupSize = (std::min)(mWorkGroupSize, physicalDeviceProperties.limits.maxComputeWorkGroupInvocations);
+    }
+
+    // Meta, fluid, gravity and force field blocks, emitters and emit arguments of each frame in flight, each padded to at most max offset alignment of 256.
+    mUniformRing = new UniformRing(mDevice, mPhysicalDevice, sizeof(MetaData) + sizeof(FluidParameters) + sizeof(GravityParameters) + sizeof(ForceFieldParameters)
+        + sizeof(ParticleEmitter) * Scene::mMaxEmitterCount + sizeof(VkDispatchIndirectCommand) + 6 * 256, mFrameCount);
+    mMetaDataOffset = 0;
+    mFluidParametersOffset = 0;
+    mGravityParametersOffset = 0;
+    mForceFieldParametersOffset = 0;
+    mEmittersOffset = 0;
+    mEmitArgumentsOffset = 0;
+
+    // Collisions disabled until set.
+    mMetaData.gridCellSize = 0.f;
+    mMetaData.gridCellCount = 1;
+    while (mMetaData.gridCellCount < gridCellCount)
+        mMetaData.gridCellCount <<= 1;
+    mMetaData.collisionRadius = 0.f;
+    mMetaData.collisionStiffness = 100.f;
+    mMetaData.collisionDamping = 1.f;
+    mMetaData.flags = gFlagSyntheticLoad;
+    mMode = MODE_DEFAULT;
+    mDistanceField = nullptr;
+    mMetaData.distanceFieldBoundsMin = glm::vec4(0.f);
+    mMetaData.distanceFieldBoundsMax = glm::vec4(0.f);
+    mPlaceholderTexture = nullptr;
+
+    // Variable time step until set.
+    mIntegrator = INTEGRATOR_SEMI_IMPLICIT_EULER;
+    mFixedTimestep = 0.f;
+    mMaxSubstepCount = 1;
+    mTimeAccumulator = 0.f;
+    mSubstepDescriptorSet = 0;
+    mSubstepCount = 0;
+    mSort = false;
+    mStructureVersion = 0;
 
-    // Create meta buffers.
+    // Gravity parameters.
+    mGravityParameters.gravitationalConstant = 1.f;
+    mGravityParameters.softening = 0.1f;
+    mGravityParameters.openingAngle = 0.5f;
+
+    // Force fields.
+    for (unsigned int slot = 0; slot < MAX_FORCE_FIELDS; ++slot)
+        mForceFieldList[slot] = nullptr;
+    mForceFieldParameters.count = 0;
+    mForceFieldParameters.analyticNoise = VK_FALSE;
+
+    // Create grid buffers.
     uint32_t minOffsetAligment;
-    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(MetaData),
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        mMetaDataBuffer, mMetaDataBufferMemory, minOffsetAligment
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * mMetaData.gridCellCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mGridCellCountBuffer, mGridCellCountBufferMemory, minOffsetAligment
         );
-    assert(sizeof(MetaData) % minOffsetAligment == 0);
-
-    // Create compute pipeline.
-    {
-        vkTools::CreateShaderModule(mDevice, "resources/shaders/Particles_Update_CS.spv", mComputeShaderModule);
-
-        VkDescriptorSetLayoutBinding particleInBufferSetLayoutBinding;
-        particleInBufferSetLayoutBinding.descriptorCount = 1;
-        particleInBufferSetLayoutBinding.pImmutableSamplers = nullptr;
-        particleInBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-        particleInBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        particleInBufferSetLayoutBinding.binding = 0;
-        VkDescriptorSetLayoutBinding particleOutBufferSetLayoutBinding;
-        particleOutBufferSetLayoutBinding.descriptorCount = 1;
-        particleOutBufferSetLayoutBinding.pImmutableSamplers = nullptr;
-        particleOutBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-        particleOutBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        particleOutBufferSetLayoutBinding.binding = 1;
-        VkDescriptorSetLayoutBinding metaBufferSetLayoutBinding;
-        metaBufferSetLayoutBinding.descriptorCount = 1;
-        metaBufferSetLayoutBinding.pImmutableSamplers = nullptr;
-        metaBufferSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-        metaBufferSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        metaBufferSetLayoutBinding.binding = 2;
-        std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList{ particleInBufferSetLayoutBinding, particleOutBufferSetLayoutBinding, metaBufferSetLayoutBinding };
-
-        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
-        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        descriptorSetLayoutCreateInfo.pNext = 0;
-        descriptorSetLayoutCreateInfo.flags = 0;
-        descriptorSetLayoutCreateInfo.bindingCount = descriptorSetLayoutBindingList.size();
-        descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindingList.data();
-        vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, nullptr, &mPipelineDescriptorSetLayout);
-
-        std::vector<VkDescriptorSetLayout> descriptorSetLayoutList{ mPipelineDescriptorSetLayout };
-        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
-        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutCreateInfo.pNext = NULL;
-        pipelineLayoutCreateInfo.flags = 0;
-        pipelineLayoutCreateInfo.setLayoutCount = descriptorSetLayoutList.size();
-        pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayoutList.data();
-        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-        pipelineLayoutCreateInfo.pPushConstantRanges = NULL;
-        vkTools::VkErrorCheck(vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout));
-
-        VkDescriptorPoolSize descriptorPoolSize;
-        descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorPoolSize.descriptorCount = descriptorSetLayoutBindingList.size();
-        std::vector<VkDescriptorPoolSize> descriptorPoolSizeList{ descriptorPoolSize };
-
-        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
-        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        descriptorPoolCreateInfo.pNext = NULL;
-        descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-        descriptorPoolCreateInfo.maxSets = 1;
-        descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizeList.data();
-        descriptorPoolCreateInfo.poolSizeCount = descriptorPoolSizeList.size();
-        vkTools::VkErrorCheck(vkCreateDescriptorPool(mDevice, &descriptorPoolCreateInfo, nullptr, &mPipelineDescriptorPool));
-
-        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
-        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        descriptorSetAllocateInfo.pNext = NULL;
-        descriptorSetAllocateInfo.descriptorPool = mPipelineDescriptorPool;
-        descriptorSetAllocateInfo.pSetLayouts = &mPipelineDescriptorSetLayout;
-        descriptorSetAllocateInfo.descriptorSetCount = 1;
-        vkTools::VkErrorCheck(vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &mPipelineDescriptorSet));
-
-        VkComputePipelineCreateInfo computePipelineCreateInfo;
-        computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-        computePipelineCreateInfo.pNext = NULL;
-        computePipelineCreateInfo.flags = 0;
-        computePipelineCreateInfo.stage = vkTools::CreatePipelineShaderStageCreateInfo(mDevice, mComputeShaderModule, VK_SHADER_STAGE_COMPUTE_BIT, "main");;
-        computePipelineCreateInfo.layout = mPipelineLayout;
-        computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-        computePipelineCreateInfo.basePipelineIndex = NULL;
-        vkTools::VkErrorCheck(vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &mPipeline));
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * mMetaData.gridCellCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mGridCellStartBuffer, mGridCellStartBufferMemory, minOffsetAligment
+        );
+    mGridPrefixSum = new PrefixSum(mDevice, mPhysicalDevice, mMetaData.gridCellCount, mWorkGroupSize);
+
+    // Morton sort and tree created on first use.
+    mMortonSort = nullptr;
+    mTreeNodeCount = 0;
+
+    // Create compute pipelines.
+    {
+        mPreparePipeline = new ComputePipeline(mDevice, "resources/shaders/Particles_Prepare_CS.spv", {
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input indirect arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output indirect arguments.
+        }, { mWorkGroupSize }, gSubstepDescriptorSetCount * mFrameCount);
+
+        // Specialization constant 1 selects structure of arrays layout.
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+            std::vector<uint32_t> specializationList{ mWorkGroupSize, soa };
+
+            mEmitPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Emit_CS.spv", {
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output particles.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output alive indices.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output indirect arguments.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Dead indices.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, // Emitters.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output positions.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output velocities.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output colors.
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output scales.
+            }, specializationList, mFrameCount);
+        }
+
+        // Integrator selected by specialization constant.
+        CreateUpdatePipelines();
+
+        // Specialization constant 2 selects fluid pass.
+        std::vector<VkDescriptorType> fluidDescriptorTypeList{
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input positions.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input velocities.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Meta data.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Fluid parameters.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input indirect arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid cell counts.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid cell starts.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Densities.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Accelerations.
+        };
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+            mFluidDensityPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Fluid_CS.spv", fluidDescriptorTypeList, { mWorkGroupSize, soa, 0 }, gSubstepDescriptorSetCount * mFrameCount);
+            mFluidForcePipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Fluid_CS.spv", fluidDescriptorTypeList, { mWorkGroupSize, soa, 1 }, gSubstepDescriptorSetCount * mFrameCount);
+        }
+
+        // Specialization constant 2 selects grid pass.
+        std::vector<VkDescriptorType> gridDescriptorTypeList{
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input positions.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Meta data.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input alive indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input indirect arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid cell counts.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid cell starts.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid entries.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid indices.
+        };
+        mGridClearPipeline = new ComputePipeline(mDevice, "resources/shaders/Particles_Grid_CS.spv", gridDescriptorTypeList, { mWorkGroupSize, VK_FALSE, 0 }, gSubstepDescriptorSetCount * mFrameCount);
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+            mGridAssignPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Grid_CS.spv", gridDescriptorTypeList, { mWorkGroupSize, soa, 1 }, gSubstepDescriptorSetCount * mFrameCount);
+        }
+        mGridScatterPipeline = new ComputePipeline(mDevice, "resources/shaders/Particles_Grid_CS.spv", gridDescriptorTypeList, { mWorkGroupSize, VK_FALSE, 2 }, gSubstepDescriptorSetCount * mFrameCount);
+
+        // Specialization constant 2 selects Morton pass.
+        std::vector<VkDescriptorType> mortonDescriptorTypeList{
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Particle copy.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output particles.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output velocities.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output colors.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output scales.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Meta data.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output alive indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output indirect arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Dead indices.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Sort keys.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Sort values.
+        };
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+            // Descriptor set 0 keys output particles for sort, 1 onwards key input particles of each substep for tree.
+            mMortonKeyPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Morton_CS.spv", mortonDescriptorTypeList, { mWorkGroupSize, soa, 0 }, (1 + gSubstepDescriptorSetCount) * mFrameCount);
+            mMortonGatherPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Morton_CS.spv", mortonDescriptorTypeList, { mWorkGroupSize, soa, 1 }, mFrameCount);
+        }
+
+        // One tile per work group until set.
+        CreateGravityPipelines(mWorkGroupSize);
+
+        // Specialization constant 2 selects tree pass.
+        std::vector<VkDescriptorType> treeDescriptorTypeList{
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input positions.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input velocities.
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Gravity parameters.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input indirect arguments.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Sort keys.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Sort values.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Tree nodes.
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Accelerations.
+        };
+        for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        {
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+            mTreeBuildPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_BarnesHut_CS.spv", treeDescriptorTypeList, { mWorkGroupSize, soa, 0 }, gSubstepDescriptorSetCount * mFrameCount);
+            mTreeSumPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_BarnesHut_CS.spv", treeDescriptorTypeList, { mWorkGroupSize, soa, 1 }, gSubstepDescriptorSetCount * mFrameCount);
+            mTreeTraversePipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_BarnesHut_CS.spv", treeDescriptorTypeList, { mWorkGroupSize, soa, 2 }, gSubstepDescriptorSetCount * mFrameCount);
+        }
     }
 }
 
 ParticleUpdateSystem::~ParticleUpdateSystem()
 {
-    vkFreeMemory(mDevice, mMetaDataBufferMemory, nullptr);
-    vkDestroyBuffer(mDevice, mMetaDataBuffer, nullptr);
+    delete mUniformRing;
+
+    vkFreeMemory(mDevice, mGridCellCountBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mGridCellCountBuffer, nullptr);
+    vkFreeMemory(mDevice, mGridCellStartBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mGridCellStartBuffer, nullptr);
+
+    delete mPreparePipeline;
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+    {
+        delete mEmitPipeline[layout];
+        delete mGridAssignPipeline[layout];
+        delete mMortonKeyPipeline[layout];
+        delete mMortonGatherPipeline[layout];
+        delete mFluidDensityPipeline[layout];
+        delete mFluidForcePipeline[layout];
+        delete mTreeBuildPipeline[layout];
+        delete mTreeSumPipeline[layout];
+        delete mTreeTraversePipeline[layout];
+    }
+    if (mTreeNodeCount > 0)
+    {
+        vkFreeMemory(mDevice, mTreeNodeBufferMemory, nullptr);
+        vkDestroyBuffer(mDevice, mTreeNodeBuffer, nullptr);
+    }
+    DestroyMortonSort();
+    DestroyUpdatePipelines();
+    DestroyGravityPipelines();
+    delete mPlaceholderTexture;
+    delete mGridClearPipeline;
+    delete mGridScatterPipeline;
+    delete mGridPrefixSum;
+}
 
-    vkDestroyShaderModule(mDevice, mComputeShaderModule, nullptr);
+bool ParticleUpdateSystem::Structure::operator==(const Structure& other) const
+{
+    return bufferList == other.bufferList && version == other.version && substepCount == other.substepCount && emit == other.emit && sort == other.sort;
+}
 
-    vkDestroyPipeline(mDevice, mPipeline, nullptr);
-    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
-    vkDestroyDescriptorSetLayout(mDevice, mPipelineDescriptorSetLayout, nullptr);
-    vkFreeDescriptorSets(mDevice, mPipelineDescriptorPool, 1, &mPipelineDescriptorSet);
-    vkDestroyDescriptorPool(mDevice, mPipelineDescriptorPool, nullptr);
+void ParticleUpdateSystem::Update(VkCommandBuffer commandBuffer, Scene* scene, float dt, unsigned int frameIndex, VkTimer* treeBuildTimer, VkTimer* treeTraverseTimer)
+{
+    Prepare(scene, dt, frameIndex);
+    Record(commandBuffer, scene, treeBuildTimer, treeTraverseTimer);
 }
 
-void ParticleUpdateSystem::Update(VkCommandBuffer commandBuffer, Scene* scene, float dt)
+ParticleUpdateSystem::Structure ParticleUpdateSystem::Prepare(Scene* scene, float dt, unsigned int frameIndex)
 {
+    // Uniform ring regions and descriptor sets of other frames in flight may be in use.
+    mFrameSlot = frameIndex % mFrameCount;
+    mUniformRing->BeginFrame(frameIndex);
+
+    // Neighbors read in place would be a mix of old and new state.
+    assert(scene->mParticleStorage != Scene::PARTICLE_STORAGE_IN_PLACE || SupportsInPlaceUpdate());
+
+    // Fixed steps due this frame. Time past max substeps is dropped, so slow frames do not demand ever more steps.
+    mSubstepCount = 1;
+    if (mFixedTimestep > 0.f)
+    {
+        mTimeAccumulator += dt;
+        mSubstepCount = (std::min)((unsigned int)(mTimeAccumulator / mFixedTimestep), mMaxSubstepCount);
+        mTimeAccumulator = (std::min)(mTimeAccumulator - mSubstepCount * mFixedTimestep, mFixedTimestep);
+        dt = mFixedTimestep;
+    }
+
     mMetaData.dt = dt;
-    mMetaData.particleCount = scene->mParticleCount;
-    vkTools::WriteBuffer(commandBuffer, mDevice, mMetaDataBufferMemory, &mMetaData, sizeof(MetaData), 0);
-
-    {   // vkUpdateDescriptorSets.
-        VkDescriptorBufferInfo particleInBufferInputDescriptorBufferInfo;
-        VkWriteDescriptorSet particleInBufferInputWriteDescriptorSet;
-        particleInBufferInputDescriptorBufferInfo.buffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
-        particleInBufferInputDescriptorBufferInfo.offset = 0;
-        particleInBufferInputDescriptorBufferInfo.range = scene->mParticleBuffer->GetInputBuffer()->GetSize();
-        particleInBufferInputWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        particleInBufferInputWriteDescriptorSet.pNext = NULL;
-        particleInBufferInputWriteDescriptorSet.dstSet = mPipelineDescriptorSet;
-        particleInBufferInputWriteDescriptorSet.dstArrayElement = 0;
-        particleInBufferInputWriteDescriptorSet.descriptorCount = 1;
-        particleInBufferInputWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        particleInBufferInputWriteDescriptorSet.pImageInfo = NULL;
-        particleInBufferInputWriteDescriptorSet.dstBinding = 0;
-        particleInBufferInputWriteDescriptorSet.pBufferInfo = &particleInBufferInputDescriptorBufferInfo;
-
-        VkDescriptorBufferInfo particleOutBufferInputDescriptorBufferInfo;
-        VkWriteDescriptorSet particleOutBufferInputWriteDescriptorSet;
-        particleOutBufferInputDescriptorBufferInfo.buffer = scene->mParticleBuffer->GetOutputBuffer()->mBuffer;
-        particleOutBufferInputDescriptorBufferInfo.offset = 0;
-        particleOutBufferInputDescriptorBufferInfo.range = scene->mParticleBuffer->GetOutputBuffer()->GetSize();
-        particleOutBufferInputWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        particleOutBufferInputWriteDescriptorSet.pNext = NULL;
-        particleOutBufferInputWriteDescriptorSet.dstSet = mPipelineDescriptorSet;
-        particleOutBufferInputWriteDescriptorSet.dstArrayElement = 0;
-        particleOutBufferInputWriteDescriptorSet.descriptorCount = 1;
-        particleOutBufferInputWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        particleOutBufferInputWriteDescriptorSet.pImageInfo = NULL;
-        particleOutBufferInputWriteDescriptorSet.dstBinding = 1;
-        particleOutBufferInputWriteDescriptorSet.pBufferInfo = &particleOutBufferInputDescriptorBufferInfo;
-
-        VkDescriptorBufferInfo metaBufferInputDescriptorBufferInfo;
-        VkWriteDescriptorSet metaBufferInputWriteDescriptorSet;
-        metaBufferInputDescriptorBufferInfo.buffer = mMetaDataBuffer;
-        metaBufferInputDescriptorBufferInfo.offset = 0;
-        metaBufferInputDescriptorBufferInfo.range = sizeof(MetaData);
-        metaBufferInputWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        metaBufferInputWriteDescriptorSet.pNext = NULL;
-        metaBufferInputWriteDescriptorSet.dstSet = mPipelineDescriptorSet;
-        metaBufferInputWriteDescriptorSet.dstArrayElement = 0;
-        metaBufferInputWriteDescriptorSet.descriptorCount = 1;
-        metaBufferInputWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        metaBufferInputWriteDescriptorSet.pImageInfo = NULL;
-        metaBufferInputWriteDescriptorSet.dstBinding = 2;
-        metaBufferInputWriteDescriptorSet.pBufferInfo = &metaBufferInputDescriptorBufferInfo;
-
-        std::vector<VkWriteDescriptorSet> writeDescriptorSetList{ particleInBufferInputWriteDescriptorSet, particleOutBufferInputWriteDescriptorSet, metaBufferInputWriteDescriptorSet };
-        vkUpdateDescriptorSets(mDevice, writeDescriptorSetList.size(), writeDescriptorSetList.data(), 0, NULL);
-    }
-    
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &mPipelineDescriptorSet, 0, NULL);
-    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    mMetaData.maxParticleCount = scene->mMaxParticleCount;
+    mMetaData.sortBoundsMin = glm::vec4(scene->mSortBoundsMin, 0.f);
+    mMetaData.sortBoundsMax = glm::vec4(scene->mSortBoundsMax, 0.f);
+    bool fluid = mMode == MODE_FLUID;
+    // Grid cells hold collision contacts and fluid kernel.
+    mMetaData.gridCellSize = (std::max)(2.f * mMetaData.collisionRadius, fluid ? mFluidParameters.smoothingRadius : 0.f);
+
+    // Bound force fields in slot order.
+    mBoundForceFieldList.clear();
+    for (unsigned int slot = 0; slot < MAX_FORCE_FIELDS; ++slot)
+    {
+        if (mForceFieldList[slot] != nullptr)
+        {
+            mForceFieldParameters.volumes[mBoundForceFieldList.size()] = mForceFieldVolumeList[slot];
+            mBoundForceFieldList.push_back(mForceFieldList[slot]);
+        }
+    }
+    mForceFieldParameters.count = (unsigned int)mBoundForceFieldList.size();
+
+    mMetaData.flags = GetUpdateFlags();
+    // Cold streams are copied through by update only in frames that write them, output shares input otherwise.
+    if (scene->mParticleLayout == Scene::PARTICLE_LAYOUT_SOA)
+    {
+        bool emit = !scene->mEmitterList.empty();
+        if (emit || (mMetaData.flags & gFlagSyntheticLoad) != 0)
+            mMetaData.flags |= gFlagColorOutput;
+        if (emit)
+            mMetaData.flags |= gFlagScaleOutput;
+    }
+    if (mDistanceField != nullptr)
+    {
+        mMetaData.distanceFieldBoundsMin = glm::vec4(mDistanceField->mBoundsMin, mMetaData.distanceFieldBoundsMin.w);
+        mMetaData.distanceFieldBoundsMax = glm::vec4(mDistanceField->mBoundsMax, mMetaData.distanceFieldBoundsMax.w);
+    }
+
+    // Number of particles to spawn this frame, clamped to scene capacity. Spawned by first substep.
+    unsigned int maxEmitCount = 0;
+    ParticleEmitter emitterList[Scene::mMaxEmitterCount];
+    for (std::size_t i = 0; i < scene->mEmitterList.size(); ++i)
+    {
+        ParticleEmitter& emitter = scene->mEmitterList[i];
+        if (mSubstepCount > 0)
+        {
+            float& accumulator = scene->mEmitAccumulatorList[i];
+            accumulator = (std::min)(accumulator + emitter.rate * dt * mSubstepCount, (float)scene->mMaxParticleCount);
+            emitter.emitCount = (unsigned int)accumulator;
+            emitter.seed = mFrameIndex * (unsigned int)scene->mMaxEmitterCount + (unsigned int)i;
+            accumulator -= emitter.emitCount;
+        }
+        maxEmitCount = (std::max)(maxEmitCount, emitter.emitCount);
+        emitterList[i] = emitter;
+    }
+    // Threads of most particles spawned by one emitter, for each emitter. Groups past max group count of X continue in Z.
+    VkDispatchIndirectCommand emitArguments;
+    uint32_t emitGroupCount = (maxEmitCount + mWorkGroupSize - 1) / mWorkGroupSize;
+    emitArguments.z = (std::max)((emitGroupCount + ComputePipeline::mMaxGroupCount - 1) / ComputePipeline::mMaxGroupCount, 1u);
+    emitArguments.x = (emitGroupCount + emitArguments.z - 1) / emitArguments.z;
+    emitArguments.y = (uint32_t)scene->mEmitterList.size();
+    if (mSubstepCount > 0)
+        ++mFrameIndex;
+
+    // Output is not read by render this frame, so it can be reordered while input is drawn.
+    mSort = false;
+    if (mSubstepCount > 0 && scene->mSortFrameInterval > 0 && ++scene->mSortFrameCounter >= scene->mSortFrameInterval)
+    {
+        scene->mSortFrameCounter = 0;
+        mSort = true;
+    }
+
+    // Blocks unused this frame are pushed too, every dynamic binding needs a valid offset.
+    // Same order every frame, so offsets of a frame in flight do not change.
+    mMetaDataOffset = mUniformRing->Push(&mMetaData, sizeof(MetaData));
+    mForceFieldParametersOffset = mUniformRing->Push(&mForceFieldParameters, sizeof(ForceFieldParameters));
+    mFluidParametersOffset = mUniformRing->Push(&mFluidParameters, sizeof(FluidParameters));
+    mGravityParametersOffset = mUniformRing->Push(&mGravityParameters, sizeof(GravityParameters));
+    mEmittersOffset = mUniformRing->Push(emitterList, sizeof(emitterList));
+    mEmitArgumentsOffset = mUniformRing->Push(&emitArguments, sizeof(VkDispatchIndirectCommand));
+    SetUniformOffsets();
+
+    Structure structure;
+    scene->GetSwapState(structure.bufferList);
+    structure.version = mStructureVersion;
+    structure.substepCount = mSubstepCount;
+    structure.emit = !scene->mEmitterList.empty();
+    structure.sort = mSort;
+    return structure;
+}
+
+void ParticleUpdateSystem::Record(VkCommandBuffer commandBuffer, Scene* scene, VkTimer* treeBuildTimer, VkTimer* treeTraverseTimer)
+{
+    bool writeColor = (mMetaData.flags & gFlagColorOutput) != 0;
+    bool writeScale = (mMetaData.flags & gFlagScaleOutput) != 0;
+
+    // Resubmitted commands swap buffers as when recorded.
+    if (commandBuffer == VK_NULL_HANDLE)
+    {
+        if (mSubstepCount == 0)
+        {
+            scene->PrepareColdStreams(false, false);
+            return;
+        }
+        for (unsigned int substep = 0; substep < mSubstepCount; ++substep)
+        {
+            if (substep > 0)
+                scene->Substep();
+            scene->PrepareColdStreams(writeColor, writeScale);
+        }
+        scene->EndSubsteps();
+        if (mSort)
+            scene->PrepareColdStreams(true, true);
+        return;
+    }
+
+    if (mPlaceholderTexture == nullptr)
+    {
+        // Uploaded by this command buffer.
+        uint16_t texel[4] = { 0, 0, 0, 0 };
+        mPlaceholderTexture = new Texture3D(mDevice, mPhysicalDevice, commandBuffer, glm::uvec3(1), texel, sizeof(texel));
+    }
+
+    // Input, dead stack and scratch buffers were written by the update of the previous frame on this queue.
+    // Only render semaphores order submissions, and ownership transfers are skipped within one queue family.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+    // Output may have been drawn by render on another queue family.
+    scene->AcquireUpdateBuffers(commandBuffer);
+
+    // No step due, output is input so render of next frame shows the same state.
+    if (mSubstepCount == 0)
+    {
+        scene->PrepareColdStreams(false, false);
+        if (scene->mParticleStorage != Scene::PARTICLE_STORAGE_IN_PLACE)
+        {
+            scene->mParticleBuffer->GetOutputBuffer()->Copy(commandBuffer, scene->mParticleBuffer->GetInputBuffer());
+            if (scene->mVelocityBuffer != nullptr)
+                scene->mVelocityBuffer->GetOutputBuffer()->Copy(commandBuffer, scene->mVelocityBuffer->GetInputBuffer());
+        }
+        scene->mAliveIndexBuffer->GetOutputBuffer()->Copy(commandBuffer, scene->mAliveIndexBuffer->GetInputBuffer());
+        scene->mIndirectBuffer->GetOutputBuffer()->Copy(commandBuffer, scene->mIndirectBuffer->GetInputBuffer());
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        scene->ReleaseUpdateBuffers(commandBuffer);
+        return;
+    }
+
+    // Substeps ping-pong swap buffers. Input of frame is not written, render may read it while update runs.
+    for (unsigned int substep = 0; substep < mSubstepCount; ++substep)
+    {
+        if (substep > 0)
+        {
+            scene->Substep();
+            vkTools::PipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        }
+        scene->PrepareColdStreams(writeColor, writeScale);
+        // Substeps after first alternate between two buffer sets, each with own descriptor sets.
+        mSubstepDescriptorSet = mFrameSlot * gSubstepDescriptorSetCount + (substep == 0 ? 0 : 1 + (substep - 1) % 2);
+        Step(commandBuffer, scene, substep == 0 && !scene->mEmitterList.empty(), substep == 0 ? treeBuildTimer : nullptr, substep == 0 ? treeTraverseTimer : nullptr);
+    }
+    scene->EndSubsteps();
+
+    if (mSort)
+        SortParticles(commandBuffer, scene);
+
+    // Input is drawn by render of this frame.
+    scene->ReleaseUpdateBuffers(commandBuffer);
+}
+
+void ParticleUpdateSystem::Step(VkCommandBuffer commandBuffer, Scene* scene, bool emit, VkTimer* treeBuildTimer, VkTimer* treeTraverseTimer)
+{
+    bool fluid = mMode == MODE_FLUID;
+    bool gravity = mMode == MODE_GRAVITY || mMode == MODE_BARNES_HUT;
+
+    VkBuffer particleInBuffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
+    VkBuffer particleOutBuffer = scene->mParticleBuffer->GetOutputBuffer()->mBuffer;
+    VkBuffer aliveInBuffer = scene->mAliveIndexBuffer->GetInputBuffer()->mBuffer;
+    VkBuffer aliveOutBuffer = scene->mAliveIndexBuffer->GetOutputBuffer()->mBuffer;
+    VkBuffer indirectInBuffer = scene->mIndirectBuffer->GetInputBuffer()->mBuffer;
+    VkBuffer indirectOutBuffer = scene->mIndirectBuffer->GetOutputBuffer()->mBuffer;
+    VkBuffer deadBuffer = scene->mDeadIndexBuffer->mBuffer;
+
+    // Attribute streams. Bindings of the unused layout are never accessed, but must be valid.
+    Scene::ParticleLayout layout = scene->mParticleLayout;
+    bool soa = layout == Scene::PARTICLE_LAYOUT_SOA;
+    VkBuffer velocityInBuffer = soa ? scene->mVelocityBuffer->GetInputBuffer()->mBuffer : particleInBuffer;
+    VkBuffer velocityOutBuffer = soa ? scene->mVelocityBuffer->GetOutputBuffer()->mBuffer : particleOutBuffer;
+    VkBuffer colorInBuffer = soa ? scene->mColorBuffer->GetInputBuffer()->mBuffer : particleInBuffer;
+    VkBuffer colorOutBuffer = soa ? scene->mColorBuffer->GetOutputBuffer()->mBuffer : particleOutBuffer;
+    VkBuffer scaleInBuffer = soa ? scene->mScaleBuffer->GetInputBuffer()->mBuffer : particleInBuffer;
+    VkBuffer scaleOutBuffer = soa ? scene->mScaleBuffer->GetOutputBuffer()->mBuffer : particleOutBuffer;
+
+    // Prepare.
+    mPreparePipeline->UpdateDescriptorSet({ indirectInBuffer, indirectOutBuffer }, mSubstepDescriptorSet);
+    mPreparePipeline->Dispatch(commandBuffer, 1, 1, 1, mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+    // Emit, emitters and group counts written by host this frame.
+    if (emit)
+    {
+        mEmitPipeline[layout]->UpdateDescriptorSet({ particleOutBuffer, aliveOutBuffer, indirectOutBuffer, deadBuffer, mUniformRing->mBuffer, particleOutBuffer, velocityOutBuffer, colorOutBuffer, scaleOutBuffer }, mFrameSlot);
+        mEmitPipeline[layout]->DispatchIndirect(commandBuffer, mUniformRing->mBuffer, mEmitArgumentsOffset, mFrameSlot);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    // Neighbor queries of update read grid.
+    if (mMetaData.gridCellSize > 0.f)
+        BuildGrid(commandBuffer, scene);
+
+    // Fluid accelerations integrated by update.
+    if (fluid)
+    {
+        std::vector<VkBuffer> fluidBufferList{ particleInBuffer, velocityInBuffer, mUniformRing->mBuffer, mUniformRing->mBuffer, indirectInBuffer,
+            mGridCellCountBuffer, mGridCellStartBuffer, scene->mGridIndexBuffer->mBuffer, scene->mDensityBuffer->mBuffer, scene->mAccelerationBuffer->mBuffer };
+
+        mFluidDensityPipeline[layout]->UpdateDescriptorSet(fluidBufferList, mSubstepDescriptorSet);
+        mFluidDensityPipeline[layout]->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        mFluidForcePipeline[layout]->UpdateDescriptorSet(fluidBufferList, mSubstepDescriptorSet);
+        mFluidForcePipeline[layout]->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    // Gravity accelerations integrated by update.
+    if (mMode == MODE_BARNES_HUT)
+        UpdateBarnesHut(commandBuffer, scene, treeBuildTimer, treeTraverseTimer);
+    else if (gravity)
+    {
+        mGravityPipeline[layout]->UpdateDescriptorSet({ particleInBuffer, velocityInBuffer, mUniformRing->mBuffer, aliveInBuffer, indirectInBuffer, scene->mAccelerationBuffer->mBuffer }, mSubstepDescriptorSet);
+        mGravityPipeline[layout]->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    // Update alive particles, group count written by prepare.
+    ComputePipeline* updatePipeline = mUpdatePipeline[layout][scene->mParticleStorage];
+    updatePipeline->UpdateDescriptorSet({ particleInBuffer, particleOutBuffer, mUniformRing->mBuffer, aliveInBuffer, aliveOutBuffer, indirectInBuffer, indirectOutBuffer, deadBuffer,
+        particleInBuffer, particleOutBuffer, velocityInBuffer, velocityOutBuffer, colorInBuffer, colorOutBuffer, scaleInBuffer, scaleOutBuffer,
+        mGridCellCountBuffer, mGridCellStartBuffer, scene->mGridIndexBuffer->mBuffer, scene->mAccelerationBuffer->mBuffer, mUniformRing->mBuffer }, mSubstepDescriptorSet);
+    // Texture bindings without texture get placeholder.
+    Texture3D* distanceFieldTexture = mDistanceField != nullptr ? mDistanceField->mTexture : mPlaceholderTexture;
+    updatePipeline->UpdateImageDescriptor(21, distanceFieldTexture->mImageView, distanceFieldTexture->mSampler, mSubstepDescriptorSet);
+    for (unsigned int i = 0; i < MAX_FORCE_FIELDS; ++i)
+    {
+        Texture3D* forceFieldTexture = i < mBoundForceFieldList.size() ? mBoundForceFieldList[i]->mTexture : mPlaceholderTexture;
+        updatePipeline->UpdateImageDescriptor(22 + i, forceFieldTexture->mImageView, forceFieldTexture->mSampler, mSubstepDescriptorSet);
+    }
+    updatePipeline->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+}
+
+void ParticleUpdateSystem::SetUniformOffsets()
+{
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+    {
+        mEmitPipeline[layout]->SetDynamicUniform(4, sizeof(ParticleEmitter) * Scene::mMaxEmitterCount, mEmittersOffset);
+        for (unsigned int storage = 0; storage < Scene::PARTICLE_STORAGE_COUNT; ++storage)
+        {
+            mUpdatePipeline[layout][storage]->SetDynamicUniform(2, sizeof(MetaData), mMetaDataOffset);
+            mUpdatePipeline[layout][storage]->SetDynamicUniform(20, sizeof(ForceFieldParameters), mForceFieldParametersOffset);
+        }
+        mFluidDensityPipeline[layout]->SetDynamicUniform(2, sizeof(MetaData), mMetaDataOffset);
+        mFluidDensityPipeline[layout]->SetDynamicUniform(3, sizeof(FluidParameters), mFluidParametersOffset);
+        mFluidForcePipeline[layout]->SetDynamicUniform(2, sizeof(MetaData), mMetaDataOffset);
+        mFluidForcePipeline[layout]->SetDynamicUniform(3, sizeof(FluidParameters), mFluidParametersOffset);
+        mGridAssignPipeline[layout]->SetDynamicUniform(1, sizeof(MetaData), mMetaDataOffset);
+        mMortonKeyPipeline[layout]->SetDynamicUniform(5, sizeof(MetaData), mMetaDataOffset);
+        mMortonGatherPipeline[layout]->SetDynamicUniform(5, sizeof(MetaData), mMetaDataOffset);
+        mGravityPipeline[layout]->SetDynamicUniform(2, sizeof(GravityParameters), mGravityParametersOffset);
+        mTreeBuildPipeline[layout]->SetDynamicUniform(2, sizeof(GravityParameters), mGravityParametersOffset);
+        mTreeSumPipeline[layout]->SetDynamicUniform(2, sizeof(GravityParameters), mGravityParametersOffset);
+        mTreeTraversePipeline[layout]->SetDynamicUniform(2, sizeof(GravityParameters), mGravityParametersOffset);
+    }
+    mGridClearPipeline->SetDynamicUniform(1, sizeof(MetaData), mMetaDataOffset);
+    mGridScatterPipeline->SetDynamicUniform(1, sizeof(MetaData), mMetaDataOffset);
+}
+
+void ParticleUpdateSystem::SetCollision(float radius, float stiffness, float damping)
+{
+    mMetaData.collisionRadius = radius;
+    mMetaData.collisionStiffness = stiffness;
+    mMetaData.collisionDamping = damping;
+    ++mStructureVersion;
+}
+
+void ParticleUpdateSystem::SetDistanceField(SignedDistanceField* distanceField, float particleRadius, float restitution)
+{
+    mDistanceField = distanceField;
+    mMetaData.distanceFieldBoundsMin.w = particleRadius;
+    mMetaData.distanceFieldBoundsMax.w = restitution;
+    ++mStructureVersion;
+}
+
+void ParticleUpdateSystem::SetForceField(unsigned int slot, VectorField* vectorField, const glm::mat4& transform, float strength, float drag)
+{
+    assert(slot < MAX_FORCE_FIELDS);
+    mForceFieldList[slot] = vectorField;
+    ++mStructureVersion;
+    if (vectorField == nullptr)
+        return;
+
+    ForceFieldVolume& volume = mForceFieldVolumeList[slot];
+    volume.worldToField = glm::inverse(transform);
+    volume.fieldToWorld = glm::mat4(
+        glm::vec4(glm::normalize(glm::vec3(transform[0])), 0.f),
+        glm::vec4(glm::normalize(glm::vec3(transform[1])), 0.f),
+        glm::vec4(glm::normalize(glm::vec3(transform[2])), 0.f),
+        glm::vec4(0.f, 0.f, 0.f, 1.f));
+    volume.parameters = glm::vec4(strength, drag, vectorField->mNoiseFrequency, (float)vectorField->mNoiseSeed);
+}
+
+void ParticleUpdateSystem::SetAnalyticNoise(bool analyticNoise)
+{
+    mForceFieldParameters.analyticNoise = analyticNoise ? VK_TRUE : VK_FALSE;
+}
+
+void ParticleUpdateSystem::SetIntegrator(Integrator integrator)
+{
+    if (integrator == mIntegrator)
+        return;
+
+    // Pipelines may still be in use.
+    vkDeviceWaitIdle(mDevice);
+    DestroyUpdatePipelines();
+    mIntegrator = integrator;
+    CreateUpdatePipelines();
+    ++mStructureVersion;
+}
+
+void ParticleUpdateSystem::SetFixedTimestep(float timestep, unsigned int maxSubstepCount)
+{
+    mFixedTimestep = timestep;
+    mMaxSubstepCount = (std::max)(maxSubstepCount, 1u);
+    mTimeAccumulator = 0.f;
+}
+
+ParticleUpdateSystem::ParticleAccess ParticleUpdateSystem::GetUpdateParticleAccess() const
+{
+    return GetParticleAccess(GetUpdateFlags());
+}
+
+bool ParticleUpdateSystem::SupportsInPlaceUpdate() const
+{
+    return GetUpdateParticleAccess() == PARTICLE_ACCESS_SELF;
+}
+
+bool ParticleUpdateSystem::SupportsInPlaceUpdate(float collisionRadius)
+{
+    return GetParticleAccess(GetCollisionFlags(collisionRadius)) == PARTICLE_ACCESS_SELF;
+}
+
+unsigned int ParticleUpdateSystem::GetUpdateFlags() const
+{
+    bool forceField = false;
+    for (unsigned int slot = 0; slot < MAX_FORCE_FIELDS; ++slot)
+        forceField = forceField || mForceFieldList[slot] != nullptr;
+
+    unsigned int flags = mMode != MODE_DEFAULT ? gFlagAcceleration : forceField ? 0 : gFlagSyntheticLoad;
+    if (forceField)
+        flags |= gFlagForceField;
+    if (mDistanceField != nullptr)
+        flags |= gFlagDistanceField;
+    return flags | GetCollisionFlags(mMetaData.collisionRadius);
+}
+
+void ParticleUpdateSystem::SetMode(Mode mode)
+{
+    mMode = mode;
+    ++mStructureVersion;
+}
+
+void ParticleUpdateSystem::SetFluidParameters(const FluidParameters& parameters)
+{
+    mFluidParameters = parameters;
+    ++mStructureVersion;
+}
+
+void ParticleUpdateSystem::SetGravity(float gravitationalConstant, float softening, unsigned int tileSize)
+{
+    mGravityParameters.gravitationalConstant = gravitationalConstant;
+    mGravityParameters.softening = softening;
+
+    // Every thread loads the same number of bodies per tile.
+    tileSize = tileSize == 0 ? mWorkGroupSize : (tileSize + mWorkGroupSize - 1) / mWorkGroupSize * mWorkGroupSize;
+    if (tileSize != mGravityTileSize)
+    {
+        // Pipelines may still be in use.
+        vkDeviceWaitIdle(mDevice);
+        DestroyGravityPipelines();
+        CreateGravityPipelines(tileSize);
+        ++mStructureVersion;
+    }
+}
+
+void ParticleUpdateSystem::SetBarnesHut(float openingAngle)
+{
+    mGravityParameters.openingAngle = openingAngle;
+}
+
+unsigned int ParticleUpdateSystem::GetGravityTileSize() const
+{
+    return mGravityTileSize;
+}
+
+void ParticleUpdateSystem::UpdateFluidCPU(std::vector<uint32_t>& indexList, std::vector<Particle>& particleList, const FluidParameters& parameters, Integrator integrator, float dt)
+{
+    assert(indexList.size() == particleList.size());
+
+    const float pi = 3.14159265f;
+    float h = parameters.smoothingRadius;
+    float h2 = h * h;
+    float poly6 = 315.f / (64.f * pi * std::pow(h, 9.f));
+    float spikyGradient = -45.f / (pi * std::pow(h, 6.f));
+    float viscosityLaplacian = 45.f / (pi * std::pow(h, 6.f));
+
+    // Grid of cell size h, 21 bits per axis.
+    auto CellKey = [h](const glm::vec3& position, int x, int y, int z)
+    {
+        glm::ivec3 cell = glm::ivec3(glm::floor(position / h)) + glm::ivec3(x, y, z);
+        return ((long long)(cell.x & 0x1FFFFF) << 42) | ((long long)(cell.y & 0x1FFFFF) << 21) | (long long)(cell.z & 0x1FFFFF);
+    };
+    std::unordered_map<long long, std::vector<std::size_t>> grid;
+    for (std::size_t i = 0; i < particleList.size(); ++i)
+        grid[CellKey(glm::vec3(particleList[i].position), 0, 0, 0)].push_back(i);
+    auto ForEachNeighbor = [&](const glm::vec3& position, const std::function<void(std::size_t)>& function)
+    {
+        for (int z = -1; z <= 1; ++z)
+            for (int y = -1; y <= 1; ++y)
+                for (int x = -1; x <= 1; ++x)
+                {
+                    auto it = grid.find(CellKey(position, x, y, z));
+                    if (it != grid.end())
+                        for (std::size_t j : it->second)
+                            function(j);
+                }
+    };
+
+    // Density and pressure.
+    std::vector<glm::vec2> densityList(particleList.size());
+    for (std::size_t i = 0; i < particleList.size(); ++i)
+    {
+        glm::vec3 position = glm::vec3(particleList[i].position);
+        float sum = 0.f;
+        ForEachNeighbor(position, [&](std::size_t j)
+        {
+            glm::vec3 delta = position - glm::vec3(particleList[j].position);
+            float r2 = glm::dot(delta, delta);
+            if (r2 < h2)
+                sum += poly6 * (h2 - r2) * (h2 - r2) * (h2 - r2);
+        });
+        float rho = parameters.particleMass * sum;
+        densityList[i] = glm::vec2(rho, (std::max)(parameters.stiffness * (rho - parameters.restDensity), 0.f));
+    }
+
+    // Accelerations.
+    std::vector<glm::vec3> accelerationList(particleList.size());
+    for (std::size_t i = 0; i < particleList.size(); ++i)
+    {
+        glm::vec3 position = glm::vec3(particleList[i].position);
+        glm::vec3 velocity = glm::vec3(particleList[i].velocity);
+        glm::vec3 force(0.f);
+        ForEachNeighbor(position, [&](std::size_t j)
+        {
+            glm::vec3 delta = position - glm::vec3(particleList[j].position);
+            float r2 = glm::dot(delta, delta);
+            if (j != i && r2 < h2 && r2 > 0.f)
+            {
+                float r = std::sqrt(r2);
+                float w = h - r;
+                force -= parameters.particleMass * (densityList[i].y + densityList[j].y) / (2.f * densityList[j].x) * spikyGradient * w * w * (delta / r);
+                force += parameters.viscosity * parameters.particleMass * (glm::vec3(particleList[j].velocity) - velocity) / densityList[j].x * viscosityLaplacian * w;
+            }
+        });
+        glm::vec3 acceleration = force / densityList[i].x + glm::vec3(parameters.gravity);
+        acceleration += parameters.boundaryStiffness * glm::max(glm::vec3(parameters.boundsMin) - position, glm::vec3(0.f));
+        acceleration -= parameters.boundaryStiffness * glm::max(position - glm::vec3(parameters.boundsMax), glm::vec3(0.f));
+        accelerationList[i] = acceleration;
+    }
+
+    // Integrate and expire, as Particles_Update_CS. Acceleration is constant over the step, so integrators only differ in when it applies.
+    std::vector<uint32_t> aliveIndexList;
+    std::vector<Particle> aliveList;
+    aliveIndexList.reserve(indexList.size());
+    aliveList.reserve(particleList.size());
+    for (std::size_t i = 0; i < particleList.size(); ++i)
+    {
+        Particle particle = particleList[i];
+        glm::vec3 position = glm::vec3(particle.position);
+        glm::vec3 velocity = glm::vec3(particle.velocity);
+        glm::vec3 acceleration = accelerationList[i];
+        switch (integrator)
+        {
+            case INTEGRATOR_EXPLICIT_EULER:
+                position += velocity * dt;
+                velocity += acceleration * dt;
+                break;
+            case INTEGRATOR_VERLET:
+                position += velocity * dt + 0.5f * acceleration * dt * dt;
+                velocity += acceleration * dt;
+                break;
+            case INTEGRATOR_RK2:
+            {
+                glm::vec3 midVelocity = velocity + 0.5f * acceleration * dt;
+                position += midVelocity * dt;
+                velocity += acceleration * dt;
+                break;
+            }
+            default:
+                velocity += acceleration * dt;
+                position += velocity * dt;
+                break;
+        }
+        particle.position = glm::vec4(position, particle.position.w);
+        particle.velocity = glm::vec4(velocity, particle.velocity.w);
+        if (particle.position.w > 0.f)
+        {
+            particle.position.w -= dt;
+            if (particle.position.w <= 0.f)
+                continue;
+        }
+        aliveIndexList.push_back(indexList[i]);
+        aliveList.push_back(particle);
+    }
+    indexList.swap(aliveIndexList);
+    particleList.swap(aliveList);
+}
+
+void ParticleUpdateSystem::BuildGrid(VkCommandBuffer commandBuffer, Scene* scene)
+{
+    VkBuffer indirectInBuffer = scene->mIndirectBuffer->GetInputBuffer()->mBuffer;
+    std::vector<VkBuffer> bufferList{
+        scene->mParticleBuffer->GetInputBuffer()->mBuffer,
+        mUniformRing->mBuffer,
+        scene->mAliveIndexBuffer->GetInputBuffer()->mBuffer,
+        indirectInBuffer,
+        mGridCellCountBuffer,
+        mGridCellStartBuffer,
+        scene->mGridEntryBuffer->mBuffer,
+        scene->mGridIndexBuffer->mBuffer
+    };
+
+    mGridClearPipeline->UpdateDescriptorSet(bufferList, mSubstepDescriptorSet);
+    mGridClearPipeline->DispatchLinear(commandBuffer, (mMetaData.gridCellCount + mWorkGroupSize - 1) / mWorkGroupSize, mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Same group count as update.
+    ComputePipeline* assignPipeline = mGridAssignPipeline[scene->mParticleLayout];
+    assignPipeline->UpdateDescriptorSet(bufferList, mSubstepDescriptorSet);
+    assignPipeline->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    mGridPrefixSum->Scan(commandBuffer, mGridCellCountBuffer, mGridCellStartBuffer);
+
+    mGridScatterPipeline->UpdateDescriptorSet(bufferList, mSubstepDescriptorSet);
+    mGridScatterPipeline->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void ParticleUpdateSystem::SortParticles(VkCommandBuffer commandBuffer, Scene* scene)
+{
+    unsigned int maxParticleCount = scene->mMaxParticleCount;
+    Scene::ParticleLayout layout = scene->mParticleLayout;
+    bool soa = layout == Scene::PARTICLE_LAYOUT_SOA;
+    VkBuffer particleOutBuffer = scene->mParticleBuffer->GetOutputBuffer()->mBuffer;
+    VkBuffer velocityOutBuffer = soa ? scene->mVelocityBuffer->GetOutputBuffer()->mBuffer : particleOutBuffer;
+    VkBuffer colorOutBuffer = soa ? scene->mColorBuffer->GetOutputBuffer()->mBuffer : particleOutBuffer;
+    VkBuffer scaleOutBuffer = soa ? scene->mScaleBuffer->GetOutputBuffer()->mBuffer : particleOutBuffer;
+    std::vector<VkBuffer> bufferList{
+        VK_NULL_HANDLE,
+        particleOutBuffer,
+        velocityOutBuffer,
+        colorOutBuffer,
+        scaleOutBuffer,
+        mUniformRing->mBuffer,
+        scene->mAliveIndexBuffer->GetOutputBuffer()->mBuffer,
+        scene->mIndirectBuffer->GetOutputBuffer()->mBuffer,
+        scene->mDeadIndexBuffer->mBuffer,
+        VK_NULL_HANDLE,
+        VK_NULL_HANDLE
+    };
+    uint32_t groupCount = (maxParticleCount + mWorkGroupSize - 1) / mWorkGroupSize;
+
+    // Keys of particles written by update.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    SortMortonKeys(commandBuffer, scene, bufferList, mFrameSlot);
+    bufferList[0] = mMortonCopyBuffer;
+    bufferList[9] = mMortonKeyBuffer;
+    bufferList[10] = mMortonValueBuffer;
+
+    // Copy particles to gather from, one stream after another.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    VkBufferCopy bufferCopy;
+    bufferCopy.srcOffset = 0;
+    bufferCopy.dstOffset = 0;
+    if (soa)
+    {
+        VkBuffer streamBufferList[4] = { particleOutBuffer, velocityOutBuffer, colorOutBuffer, scaleOutBuffer };
+        bufferCopy.size = sizeof(glm::vec4) * maxParticleCount;
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            bufferCopy.dstOffset = i * bufferCopy.size;
+            vkCmdCopyBuffer(commandBuffer, streamBufferList[i], mMortonCopyBuffer, 1, &bufferCopy);
+        }
+    }
+    else
+    {
+        bufferCopy.size = sizeof(Particle) * maxParticleCount;
+        vkCmdCopyBuffer(commandBuffer, particleOutBuffer, mMortonCopyBuffer, 1, &bufferCopy);
+    }
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    // Sorted cold streams are gathered into buffers render does not draw.
+    scene->PrepareColdStreams(true, true);
+    if (soa)
+    {
+        bufferList[3] = scene->mColorBuffer->GetOutputBuffer()->mBuffer;
+        bufferList[4] = scene->mScaleBuffer->GetOutputBuffer()->mBuffer;
+    }
+
+    mMortonGatherPipeline[layout]->UpdateDescriptorSet(bufferList, mFrameSlot);
+    mMortonGatherPipeline[layout]->DispatchLinear(commandBuffer, groupCount, mFrameSlot);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void ParticleUpdateSystem::SortMortonKeys(VkCommandBuffer commandBuffer, Scene* scene, const std::vector<VkBuffer>& bufferList, unsigned int descriptorSet)
+{
+    unsigned int maxParticleCount = scene->mMaxParticleCount;
+    if (mMortonSort == nullptr || mMortonSort->GetCount() != maxParticleCount)
+    {
+        // Scene capacity changed, buffers may still be in use.
+        vkDeviceWaitIdle(mDevice);
+        DestroyMortonSort();
+        CreateMortonSort(maxParticleCount);
+        // New buffers may reuse handles of destroyed ones.
+        for (unsigned int i = 0; i < Scene::PARTICLE_LAYOUT_COUNT; ++i)
+        {
+            mMortonKeyPipeline[i]->InvalidateDescriptorSets();
+            mMortonGatherPipeline[i]->InvalidateDescriptorSets();
+            mTreeBuildPipeline[i]->InvalidateDescriptorSets();
+            mTreeSumPipeline[i]->InvalidateDescriptorSets();
+            mTreeTraversePipeline[i]->InvalidateDescriptorSets();
+        }
+    }
+
+    // Sort buffers are bound here, they may have just been created.
+    std::vector<VkBuffer> mortonBufferList = bufferList;
+    mortonBufferList[0] = mMortonCopyBuffer;
+    mortonBufferList[9] = mMortonKeyBuffer;
+    mortonBufferList[10] = mMortonValueBuffer;
+
+    Scene::ParticleLayout layout = scene->mParticleLayout;
+    mMortonKeyPipeline[layout]->UpdateDescriptorSet(mortonBufferList, descriptorSet);
+    mMortonKeyPipeline[layout]->DispatchLinear(commandBuffer, (maxParticleCount + mWorkGroupSize - 1) / mWorkGroupSize, descriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    mMortonSort->Sort(commandBuffer, mMortonKeyBuffer, mMortonValueBuffer);
+}
+
+void ParticleUpdateSystem::UpdateBarnesHut(VkCommandBuffer commandBuffer, Scene* scene, VkTimer* treeBuildTimer, VkTimer* treeTraverseTimer)
+{
+    unsigned int maxParticleCount = scene->mMaxParticleCount;
+    if (mTreeNodeCount != 2 * maxParticleCount)
+    {
+        // Scene capacity changed, buffer may still be in use.
+        vkDeviceWaitIdle(mDevice);
+        if (mTreeNodeCount > 0)
+        {
+            vkFreeMemory(mDevice, mTreeNodeBufferMemory, nullptr);
+            vkDestroyBuffer(mDevice, mTreeNodeBuffer, nullptr);
+        }
+        // Node of Particles_BarnesHut_CS is 64 bytes.
+        mTreeNodeCount = 2 * maxParticleCount;
+        uint32_t minOffsetAligment;
+        vkTools::CreateBuffer(mDevice, mPhysicalDevice, 64 * mTreeNodeCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            mTreeNodeBuffer, mTreeNodeBufferMemory, minOffsetAligment
+            );
+        // New buffer may reuse handle of destroyed one.
+        for (unsigned int i = 0; i < Scene::PARTICLE_LAYOUT_COUNT; ++i)
+        {
+            mTreeBuildPipeline[i]->InvalidateDescriptorSets();
+            mTreeSumPipeline[i]->InvalidateDescriptorSets();
+            mTreeTraversePipeline[i]->InvalidateDescriptorSets();
+        }
+    }
+
+    Scene::ParticleLayout layout = scene->mParticleLayout;
+    bool soa = layout == Scene::PARTICLE_LAYOUT_SOA;
+    VkBuffer particleInBuffer = scene->mParticleBuffer->GetInputBuffer()->mBuffer;
+    VkBuffer velocityInBuffer = soa ? scene->mVelocityBuffer->GetInputBuffer()->mBuffer : particleInBuffer;
+    VkBuffer indirectInBuffer = scene->mIndirectBuffer->GetInputBuffer()->mBuffer;
+
+    if (treeBuildTimer != nullptr)
+        treeBuildTimer->Start(commandBuffer);
+
+    // Morton keys of input particles, bound in place of output buffers of key pass.
+    SortMortonKeys(commandBuffer, scene, {
+        VK_NULL_HANDLE,
+        particleInBuffer,
+        velocityInBuffer,
+        soa ? scene->mColorBuffer->GetInputBuffer()->mBuffer : particleInBuffer,
+        soa ? scene->mScaleBuffer->GetInputBuffer()->mBuffer : particleInBuffer,
+        mUniformRing->mBuffer,
+        scene->mAliveIndexBuffer->GetInputBuffer()->mBuffer,
+        indirectInBuffer,
+        scene->mDeadIndexBuffer->mBuffer,
+        VK_NULL_HANDLE,
+        VK_NULL_HANDLE
+    }, mFrameCount + mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    std::vector<VkBuffer> treeBufferList{ particleInBuffer, velocityInBuffer, mUniformRing->mBuffer, indirectInBuffer,
+        mMortonKeyBuffer, mMortonValueBuffer, mTreeNodeBuffer, scene->mAccelerationBuffer->mBuffer };
+
+    // Hierarchy, then sums from leaves to root.
+    mTreeBuildPipeline[layout]->UpdateDescriptorSet(treeBufferList, mSubstepDescriptorSet);
+    mTreeBuildPipeline[layout]->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    mTreeSumPipeline[layout]->UpdateDescriptorSet(treeBufferList, mSubstepDescriptorSet);
+    mTreeSumPipeline[layout]->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (treeBuildTimer != nullptr)
+        treeBuildTimer->Stop(commandBuffer);
+    if (treeTraverseTimer != nullptr)
+        treeTraverseTimer->Start(commandBuffer);
+
+    mTreeTraversePipeline[layout]->UpdateDescriptorSet(treeBufferList, mSubstepDescriptorSet);
+    mTreeTraversePipeline[layout]->DispatchIndirect(commandBuffer, indirectInBuffer, offsetof(Scene::IndirectArguments, dispatch), mSubstepDescriptorSet);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (treeTraverseTimer != nullptr)
+        treeTraverseTimer->Stop(commandBuffer);
+}
+
+void ParticleUpdateSystem::CreateMortonSort(unsigned int count)
+{
+    // Sort all 32 key bits, unused slots have key 0xFFFFFFFF.
+    mMortonSort = new RadixSort(mDevice, mPhysicalDevice, count, mWorkGroupSize);
+
+    uint32_t minOffsetAligment;
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mMortonKeyBuffer, mMortonKeyBufferMemory, minOffsetAligment
+        );
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mMortonValueBuffer, mMortonValueBufferMemory, minOffsetAligment
+        );
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(Particle) * count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mMortonCopyBuffer, mMortonCopyBufferMemory, minOffsetAligment
+        );
+}
+
+void ParticleUpdateSystem::DestroyMortonSort()
+{
+    if (mMortonSort == nullptr)
+        return;
+
+    delete mMortonSort;
+    mMortonSort = nullptr;
+    vkFreeMemory(mDevice, mMortonKeyBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mMortonKeyBuffer, nullptr);
+    vkFreeMemory(mDevice, mMortonValueBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mMortonValueBuffer, nullptr);
+    vkFreeMemory(mDevice, mMortonCopyBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mMortonCopyBuffer, nullptr);
+}
+
+void ParticleUpdateSystem::CreateUpdatePipelines()
+{
+    std::vector<VkDescriptorType> updateDescriptorTypeList{
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input particles.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output particles.
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Meta data.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input alive indices.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output alive indices.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input indirect arguments.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output indirect arguments.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Dead indices.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input positions.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output positions.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input velocities.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output velocities.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input colors.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output colors.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input scales.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output scales.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid cell counts.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid cell starts.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Grid indices.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Accelerations.
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Force field parameters.
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // Signed distance field.
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // Force fields.
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    };
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+    {
+        for (unsigned int storage = 0; storage < Scene::PARTICLE_STORAGE_COUNT; ++storage)
+        {
+            // Specialization constant 2 selects integrator, 3 writes input bindings in place.
+            uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+            uint32_t inPlace = storage == Scene::PARTICLE_STORAGE_IN_PLACE ? VK_TRUE : VK_FALSE;
+            std::vector<uint32_t> specializationList{ mWorkGroupSize, soa, (uint32_t)mIntegrator, inPlace };
+            mUpdatePipeline[layout][storage] = new ComputePipeline(mDevice, "resources/shaders/Particles_Update_CS.spv", updateDescriptorTypeList, specializationList, gSubstepDescriptorSetCount * mFrameCount);
+        }
+    }
+}
+
+void ParticleUpdateSystem::DestroyUpdatePipelines()
+{
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        for (unsigned int storage = 0; storage < Scene::PARTICLE_STORAGE_COUNT; ++storage)
+            delete mUpdatePipeline[layout][storage];
+}
+
+void ParticleUpdateSystem::CreateGravityPipelines(unsigned int tileSize)
+{
+    mGravityTileSize = tileSize;
+
+    // Specialization constant 2 is tile size.
+    std::vector<VkDescriptorType> gravityDescriptorTypeList{
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input positions.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input velocities.
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // Gravity parameters.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input alive indices.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input indirect arguments.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Accelerations.
+    };
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+    {
+        uint32_t soa = layout == Scene::PARTICLE_LAYOUT_SOA ? VK_TRUE : VK_FALSE;
+        mGravityPipeline[layout] = new ComputePipeline(mDevice, "resources/shaders/Particles_Gravity_CS.spv", gravityDescriptorTypeList, { mWorkGroupSize, soa, mGravityTileSize }, gSubstepDescriptorSetCount * mFrameCount);
+    }
+}
+
+void ParticleUpdateSystem::DestroyGravityPipelines()
+{
+    for (unsigned int layout = 0; layout < Scene::PARTICLE_LAYOUT_COUNT; ++layout)
+        delete mGravityPipeline[layout];
+}
+
+unsigned int ParticleUpdateSystem::GetWorkGroupSize() const
+{
+    return mWorkGroupSize;
+}
+
+unsigned int ParticleUpdateSystem::FindWorkGroupSize(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceProperties physicalDeviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+    // Prefer exact device match over vendor match.
+    unsigned int workGroupSize = gDefaultWorkGroupSize;
+    for (auto& entry : gWorkGroupSizeTable)
+    {
+        if (entry.vendorID != physicalDeviceProperties.vendorID)
+            continue;
+        if (entry.deviceID == physicalDeviceProperties.deviceID)
+            return entry.workGroupSize;
+        if (entry.deviceID == 0)
+            workGroupSize = entry.workGroupSize;
+    }
+
+    return workGroupSize;
 }
@@ -2,47 +2,390 @@
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
+#include <vector>
+#include "Scene.hpp"
 
-class Scene;
+class VkTimer;
+class SignedDistanceField;
+class VectorField;
+class Texture3D;
 class StorageBuffer;
 class FrameBuffer;
 class Camera;
+class ComputePipeline;
+class PrefixSum;
+class RadixSort;
+class UniformRing;
 
 class ParticleUpdateSystem
 {
     public:
+        // Update mode, selects forces applied before integration.
+        enum Mode
+        {
+            // Synthetic load writing color, optional collisions.
+            MODE_DEFAULT = 0,
+            // Smoothed particle hydrodynamics.
+            MODE_FLUID = 1,
+            // All-pairs gravity, mass in velocity.w.
+            MODE_GRAVITY = 2,
+            // Barnes-Hut gravity over tree of Morton sorted particles, mass in velocity.w.
+            MODE_BARNES_HUT = 3
+        };
+
+        // Time integrator of update pass. Forces of fluid, gravity and collision passes are held constant over a step,
+        // integrators evaluating several times re-evaluate force fields only.
+        enum Integrator
+        {
+            // Position by old velocity, velocity by old acceleration.
+            INTEGRATOR_EXPLICIT_EULER = 0,
+            // Velocity first, position by new velocity.
+            INTEGRATOR_SEMI_IMPLICIT_EULER = 1,
+            // Velocity Verlet, averages accelerations at old and new position.
+            INTEGRATOR_VERLET = 2,
+            // Second order Runge-Kutta, midpoint method.
+            INTEGRATOR_RK2 = 3
+        };
+
+        // Particle buffer access declared by a kernel.
+        enum ParticleAccess
+        {
+            // Reads and writes only particle of thread.
+            PARTICLE_ACCESS_SELF = 0,
+            // Reads particles of other threads from buffers the kernel writes, can not run in place.
+            PARTICLE_ACCESS_NEIGHBORS = 1
+        };
+
+        // Smoothed particle hydrodynamics parameters. Layout matches Particles_Fluid_CS.
+        struct FluidParameters
+        {
+            // Kernel radius, also grid cell size.
+            float smoothingRadius = 1.f;
+            float particleMass = 1.f;
+            float restDensity = 1.f;
+            // Pressure per density above rest density.
+            float stiffness = 20.f;
+            float viscosity = 0.5f;
+            // Acceleration per distance outside container.
+            float boundaryStiffness = 1000.f;
+            float pad0;
+            float pad1;
+            glm::vec4 gravity = glm::vec4(0.f, -9.82f, 0.f, 0.f);
+            // Container.
+            glm::vec4 boundsMin = glm::vec4(-50.f, -50.f, -50.f, 0.f);
+            glm::vec4 boundsMax = glm::vec4(50.f, 50.f, 50.f, 0.f);
+        };
+
+        // Max number of force field volumes blended at once, matches Particles_Update_CS.
+        static const unsigned int MAX_FORCE_FIELDS = 4;
+
+        // Structure of commands recorded by an update. Commands recorded for an equal structure can be resubmitted instead,
+        // as constants of each frame are read from uniform ring region of its frame in flight.
+        struct Structure
+        {
+            // Swap buffers of scene, see Scene::GetSwapState.
+            std::vector<VkBuffer> bufferList;
+            // Changed by settings that change recorded commands.
+            unsigned int version;
+            unsigned int substepCount;
+            bool emit;
+            bool sort;
+            bool operator==(const Structure& other) const;
+        };
+
         // Constructor.
         // device Vulkan device.
         // physicalDevice Vulkan physical device.
-        ParticleUpdateSystem(VkDevice device, VkPhysicalDevice physicalDevice);
+        // workGroupSize Number of threads per compute work group. DEFAULT [0, look up in device table]
+        // gridCellCount Number of spatial hash grid cells, rounded up to power of two. DEFAULT [1 << 20]
+        // frameCount Number of frames in flight, each with own uniform ring region and descriptor sets. DEFAULT [1]
+        ParticleUpdateSystem(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int workGroupSize = 0, unsigned int gridCellCount = 1 << 20, unsigned int frameCount = 1);
 
         // Destructor.
         ~ParticleUpdateSystem();
 
-        // Update particles.
+        // Update particles. Spawns particles of scene emitters, updates alive particles and frees expired particles.
+        // With fixed time step, runs due substeps in this command buffer. Frame input buffers of scene are not written.
+        // Same as Prepare followed by Record.
         // commandBuffer Command buffer to update.
         // scene Scene to update.
         // dt Delta time.
-        void Update(VkCommandBuffer commandBuffer, Scene* scene, float dt);
+        // frameIndex Index of frame. Command buffers of the previous frameCount - 1 frames may still execute.
+        // treeBuildTimer Timer around tree build of MODE_BARNES_HUT, must be reset. DEFAULT [nullptr]
+        // treeTraverseTimer Timer around tree traversal of MODE_BARNES_HUT, must be reset. DEFAULT [nullptr]
+        void Update(VkCommandBuffer commandBuffer, Scene* scene, float dt, unsigned int frameIndex, VkTimer* treeBuildTimer = nullptr, VkTimer* treeTraverseTimer = nullptr);
+
+        // Prepare update of frame without recording. Advances time and emitters, and writes constants of frame to uniform ring.
+        // scene Scene to update.
+        // dt Delta time.
+        // frameIndex Index of frame. Command buffers of the previous frameCount - 1 frames may still execute.
+        // Returns structure of commands of frame.
+        Structure Prepare(Scene* scene, float dt, unsigned int frameIndex);
+
+        // Record prepared update.
+        // commandBuffer Command buffer to record. VK_NULL_HANDLE only advances swap buffers of scene, when commands of this frame in flight recorded for an equal structure are resubmitted.
+        // scene Prepared scene.
+        // treeBuildTimer Timer around tree build of MODE_BARNES_HUT, must be reset. DEFAULT [nullptr]
+        // treeTraverseTimer Timer around tree traversal of MODE_BARNES_HUT, must be reset. DEFAULT [nullptr]
+        void Record(VkCommandBuffer commandBuffer, Scene* scene, VkTimer* treeBuildTimer = nullptr, VkTimer* treeTraverseTimer = nullptr);
+
+        // Enable particle-particle collisions. Builds spatial hash grid of particles each frame.
+        // radius Particle radius, zero disables collisions.
+        // stiffness Spring constant pushing overlapping particles apart. DEFAULT [100]
+        // damping Damping of approach speed along contact normal. DEFAULT [1]
+        void SetCollision(float radius, float stiffness = 100.f, float damping = 1.f);
+
+        // Collide particles with signed distance field. Particles outside field volume do not collide.
+        // distanceField Field to collide with, nullptr disables collisions. Must outlive use.
+        // particleRadius Distance kept from surface.
+        // restitution Fraction of approach speed reflected. DEFAULT [0.5]
+        void SetDistanceField(SignedDistanceField* distanceField, float particleRadius, float restitution = 0.5f);
+
+        // Bind force field volume. Accelerations of bound volumes are summed, particles outside a volume are not affected by it.
+        // Any bound volume replaces synthetic load of MODE_DEFAULT.
+        // slot Slot of volume, less than MAX_FORCE_FIELDS.
+        // vectorField Field sampled, nullptr unbinds slot. Must outlive use.
+        // transform Transform from field space, unit cube, to world space. Vectors are rotated with it, transform must not shear. DEFAULT [identity]
+        // strength Acceleration per unit vector. DEFAULT [1]
+        // drag Acceleration per unit difference between vector and particle velocity, makes particles follow velocity fields. DEFAULT [0]
+        void SetForceField(unsigned int slot, VectorField* vectorField, const glm::mat4& transform = glm::mat4(), float strength = 1.f, float drag = 0.f);
+
+        // Evaluate curl noise of bound noise fields per particle instead of sampling their textures. Imported grids are still sampled.
+        // analyticNoise Whether to evaluate noise.
+        void SetAnalyticNoise(bool analyticNoise);
+
+        // Set time integrator. Recreates update pipelines, waits for device.
+        // integrator Integrator. DEFAULT [INTEGRATOR_SEMI_IMPLICIT_EULER]
+        void SetIntegrator(Integrator integrator);
+
+        // Step simulation by fixed time step. Delta times are accumulated and every due step runs in update.
+        // Frames without due step copy input to output.
+        // timestep Time step, zero steps once per update by delta time. DEFAULT [0]
+        // maxSubstepCount Max steps per update, time of further steps is dropped. DEFAULT [8]
+        void SetFixedTimestep(float timestep, unsigned int maxSubstepCount = 8);
+
+        // Get particle access of update kernel with current settings, from meta data flags it is dispatched with.
+        // Fluid, gravity and grid passes read neighbors before update writes, only collisions of update read neighbors.
+        // Returns particle access.
+        ParticleAccess GetUpdateParticleAccess() const;
+
+        // Check if scenes with Scene::PARTICLE_STORAGE_IN_PLACE can be updated with current settings.
+        // Returns whether update kernel accesses only own particle.
+        bool SupportsInPlaceUpdate() const;
+
+        // Check if scenes with Scene::PARTICLE_STORAGE_IN_PLACE can be updated with given settings, before a system is created.
+        // collisionRadius Radius of SetCollision.
+        // Returns whether update kernel accesses only own particle.
+        static bool SupportsInPlaceUpdate(float collisionRadius);
+
+        // Set update mode.
+        // mode Update mode.
+        void SetMode(Mode mode);
+
+        // Set parameters of MODE_FLUID.
+        // parameters Fluid parameters.
+        void SetFluidParameters(const FluidParameters& parameters);
+
+        // Reference of MODE_FLUID on CPU, checked against GPU by -verify. Same kernels and integrators as GPU, without collisions, force fields or distance field.
+        // indexList Slot of each particle, expired particles are removed.
+        // particleList Particles to update, expired particles are removed.
+        // parameters Fluid parameters.
+        // integrator Time integrator.
+        // dt Delta time.
+        static void UpdateFluidCPU(std::vector<uint32_t>& indexList, std::vector<Particle>& particleList, const FluidParameters& parameters, Integrator integrator, float dt);
+
+        // Set parameters of MODE_GRAVITY.
+        // gravitationalConstant Gravitational constant.
+        // softening Distance added to every pair, removes singularity and self interaction. DEFAULT [0.1]
+        // tileSize Bodies staged in shared memory per pass, rounded up to multiple of work group size. DEFAULT [0, work group size]
+        void SetGravity(float gravitationalConstant, float softening = 0.1f, unsigned int tileSize = 0);
+
+        // Set opening angle of MODE_BARNES_HUT, which also uses gravitational constant and softening of SetGravity.
+        // Tree keys are quantized in Morton sort bounds of scene.
+        // openingAngle Nodes smaller than angle times distance are approximated by center of mass, zero opens every node.
+        void SetBarnesHut(float openingAngle);
+
+        // Get number of bodies per shared memory tile of MODE_GRAVITY.
+        // Returns tile size.
+        unsigned int GetGravityTileSize() const;
+
+        // Get number of threads per compute work group.
+        // Returns work group size.
+        unsigned int GetWorkGroupSize() const;
+
+        // Look up work group size for device in table of tuned sizes.
+        // physicalDevice Vulkan physical device.
+        // Returns work group size.
+        static unsigned int FindWorkGroupSize(VkPhysicalDevice physicalDevice);
 
     private:
         VkDevice mDevice;
         VkPhysicalDevice mPhysicalDevice;
 
-        VkShaderModule mComputeShaderModule;
+        // Threads per work group, bound to specialization constant 0.
+        unsigned int mWorkGroupSize;
+
+        // Frame counter seeding emitters.
+        unsigned int mFrameIndex;
+
+        // Writes dispatch arguments of input alive list and resets output alive list.
+        ComputePipeline* mPreparePipeline;
+        // Spawns particles from dead list, per particle layout.
+        ComputePipeline* mEmitPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        // Updates alive particles, per particle layout and storage. Recreated when integrator changes.
+        void CreateUpdatePipelines();
+        void DestroyUpdatePipelines();
+        ComputePipeline* mUpdatePipeline[Scene::PARTICLE_LAYOUT_COUNT][Scene::PARTICLE_STORAGE_COUNT];
+        Integrator mIntegrator;
+
+        // Runs one step from input to output buffers of scene: prepare, emit, force passes and update.
+        void Step(VkCommandBuffer commandBuffer, Scene* scene, bool emit, VkTimer* treeBuildTimer, VkTimer* treeTraverseTimer);
+        // Fixed time step, zero when variable.
+        float mFixedTimestep;
+        unsigned int mMaxSubstepCount;
+        // Time not yet stepped.
+        float mTimeAccumulator;
+        // Steps and Morton sort of prepared frame.
+        unsigned int mSubstepCount;
+        bool mSort;
+        // Incremented by setters that change recorded commands.
+        unsigned int mStructureVersion;
+        // Descriptor set of current substep. Buffers differ between substeps of one command buffer, so each has own set.
+        // Frames in flight have own sets, in blocks of substep sets.
+        unsigned int mSubstepDescriptorSet;
+
+        // Frames in flight, and frame in flight of current update.
+        unsigned int mFrameCount;
+        unsigned int mFrameSlot;
+        // Parameter blocks of each frame, bound as dynamic uniform buffers at offsets of current frame.
+        UniformRing* mUniformRing;
+        // Sets offsets of parameter blocks on pipelines binding them.
+        void SetUniformOffsets();
+        // Offsets in uniform ring of current frame. Emitters are read as storage buffer, dispatch arguments of emit indirectly.
+        uint32_t mEmittersOffset;
+        uint32_t mEmitArgumentsOffset;
+
+        // Builds spatial hash grid of input particles. Counting sort by cell: clear, assign, prefix sum, scatter.
+        void BuildGrid(VkCommandBuffer commandBuffer, Scene* scene);
+        ComputePipeline* mGridClearPipeline;
+        ComputePipeline* mGridAssignPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        ComputePipeline* mGridScatterPipeline;
+        PrefixSum* mGridPrefixSum;
+        // Number of particles in each cell.
+        VkBuffer mGridCellCountBuffer;
+        VkDeviceMemory mGridCellCountBufferMemory;
+        // First sorted index of each cell.
+        VkBuffer mGridCellStartBuffer;
+        VkDeviceMemory mGridCellStartBufferMemory;
+
+        Mode mMode;
+
+        // Fluid density and force passes, per particle layout.
+        ComputePipeline* mFluidDensityPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        ComputePipeline* mFluidForcePipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        FluidParameters mFluidParameters;
+        // Offset in uniform ring of current frame.
+        uint32_t mFluidParametersOffset;
+
+        // All-pairs gravity pass, per particle layout. Recreated when tile size changes.
+        void CreateGravityPipelines(unsigned int tileSize);
+        void DestroyGravityPipelines();
+        ComputePipeline* mGravityPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        unsigned int mGravityTileSize;
+        // Layout matches Particles_Gravity_CS.
+        struct GravityParameters
+        {
+            float gravitationalConstant;
+            float softening;
+            float openingAngle;
+            float pad;
+        } mGravityParameters;
+        // Offset in uniform ring of current frame.
+        uint32_t mGravityParametersOffset;
+
+        // Builds tree of input particles from Morton codes and writes Barnes-Hut accelerations.
+        void UpdateBarnesHut(VkCommandBuffer commandBuffer, Scene* scene, VkTimer* treeBuildTimer, VkTimer* treeTraverseTimer);
+        ComputePipeline* mTreeBuildPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        ComputePipeline* mTreeSumPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        ComputePipeline* mTreeTraversePipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        // Created for capacity of scene, 2 nodes per particle.
+        unsigned int mTreeNodeCount;
+        VkBuffer mTreeNodeBuffer;
+        VkDeviceMemory mTreeNodeBufferMemory;
+
+        // Signed distance field collided with.
+        SignedDistanceField* mDistanceField;
+
+        // Force field volume. Layout matches Particles_Update_CS.
+        struct ForceFieldVolume
+        {
+            glm::mat4 worldToField;
+            // Rotation of transform.
+            glm::mat4 fieldToWorld;
+            // x Strength, y drag, z noise frequency, w noise seed.
+            glm::vec4 parameters;
+        };
+        // Bound volumes, compacted each frame.
+        VectorField* mForceFieldList[MAX_FORCE_FIELDS];
+        ForceFieldVolume mForceFieldVolumeList[MAX_FORCE_FIELDS];
+        // Bound volumes of current frame, in compacted order.
+        std::vector<VectorField*> mBoundForceFieldList;
+        // Layout matches Particles_Update_CS.
+        struct ForceFieldParameters
+        {
+            unsigned int count;
+            unsigned int analyticNoise;
+            unsigned int pad0;
+            unsigned int pad1;
+            ForceFieldVolume volumes[MAX_FORCE_FIELDS];
+        } mForceFieldParameters;
+        // Offset in uniform ring of current frame.
+        uint32_t mForceFieldParametersOffset;
+
+        // Bound to texture bindings without texture.
+        Texture3D* mPlaceholderTexture;
+
+        // Reorders output particles by Morton code.
+        void SortParticles(VkCommandBuffer commandBuffer, Scene* scene);
+        // Writes Morton keys and particle indices of alive particles to sort buffers and sorts them.
+        void SortMortonKeys(VkCommandBuffer commandBuffer, Scene* scene, const std::vector<VkBuffer>& bufferList, unsigned int descriptorSet);
+        void CreateMortonSort(unsigned int count);
+        void DestroyMortonSort();
+        ComputePipeline* mMortonKeyPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        ComputePipeline* mMortonGatherPipeline[Scene::PARTICLE_LAYOUT_COUNT];
+        // Created for capacity of sorted scene.
+        RadixSort* mMortonSort;
+        VkBuffer mMortonKeyBuffer;
+        VkDeviceMemory mMortonKeyBufferMemory;
+        VkBuffer mMortonValueBuffer;
+        VkDeviceMemory mMortonValueBufferMemory;
+        // Copy of particles gathered from.
+        VkBuffer mMortonCopyBuffer;
+        VkDeviceMemory mMortonCopyBufferMemory;
 
-        VkDescriptorPool mPipelineDescriptorPool;
-        VkDescriptorSet mPipelineDescriptorSet;
-        VkDescriptorSetLayout mPipelineDescriptorSetLayout;
-        VkPipelineLayout mPipelineLayout;
-        VkPipeline mPipeline;
-        
         struct MetaData
         {
             float dt;
-            unsigned int particleCount;
-            float pad[6];
+            unsigned int maxParticleCount;
+            // Grid cell size, zero when grid is not built.
+            float gridCellSize;
+            unsigned int gridCellCount;
+            float collisionRadius;
+            float collisionStiffness;
+            float collisionDamping;
+            // FLAG_ bits of Particles_Update_CS.
+            unsigned int flags;
+            glm::vec4 sortBoundsMin;
+            glm::vec4 sortBoundsMax;
+            // w Particle radius of distance field collisions.
+            glm::vec4 distanceFieldBoundsMin;
+            // w Restitution of distance field collisions.
+            glm::vec4 distanceFieldBoundsMax;
+            // Unused, keeps layout shared with shaders.
+            glm::vec4 pad[2];
         } mMetaData;
-        VkBuffer mMetaDataBuffer;
-        VkDeviceMemory mMetaDataBufferMemory;
+        // Offset in uniform ring of current frame.
+        uint32_t mMetaDataOffset;
+        // Gets meta data flags of update with current settings.
+        unsigned int GetUpdateFlags() const;
 };
@@ -0,0 +1,613 @@
+#include "ParticleUpdateSystemCPU.hpp"
+#include "StorageSwapBuffer.hpp"
+#include "StorageColdBuffer.hpp"
+#include "ThreadPool.hpp"
+#include "UniformRing.hpp"
+#include "VectorField.hpp"
+#include "Simd.hpp"
+#include "vkTools.hpp"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+
+// Particles per task of kernels over slots, multiple of SIMD width.
+static const unsigned int gSlotRangeSize = 4096;
+// Alive particles per task of collisions, which cost more per particle.
+static const unsigned int gCollisionRangeSize = 256;
+
+// Hash of emitter random numbers, matches Particles_Emit_CS.
+static uint32_t WangHash(uint32_t seed)
+{
+    seed = (seed ^ 61u) ^ (seed >> 16);
+    seed *= 9u;
+    seed = seed ^ (seed >> 4);
+    seed *= 0x27d4eb2du;
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+
+// Random number in [0, 1).
+static float Random(uint32_t& state)
+{
+    state = WangHash(state);
+    return (float)state / 4294967296.f;
+}
+
+// Random unit vector.
+static glm::vec3 RandomDirection(uint32_t& state)
+{
+    float z = Random(state) * 2.f - 1.f;
+    float angle = Random(state) * 6.28318531f;
+    float r = std::sqrt((std::max)(1.f - z * z, 0.f));
+    return glm::vec3(r * std::cos(angle), r * std::sin(angle), z);
+}
+
+// Hash of grid cell, matches Particles_Update_CS. Cell count is a power of two.
+static uint32_t GridHash(const glm::ivec3& cell, uint32_t cellCount)
+{
+    return ((uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u) & (cellCount - 1u);
+}
+
+ParticleUpdateSystemCPU::ParticleUpdateSystemCPU(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int threadCount, unsigned int frameCount)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mThreadPool = new ThreadPool(threadCount);
+    mFrameCount = frameCount;
+    mUploadRing = nullptr;
+    mFrameIndex = 0;
+    mFixedTimestep = 0.f;
+    mMaxSubstepCount = 8;
+    mTimeAccumulator = 0.f;
+    mIntegrator = ParticleUpdateSystem::INTEGRATOR_SEMI_IMPLICIT_EULER;
+    mCollisionRadius = 0.f;
+    mCollisionStiffness = 100.f;
+    mCollisionDamping = 1.f;
+    for (unsigned int slot = 0; slot < ParticleUpdateSystem::MAX_FORCE_FIELDS; ++slot)
+        mForceFieldList[slot].vectorField = nullptr;
+    mAnalyticNoise = false;
+    mMaxParticleCount = 0;
+    mSlotCount = 0;
+    mSyntheticLoad = false;
+    mColdDirty = false;
+}
+
+ParticleUpdateSystemCPU::~ParticleUpdateSystemCPU()
+{
+    delete mThreadPool;
+    delete mUploadRing;
+}
+
+void ParticleUpdateSystemCPU::Load(Scene* scene, const std::vector<Particle>& particleList)
+{
+    assert(particleList.size() <= scene->mMaxParticleCount);
+
+    // Kernels read whole SIMD vectors past last slot.
+    mMaxParticleCount = scene->mMaxParticleCount;
+    std::size_t streamSize = (mMaxParticleCount + simd::WIDTH - 1) / simd::WIDTH * simd::WIDTH;
+    std::vector<float>* streamList[] = { &mPositionX, &mPositionY, &mPositionZ, &mLifetime, &mVelocityX, &mVelocityY, &mVelocityZ, &mMass, &mAccelerationX, &mAccelerationY, &mAccelerationZ };
+    for (std::vector<float>* stream : streamList)
+        stream->assign(streamSize, 0.f);
+    mColorList.assign(mMaxParticleCount, glm::vec4(0.f));
+    mScaleList.assign(mMaxParticleCount, glm::vec4(0.f));
+    mAliveMask.assign(streamSize, 0u);
+    mExpiredMask.assign(streamSize, 0u);
+
+    mSlotCount = (unsigned int)particleList.size();
+    mAliveList.clear();
+    for (unsigned int i = 0; i < mSlotCount; ++i)
+    {
+        const Particle& particle = particleList[i];
+        mPositionX[i] = particle.position.x;
+        mPositionY[i] = particle.position.y;
+        mPositionZ[i] = particle.position.z;
+        mLifetime[i] = particle.position.w;
+        mVelocityX[i] = particle.velocity.x;
+        mVelocityY[i] = particle.velocity.y;
+        mVelocityZ[i] = particle.velocity.z;
+        mMass[i] = particle.velocity.w;
+        mColorList[i] = particle.color;
+        mScaleList[i] = particle.scale;
+        mAliveMask[i] = 0xFFFFFFFFu;
+        mAliveList.push_back(i);
+    }
+    mColdDirty = true;
+
+    // Remaining slots are dead, lowest index on top of stack as Scene::ResetLifecycle.
+    mDeadList.clear();
+    for (unsigned int i = mMaxParticleCount; i > mSlotCount; --i)
+        mDeadList.push_back(i - 1);
+
+    // Upload ring is created by first upload.
+    delete mUploadRing;
+    mUploadRing = nullptr;
+}
+
+void ParticleUpdateSystemCPU::Update(VkCommandBuffer commandBuffer, Scene* scene, float dt, unsigned int frameIndex)
+{
+    assert(mMaxParticleCount > 0 && scene->mMaxParticleCount == mMaxParticleCount);
+
+    // Fixed steps due this frame, as ParticleUpdateSystem.
+    unsigned int substepCount = 1;
+    if (mFixedTimestep > 0.f)
+    {
+        mTimeAccumulator += dt;
+        substepCount = (std::min)((unsigned int)(mTimeAccumulator / mFixedTimestep), mMaxSubstepCount);
+        mTimeAccumulator = (std::min)(mTimeAccumulator - substepCount * mFixedTimestep, mFixedTimestep);
+        dt = mFixedTimestep;
+    }
+
+    // Bound force fields in slot order. Synthetic load runs without them.
+    mBoundForceFieldList.clear();
+    for (unsigned int slot = 0; slot < ParticleUpdateSystem::MAX_FORCE_FIELDS; ++slot)
+        if (mForceFieldList[slot].vectorField != nullptr)
+            mBoundForceFieldList.push_back(mForceFieldList[slot]);
+    mSyntheticLoad = mBoundForceFieldList.empty();
+
+    // Number of particles to spawn this frame and seeds, as ParticleUpdateSystem::Prepare. Spawned by first substep.
+    if (substepCount > 0)
+    {
+        for (std::size_t i = 0; i < scene->mEmitterList.size(); ++i)
+        {
+            ParticleEmitter& emitter = scene->mEmitterList[i];
+            float& accumulator = scene->mEmitAccumulatorList[i];
+            accumulator = (std::min)(accumulator + emitter.rate * dt * substepCount, (float)scene->mMaxParticleCount);
+            emitter.emitCount = (unsigned int)accumulator;
+            emitter.seed = mFrameIndex * (unsigned int)Scene::mMaxEmitterCount + (unsigned int)i;
+            accumulator -= emitter.emitCount;
+        }
+        ++mFrameIndex;
+    }
+
+    for (unsigned int substep = 0; substep < substepCount; ++substep)
+        Step(scene, dt, substep == 0 && !scene->mEmitterList.empty());
+
+    // Reference updates step host state only.
+    if (commandBuffer == VK_NULL_HANDLE)
+        return;
+
+    // Attributes, alive list and indirect arguments, each block aligned.
+    if (mUploadRing == nullptr)
+        mUploadRing = new UniformRing(mDevice, mPhysicalDevice, (sizeof(Particle) + sizeof(uint32_t)) * mMaxParticleCount + sizeof(Scene::IndirectArguments) + 6 * 256, mFrameCount);
+    mUploadRing->BeginFrame(frameIndex);
+    Upload(commandBuffer, scene);
+}
+
+void ParticleUpdateSystemCPU::SetCollision(float radius, float stiffness, float damping)
+{
+    mCollisionRadius = radius;
+    mCollisionStiffness = stiffness;
+    mCollisionDamping = damping;
+}
+
+void ParticleUpdateSystemCPU::SetForceField(unsigned int slot, VectorField* vectorField, const glm::mat4& transform, float strength, float drag)
+{
+    assert(slot < ParticleUpdateSystem::MAX_FORCE_FIELDS);
+    ForceField& forceField = mForceFieldList[slot];
+    forceField.vectorField = vectorField;
+    forceField.worldToField = glm::inverse(transform);
+    forceField.fieldToWorld = glm::mat3(glm::normalize(glm::vec3(transform[0])), glm::normalize(glm::vec3(transform[1])), glm::normalize(glm::vec3(transform[2])));
+    forceField.strength = strength;
+    forceField.drag = drag;
+}
+
+void ParticleUpdateSystemCPU::SetAnalyticNoise(bool analyticNoise)
+{
+    mAnalyticNoise = analyticNoise;
+}
+
+void ParticleUpdateSystemCPU::SetIntegrator(ParticleUpdateSystem::Integrator integrator)
+{
+    mIntegrator = integrator;
+}
+
+void ParticleUpdateSystemCPU::SetFixedTimestep(float timestep, unsigned int maxSubstepCount)
+{
+    mFixedTimestep = timestep;
+    mMaxSubstepCount = (std::max)(maxSubstepCount, 1u);
+    mTimeAccumulator = 0.f;
+}
+
+void ParticleUpdateSystemCPU::GetParticles(std::vector<uint32_t>& indexList, std::vector<Particle>& particleList) const
+{
+    indexList = mAliveList;
+    particleList.resize(mAliveList.size());
+    for (std::size_t i = 0; i < mAliveList.size(); ++i)
+    {
+        unsigned int slot = mAliveList[i];
+        Particle& particle = particleList[i];
+        particle.position = glm::vec4(mPositionX[slot], mPositionY[slot], mPositionZ[slot], mLifetime[slot]);
+        particle.velocity = glm::vec4(mVelocityX[slot], mVelocityY[slot], mVelocityZ[slot], mMass[slot]);
+        particle.color = mColorList[slot];
+        particle.scale = mScaleList[slot];
+    }
+}
+
+unsigned int ParticleUpdateSystemCPU::GetThreadCount() const
+{
+    return mThreadPool->GetThreadCount();
+}
+
+const char* ParticleUpdateSystemCPU::GetSimdName()
+{
+    return simd::GetName();
+}
+
+void ParticleUpdateSystemCPU::Step(Scene* scene, float dt, bool emit)
+{
+    // Collisions read neighbors before any is integrated, then every slot is integrated in place.
+    if (mCollisionRadius > 0.f)
+        Collide();
+    mThreadPool->ParallelFor(mSlotCount, gSlotRangeSize, [&](unsigned int begin, unsigned int end)
+    {
+        Integrate(begin, end, dt);
+    });
+    if (mSyntheticLoad)
+        mColdDirty = true;
+
+    // Spawned particles are first updated by next step, as emit and update of GPU write and read different buffers.
+    if (emit)
+        Emit(scene);
+
+    // Expired slots are freed after emit, as emit of GPU pops dead slots before update pushes.
+    mAliveList.clear();
+    for (unsigned int i = 0; i < mSlotCount; ++i)
+    {
+        if (mExpiredMask[i] != 0u)
+        {
+            mExpiredMask[i] = 0u;
+            mAliveMask[i] = 0u;
+            mDeadList.push_back(i);
+        }
+        else if (mAliveMask[i] != 0u)
+        {
+            mAliveList.push_back(i);
+        }
+    }
+}
+
+void ParticleUpdateSystemCPU::Emit(Scene* scene)
+{
+    for (const ParticleEmitter& emitter : scene->mEmitterList)
+    {
+        // Pop dead slots until stack is empty, one random sequence per spawned particle.
+        for (unsigned int id = 0; id < emitter.emitCount && !mDeadList.empty(); ++id)
+        {
+            uint32_t index = mDeadList.back();
+            mDeadList.pop_back();
+
+            uint32_t state = WangHash(emitter.seed ^ WangHash(id));
+            glm::vec3 positionDirection = RandomDirection(state);
+            glm::vec3 position = glm::vec3(emitter.position) + positionDirection * emitter.position.w * Random(state);
+            glm::vec3 velocity = glm::vec3(emitter.velocity) + RandomDirection(state) * emitter.velocity.w;
+            mPositionX[index] = position.x;
+            mPositionY[index] = position.y;
+            mPositionZ[index] = position.z;
+            mLifetime[index] = emitter.lifetime;
+            mVelocityX[index] = velocity.x;
+            mVelocityY[index] = velocity.y;
+            mVelocityZ[index] = velocity.z;
+            mMass[index] = 0.f;
+            mColorList[index] = emitter.color;
+            mScaleList[index] = emitter.scale;
+            mAliveMask[index] = 0xFFFFFFFFu;
+            mSlotCount = (std::max)(mSlotCount, index + 1);
+            mColdDirty = true;
+        }
+    }
+}
+
+void ParticleUpdateSystemCPU::Collide()
+{
+    // Counting sort of alive particles by hash of cell, twice as many cells as particles.
+    float cellSize = 2.f * mCollisionRadius;
+    uint32_t cellCount = 1;
+    while (cellCount < 2 * mAliveList.size())
+        cellCount <<= 1;
+    mGridCellCount.assign(cellCount, 0u);
+    mGridCellStart.resize(cellCount);
+    mGridIndexList.resize(mAliveList.size());
+    auto GridCell = [&](uint32_t index)
+    {
+        return glm::ivec3(glm::floor(glm::vec3(mPositionX[index], mPositionY[index], mPositionZ[index]) / cellSize));
+    };
+    for (uint32_t index : mAliveList)
+        ++mGridCellCount[GridHash(GridCell(index), cellCount)];
+    uint32_t start = 0;
+    for (uint32_t cell = 0; cell < cellCount; ++cell)
+    {
+        mGridCellStart[cell] = start;
+        start += mGridCellCount[cell];
+    }
+    for (uint32_t index : mAliveList)
+        mGridIndexList[mGridCellStart[GridHash(GridCell(index), cellCount)]++] = index;
+    for (uint32_t cell = 0; cell < cellCount; ++cell)
+        mGridCellStart[cell] -= mGridCellCount[cell];
+
+    // Spring and damper along contact normal, neighbors of the 27 cells around, each hash bucket visited once.
+    float contactDistance = cellSize;
+    mThreadPool->ParallelFor((unsigned int)mAliveList.size(), gCollisionRangeSize, [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            uint32_t index = mAliveList[i];
+            glm::vec3 position(mPositionX[index], mPositionY[index], mPositionZ[index]);
+            glm::vec3 velocity(mVelocityX[index], mVelocityY[index], mVelocityZ[index]);
+            glm::ivec3 gridCell = GridCell(index);
+            glm::vec3 acceleration(0.f);
+            uint32_t visited[27];
+            unsigned int visitedCount = 0;
+            for (int z = -1; z <= 1; ++z)
+                for (int y = -1; y <= 1; ++y)
+                    for (int x = -1; x <= 1; ++x)
+                    {
+                        uint32_t hash = GridHash(gridCell + glm::ivec3(x, y, z), cellCount);
+                        if (std::find(visited, visited + visitedCount, hash) != visited + visitedCount)
+                            continue;
+                        visited[visitedCount++] = hash;
+                        uint32_t cellEnd = mGridCellStart[hash] + mGridCellCount[hash];
+                        for (uint32_t k = mGridCellStart[hash]; k < cellEnd; ++k)
+                        {
+                            uint32_t neighbor = mGridIndexList[k];
+                            glm::vec3 delta = position - glm::vec3(mPositionX[neighbor], mPositionY[neighbor], mPositionZ[neighbor]);
+                            float distanceSquared = glm::dot(delta, delta);
+                            if (neighbor != index && distanceSquared < contactDistance * contactDistance && distanceSquared > 0.f)
+                            {
+                                float separation = std::sqrt(distanceSquared);
+                                glm::vec3 normal = delta / separation;
+                                float approachSpeed = glm::dot(velocity - glm::vec3(mVelocityX[neighbor], mVelocityY[neighbor], mVelocityZ[neighbor]), normal);
+                                acceleration += (mCollisionStiffness * (contactDistance - separation) - mCollisionDamping * approachSpeed) * normal;
+                            }
+                        }
+                    }
+            mAccelerationX[index] = acceleration.x;
+            mAccelerationY[index] = acceleration.y;
+            mAccelerationZ[index] = acceleration.z;
+        }
+    });
+}
+
+void ParticleUpdateSystemCPU::Integrate(unsigned int begin, unsigned int end, float dt)
+{
+    if (!mBoundForceFieldList.empty())
+    {
+        // Force fields are evaluated at intermediate states of integrator, one particle at a time.
+        for (unsigned int i = begin; i < end; ++i)
+            if (mAliveMask[i] != 0u)
+                IntegrateParticle(i, dt);
+    }
+    else
+    {
+        // Constant acceleration over step, every component integrates independently. Lanes of dead slots are computed and discarded.
+        bool collide = mCollisionRadius > 0.f;
+        float* positionList[3] = { mPositionX.data(), mPositionY.data(), mPositionZ.data() };
+        float* velocityList[3] = { mVelocityX.data(), mVelocityY.data(), mVelocityZ.data() };
+        const float* accelerationList[3] = { mAccelerationX.data(), mAccelerationY.data(), mAccelerationZ.data() };
+        simd::Float step = simd::Set(dt);
+        simd::Float half = simd::Set(0.5f);
+        simd::Float zero = simd::Set(0.f);
+        for (unsigned int i = begin; i < end; i += simd::WIDTH)
+        {
+            simd::Mask alive = simd::LoadMask(&mAliveMask[i]);
+            for (int c = 0; c < 3; ++c)
+            {
+                simd::Float position = simd::Load(positionList[c] + i);
+                simd::Float velocity = simd::Load(velocityList[c] + i);
+                simd::Float acceleration = collide ? simd::Load(accelerationList[c] + i) : zero;
+                simd::Float nextPosition, nextVelocity;
+                switch (mIntegrator)
+                {
+                    case ParticleUpdateSystem::INTEGRATOR_EXPLICIT_EULER:
+                        nextPosition = simd::Add(position, simd::Mul(velocity, step));
+                        nextVelocity = simd::Add(velocity, simd::Mul(acceleration, step));
+                        break;
+                    case ParticleUpdateSystem::INTEGRATOR_VERLET:
+                        nextPosition = simd::Add(position, simd::Add(simd::Mul(velocity, step), simd::Mul(simd::Mul(simd::Mul(half, acceleration), step), step)));
+                        nextVelocity = simd::Add(velocity, simd::Mul(simd::Mul(half, simd::Add(acceleration, acceleration)), step));
+                        break;
+                    case ParticleUpdateSystem::INTEGRATOR_RK2:
+                        nextPosition = simd::Add(position, simd::Mul(simd::Add(velocity, simd::Mul(simd::Mul(half, acceleration), step)), step));
+                        nextVelocity = simd::Add(velocity, simd::Mul(acceleration, step));
+                        break;
+                    default:
+                        nextVelocity = simd::Add(velocity, simd::Mul(acceleration, step));
+                        nextPosition = simd::Add(position, simd::Mul(nextVelocity, step));
+                        break;
+                }
+                simd::Store(positionList[c] + i, simd::Select(alive, nextPosition, position));
+                simd::Store(velocityList[c] + i, simd::Select(alive, nextVelocity, velocity));
+            }
+
+            // Lifetime, zero is immortal.
+            simd::Float lifetime = simd::Load(&mLifetime[i]);
+            simd::Mask mortal = simd::And(alive, simd::Greater(lifetime, zero));
+            simd::Float nextLifetime = simd::Sub(lifetime, step);
+            simd::Store(&mLifetime[i], simd::Select(mortal, nextLifetime, lifetime));
+            simd::StoreMask(&mExpiredMask[i], simd::And(mortal, simd::LessEqual(nextLifetime, zero)));
+        }
+    }
+
+    // Color the loop of Particles_Update_CS converges to, at integrated position.
+    if (mSyntheticLoad)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            if (mAliveMask[i] == 0u)
+                continue;
+            glm::vec3 position(mPositionX[i], mPositionY[i], mPositionZ[i]);
+            mColorList[i] = glm::vec4((glm::sin(position * dt) + 1.f) / 2.f, 1.f);
+        }
+    }
+}
+
+void ParticleUpdateSystemCPU::IntegrateParticle(unsigned int index, float dt)
+{
+    glm::vec3 constantAcceleration(0.f);
+    if (mCollisionRadius > 0.f)
+        constantAcceleration = glm::vec3(mAccelerationX[index], mAccelerationY[index], mAccelerationZ[index]);
+    auto Acceleration = [&](const glm::vec3& position, const glm::vec3& velocity)
+    {
+        return constantAcceleration + ForceFieldsAcceleration(position, velocity);
+    };
+
+    glm::vec3 position(mPositionX[index], mPositionY[index], mPositionZ[index]);
+    glm::vec3 velocity(mVelocityX[index], mVelocityY[index], mVelocityZ[index]);
+    switch (mIntegrator)
+    {
+        case ParticleUpdateSystem::INTEGRATOR_EXPLICIT_EULER:
+        {
+            glm::vec3 acceleration = Acceleration(position, velocity);
+            position += velocity * dt;
+            velocity += acceleration * dt;
+            break;
+        }
+        case ParticleUpdateSystem::INTEGRATOR_VERLET:
+        {
+            glm::vec3 acceleration = Acceleration(position, velocity);
+            position += velocity * dt + 0.5f * acceleration * dt * dt;
+            glm::vec3 nextAcceleration = Acceleration(position, velocity + acceleration * dt);
+            velocity += 0.5f * (acceleration + nextAcceleration) * dt;
+            break;
+        }
+        case ParticleUpdateSystem::INTEGRATOR_RK2:
+        {
+            glm::vec3 acceleration = Acceleration(position, velocity);
+            glm::vec3 midVelocity = velocity + 0.5f * acceleration * dt;
+            glm::vec3 midAcceleration = Acceleration(position + 0.5f * velocity * dt, midVelocity);
+            position += midVelocity * dt;
+            velocity += midAcceleration * dt;
+            break;
+        }
+        default:
+        {
+            // Force fields see velocity after constant accelerations.
+            velocity += constantAcceleration * dt;
+            velocity += ForceFieldsAcceleration(position, velocity) * dt;
+            position += velocity * dt;
+            break;
+        }
+    }
+    mPositionX[index] = position.x;
+    mPositionY[index] = position.y;
+    mPositionZ[index] = position.z;
+    mVelocityX[index] = velocity.x;
+    mVelocityY[index] = velocity.y;
+    mVelocityZ[index] = velocity.z;
+
+    // Lifetime, zero is immortal.
+    mExpiredMask[index] = 0u;
+    if (mLifetime[index] > 0.f)
+    {
+        mLifetime[index] -= dt;
+        if (!(mLifetime[index] > 0.f))
+            mExpiredMask[index] = 0xFFFFFFFFu;
+    }
+}
+
+glm::vec3 ParticleUpdateSystemCPU::ForceFieldsAcceleration(const glm::vec3& position, const glm::vec3& velocity) const
+{
+    glm::vec3 acceleration(0.f);
+    for (const ForceField& forceField : mBoundForceFieldList)
+    {
+        glm::vec3 uvw = glm::vec3(forceField.worldToField * glm::vec4(position, 1.f));
+        if (glm::any(glm::lessThan(uvw, glm::vec3(0.f))) || glm::any(glm::greaterThan(uvw, glm::vec3(1.f))))
+            continue;
+
+        VectorField* vectorField = forceField.vectorField;
+        bool analytic = mAnalyticNoise && vectorField->mNoiseFrequency > 0.f;
+        glm::vec3 fieldVector = analytic ? VectorField::CurlNoise(uvw * vectorField->mNoiseFrequency, vectorField->mNoiseSeed) : vectorField->Sample(uvw);
+        glm::vec3 worldVector = forceField.fieldToWorld * fieldVector;
+        acceleration += forceField.strength * worldVector + forceField.drag * (worldVector - velocity);
+    }
+    return acceleration;
+}
+
+void ParticleUpdateSystemCPU::Upload(VkCommandBuffer commandBuffer, Scene* scene)
+{
+    VkBuffer uploadBuffer = mUploadRing->mBuffer;
+    unsigned int slotCount = mSlotCount;
+    bool soa = scene->mParticleLayout == Scene::PARTICLE_LAYOUT_SOA;
+
+    // Output may have been drawn by render on another queue family.
+    scene->AcquireUpdateBuffers(commandBuffer);
+
+    // Slots up to highest alive one, render reads them through alive list.
+    if (slotCount > 0)
+    {
+        if (soa)
+        {
+            // Cold streams are only uploaded when written, into a buffer render does not draw. Output shares input otherwise.
+            bool cold = mColdDirty;
+            mColdDirty = false;
+            scene->PrepareColdStreams(cold, cold);
+            uint32_t positionOffset, velocityOffset, colorOffset = 0, scaleOffset = 0;
+            unsigned int streamBytes = sizeof(glm::vec4) * slotCount;
+            glm::vec4* positionList = static_cast<glm::vec4*>(mUploadRing->Reserve(streamBytes, positionOffset));
+            glm::vec4* velocityList = static_cast<glm::vec4*>(mUploadRing->Reserve(streamBytes, velocityOffset));
+            glm::vec4* colorList = cold ? static_cast<glm::vec4*>(mUploadRing->Reserve(streamBytes, colorOffset)) : nullptr;
+            glm::vec4* scaleList = cold ? static_cast<glm::vec4*>(mUploadRing->Reserve(streamBytes, scaleOffset)) : nullptr;
+            mThreadPool->ParallelFor(slotCount, gSlotRangeSize, [&](unsigned int begin, unsigned int end)
+            {
+                for (unsigned int i = begin; i < end; ++i)
+                {
+                    positionList[i] = glm::vec4(mPositionX[i], mPositionY[i], mPositionZ[i], mLifetime[i]);
+                    velocityList[i] = glm::vec4(mVelocityX[i], mVelocityY[i], mVelocityZ[i], mMass[i]);
+                }
+                if (cold)
+                {
+                    std::copy(mColorList.begin() + begin, mColorList.begin() + end, colorList + begin);
+                    std::copy(mScaleList.begin() + begin, mScaleList.begin() + end, scaleList + begin);
+                }
+            });
+            vkTools::CopyBuffer(commandBuffer, uploadBuffer, scene->mParticleBuffer->GetOutputBuffer()->mBuffer, streamBytes, positionOffset, 0);
+            vkTools::CopyBuffer(commandBuffer, uploadBuffer, scene->mVelocityBuffer->GetOutputBuffer()->mBuffer, streamBytes, velocityOffset, 0);
+            if (cold)
+            {
+                vkTools::CopyBuffer(commandBuffer, uploadBuffer, scene->mColorBuffer->GetOutputBuffer()->mBuffer, streamBytes, colorOffset, 0);
+                vkTools::CopyBuffer(commandBuffer, uploadBuffer, scene->mScaleBuffer->GetOutputBuffer()->mBuffer, streamBytes, scaleOffset, 0);
+            }
+        }
+        else
+        {
+            uint32_t particleOffset;
+            unsigned int particleBytes = sizeof(Particle) * slotCount;
+            Particle* particleList = static_cast<Particle*>(mUploadRing->Reserve(particleBytes, particleOffset));
+            mThreadPool->ParallelFor(slotCount, gSlotRangeSize, [&](unsigned int begin, unsigned int end)
+            {
+                for (unsigned int i = begin; i < end; ++i)
+                {
+                    Particle& particle = particleList[i];
+                    particle.position = glm::vec4(mPositionX[i], mPositionY[i], mPositionZ[i], mLifetime[i]);
+                    particle.velocity = glm::vec4(mVelocityX[i], mVelocityY[i], mVelocityZ[i], mMass[i]);
+                    particle.color = mColorList[i];
+                    particle.scale = mScaleList[i];
+                }
+            });
+            vkTools::CopyBuffer(commandBuffer, uploadBuffer, scene->mParticleBuffer->GetOutputBuffer()->mBuffer, particleBytes, particleOffset, 0);
+        }
+    }
+
+    unsigned int aliveCount = (unsigned int)mAliveList.size();
+    if (aliveCount > 0)
+    {
+        uint32_t aliveOffset = mUploadRing->Push(mAliveList.data(), sizeof(uint32_t) * aliveCount);
+        vkTools::CopyBuffer(commandBuffer, uploadBuffer, scene->mAliveIndexBuffer->GetOutputBuffer()->mBuffer, sizeof(uint32_t) * aliveCount, aliveOffset, 0);
+    }
+
+    // Group count is unused, no update dispatches on GPU.
+    Scene::IndirectArguments indirectArguments = {};
+    indirectArguments.draw.vertexCount = aliveCount;
+    indirectArguments.draw.instanceCount = 1;
+    indirectArguments.dispatch.y = 1;
+    indirectArguments.dispatch.z = 1;
+    uint32_t indirectOffset = mUploadRing->Push(&indirectArguments, sizeof(Scene::IndirectArguments));
+    vkTools::CopyBuffer(commandBuffer, uploadBuffer, scene->mIndirectBuffer->GetOutputBuffer()->mBuffer, sizeof(Scene::IndirectArguments), indirectOffset, 0);
+
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+    // Input is drawn by render of this frame.
+    scene->ReleaseUpdateBuffers(commandBuffer);
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Scene.hpp"
+#include "ParticleUpdateSystem.hpp"
+
+class VectorField;
+class ThreadPool;
+class UniformRing;
+
+// Particle update of MODE_DEFAULT on CPU, same semantics as Particles_Update_CS. Fallback on machines without a capable GPU,
+// and a way to compare GPU speedups on the same data. Used in place of ParticleUpdateSystem for a scene.
+// Attributes are held in one stream of floats per component, integrated by SIMD kernels over ranges split across a work-stealing thread pool,
+// and uploaded to output buffers of scene each frame. Emitters, lifetimes, collisions, force fields, integrators and fixed time step are supported.
+// Synthetic load writes the color its loop converges to, without iterating. Distance fields, force passes and Morton sort are GPU only.
+class ParticleUpdateSystemCPU
+{
+    public:
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // threadCount Number of threads updating particles, including caller. DEFAULT [0, hardware concurrency]
+        // frameCount Number of frames in flight, each with own upload region. DEFAULT [1]
+        ParticleUpdateSystemCPU(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int threadCount = 0, unsigned int frameCount = 1);
+
+        // Destructor.
+        ~ParticleUpdateSystemCPU();
+
+        // Load particles of scene, replacing host state. Call after Scene::AddParticles with the same particles.
+        // scene Scene to update.
+        // particleList Particles added to scene, occupying first slots.
+        void Load(Scene* scene, const std::vector<Particle>& particleList);
+
+        // Update particles on CPU, then record upload of result to output buffers of scene. Spawns particles of scene emitters,
+        // updates alive particles and frees expired particles. With fixed time step, runs due substeps.
+        // commandBuffer Command buffer of update queue to record upload, VK_NULL_HANDLE only steps host state, e.g. as reference of another update.
+        // scene Loaded scene.
+        // dt Delta time.
+        // frameIndex Index of frame. Command buffers of the previous frameCount - 1 frames may still execute.
+        void Update(VkCommandBuffer commandBuffer, Scene* scene, float dt, unsigned int frameIndex);
+
+        // Enable particle-particle collisions, see ParticleUpdateSystem::SetCollision.
+        // radius Particle radius, zero disables collisions.
+        // stiffness Spring constant pushing overlapping particles apart. DEFAULT [100]
+        // damping Damping of approach speed along contact normal. DEFAULT [1]
+        void SetCollision(float radius, float stiffness = 100.f, float damping = 1.f);
+
+        // Bind force field volume, see ParticleUpdateSystem::SetForceField. Fields are sampled from their voxels on host.
+        // slot Slot of volume, less than ParticleUpdateSystem::MAX_FORCE_FIELDS.
+        // vectorField Field sampled, nullptr unbinds slot. Must outlive use.
+        // transform Transform from field space, unit cube, to world space. DEFAULT [identity]
+        // strength Acceleration per unit vector. DEFAULT [1]
+        // drag Acceleration per unit difference between vector and particle velocity. DEFAULT [0]
+        void SetForceField(unsigned int slot, VectorField* vectorField, const glm::mat4& transform = glm::mat4(), float strength = 1.f, float drag = 0.f);
+
+        // Evaluate curl noise of bound noise fields instead of sampling their voxels.
+        // analyticNoise Whether to evaluate noise.
+        void SetAnalyticNoise(bool analyticNoise);
+
+        // Set time integrator.
+        // integrator Integrator. DEFAULT [INTEGRATOR_SEMI_IMPLICIT_EULER]
+        void SetIntegrator(ParticleUpdateSystem::Integrator integrator);
+
+        // Step simulation by fixed time step, see ParticleUpdateSystem::SetFixedTimestep.
+        // timestep Time step, zero steps once per update by delta time. DEFAULT [0]
+        // maxSubstepCount Max steps per update, time of further steps is dropped. DEFAULT [8]
+        void SetFixedTimestep(float timestep, unsigned int maxSubstepCount = 8);
+
+        // Get host state of alive particles.
+        // indexList Filled with slots of alive particles in ascending order.
+        // particleList Filled with particle of each slot.
+        void GetParticles(std::vector<uint32_t>& indexList, std::vector<Particle>& particleList) const;
+
+        // Get number of threads updating particles.
+        // Returns thread count including caller.
+        unsigned int GetThreadCount() const;
+
+        // Get instruction set of SIMD kernels.
+        // Returns name of instruction set.
+        static const char* GetSimdName();
+
+    private:
+        // Runs one step of host state: emit, collisions and update.
+        void Step(Scene* scene, float dt, bool emit);
+        // Spawns particles of scene emitters into dead slots, as Particles_Emit_CS.
+        void Emit(Scene* scene);
+        // Writes collision accelerations of alive particles.
+        void Collide();
+        // Integrates particles of range, with SIMD kernels if constant over step, else one particle at a time.
+        void Integrate(unsigned int begin, unsigned int end, float dt);
+        // Integrates one particle with force fields, as Particles_Update_CS.
+        void IntegrateParticle(unsigned int index, float dt);
+        // Sum of bound force field volumes at state.
+        glm::vec3 ForceFieldsAcceleration(const glm::vec3& position, const glm::vec3& velocity) const;
+        // Records upload of host state to output buffers of scene.
+        void Upload(VkCommandBuffer commandBuffer, Scene* scene);
+
+        VkDevice mDevice;
+        VkPhysicalDevice mPhysicalDevice;
+
+        ThreadPool* mThreadPool;
+
+        unsigned int mFrameCount;
+        // Upload region of each frame in flight, holds attributes, alive list and indirect arguments.
+        UniformRing* mUploadRing;
+
+        // Frame counter seeding emitters, as ParticleUpdateSystem.
+        unsigned int mFrameIndex;
+        float mFixedTimestep;
+        unsigned int mMaxSubstepCount;
+        float mTimeAccumulator;
+        ParticleUpdateSystem::Integrator mIntegrator;
+
+        float mCollisionRadius;
+        float mCollisionStiffness;
+        float mCollisionDamping;
+
+        // Bound volumes in slot order, compacted when stepped.
+        struct ForceField
+        {
+            VectorField* vectorField;
+            glm::mat4 worldToField;
+            glm::mat3 fieldToWorld;
+            float strength;
+            float drag;
+        };
+        ForceField mForceFieldList[ParticleUpdateSystem::MAX_FORCE_FIELDS];
+        std::vector<ForceField> mBoundForceFieldList;
+        bool mAnalyticNoise;
+
+        // Host state of every particle slot, streams padded to SIMD width. Position w is lifetime, velocity w mass.
+        unsigned int mMaxParticleCount;
+        std::vector<float> mPositionX, mPositionY, mPositionZ, mLifetime;
+        std::vector<float> mVelocityX, mVelocityY, mVelocityZ, mMass;
+        std::vector<glm::vec4> mColorList;
+        std::vector<glm::vec4> mScaleList;
+        // All bits set for slots alive at start of step, updated lanes of other slots are discarded.
+        std::vector<uint32_t> mAliveMask;
+        // All bits set for slots expired by step.
+        std::vector<uint32_t> mExpiredMask;
+        // Slots up to highest ever alive, kernels run over them.
+        unsigned int mSlotCount;
+        // Alive slots in ascending order, rebuilt each step.
+        std::vector<uint32_t> mAliveList;
+        // Stack of free slots, lowest slot on top.
+        std::vector<uint32_t> mDeadList;
+        // Whether synthetic load writes color this step.
+        bool mSyntheticLoad;
+        // Colors or scales written since last upload. Cold streams of PARTICLE_LAYOUT_SOA are uploaded only when written.
+        bool mColdDirty;
+
+        // Spatial hash grid of alive particles for collisions, counting sorted by cell as on GPU.
+        std::vector<float> mAccelerationX, mAccelerationY, mAccelerationZ;
+        std::vector<uint32_t> mGridCellCount;
+        std::vector<uint32_t> mGridCellStart;
+        std::vector<uint32_t> mGridIndexList;
+};
@@ -0,0 +1,70 @@
+#include "PrefixSum.hpp"
+#include "ComputePipeline.hpp"
+#include "vkTools.hpp"
+
+#include <vector>
+
+PrefixSum::PrefixSum(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int count, unsigned int workGroupSize)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mCount = count;
+    mGroupCount = (mCount + workGroupSize - 1) / workGroupSize;
+
+    uint32_t minOffsetAligment;
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * mGroupCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mGroupSumBuffer, mGroupSumBufferMemory, minOffsetAligment
+    );
+
+    std::vector<VkDescriptorType> descriptorTypeList{
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input values.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output prefix sums.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Block sums.
+    };
+    mScanPipeline = new ComputePipeline(mDevice, "resources/shaders/PrefixSum_CS.spv", descriptorTypeList, { workGroupSize, mCount, 0 });
+    mScanGroupsPipeline = new ComputePipeline(mDevice, "resources/shaders/PrefixSum_CS.spv", descriptorTypeList, { workGroupSize, mCount, 1 });
+    mAddPipeline = new ComputePipeline(mDevice, "resources/shaders/PrefixSum_CS.spv", descriptorTypeList, { workGroupSize, mCount, 2 });
+}
+
+PrefixSum::~PrefixSum()
+{
+    vkFreeMemory(mDevice, mGroupSumBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mGroupSumBuffer, nullptr);
+
+    delete mScanPipeline;
+    delete mScanGroupsPipeline;
+    delete mAddPipeline;
+}
+
+void PrefixSum::Scan(VkCommandBuffer commandBuffer, VkBuffer inputBuffer, VkBuffer outputBuffer)
+{
+    std::vector<VkBuffer> bufferList{ inputBuffer, outputBuffer, mGroupSumBuffer };
+
+    mScanPipeline->UpdateDescriptorSet(bufferList);
+    mScanPipeline->DispatchLinear(commandBuffer, mGroupCount);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Single block needs no carry.
+    if (mGroupCount == 1)
+        return;
+
+    mScanGroupsPipeline->UpdateDescriptorSet(bufferList);
+    mScanGroupsPipeline->Dispatch(commandBuffer, 1);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    mAddPipeline->UpdateDescriptorSet(bufferList);
+    mAddPipeline->DispatchLinear(commandBuffer, mGroupCount);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+unsigned int PrefixSum::GetCount() const
+{
+    return mCount;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+class ComputePipeline;
+
+// Exclusive prefix sum of uint buffer on GPU.
+class PrefixSum
+{
+    public:
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // count Number of elements to scan.
+        // workGroupSize Number of threads per compute work group.
+        PrefixSum(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int count, unsigned int workGroupSize);
+
+        // Destructor.
+        ~PrefixSum();
+
+        // Scan input into output. Buffers must not alias.
+        // commandBuffer Command buffer to record.
+        // inputBuffer Buffer of count uints.
+        // outputBuffer Buffer of count uints, written with exclusive prefix sum.
+        void Scan(VkCommandBuffer commandBuffer, VkBuffer inputBuffer, VkBuffer outputBuffer);
+
+        // Get number of elements to scan.
+        // Returns element count.
+        unsigned int GetCount() const;
+
+    private:
+        VkDevice mDevice;
+        VkPhysicalDevice mPhysicalDevice;
+
+        unsigned int mCount;
+        unsigned int mGroupCount;
+
+        // Scans blocks.
+        ComputePipeline* mScanPipeline;
+        // Scans block sums.
+        ComputePipeline* mScanGroupsPipeline;
+        // Adds block sums.
+        ComputePipeline* mAddPipeline;
+
+        VkBuffer mGroupSumBuffer;
+        VkDeviceMemory mGroupSumBufferMemory;
+};
@@ -0,0 +1,118 @@
+#include "RadixSort.hpp"
+#include "ComputePipeline.hpp"
+#include "PrefixSum.hpp"
+#include "vkTools.hpp"
+
+// Must match RADIX_BITS of shader.
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+
+RadixSort::RadixSort(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int count, unsigned int workGroupSize, unsigned int keyBits)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mCount = count;
+    mGroupCount = (mCount + workGroupSize - 1) / workGroupSize;
+    mPassCount = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+
+    uint32_t minOffsetAligment;
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * mCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mTempKeyBuffer, mTempKeyBufferMemory, minOffsetAligment
+    );
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * mCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mTempValueBuffer, mTempValueBufferMemory, minOffsetAligment
+    );
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * RADIX * mGroupCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mHistogramBuffer, mHistogramBufferMemory, minOffsetAligment
+    );
+    vkTools::CreateBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * RADIX * mGroupCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mOffsetBuffer, mOffsetBufferMemory, minOffsetAligment
+    );
+
+    mPrefixSum = new PrefixSum(mDevice, mPhysicalDevice, RADIX * mGroupCount, workGroupSize);
+
+    std::vector<VkDescriptorType> descriptorTypeList{
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input keys.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Input values.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output keys.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Output values.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Histogram.
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Offsets.
+    };
+    for (unsigned int pass = 0; pass < mPassCount; ++pass)
+    {
+        mHistogramPipelineList.push_back(new ComputePipeline(mDevice, "resources/shaders/RadixSort_CS.spv", descriptorTypeList, { workGroupSize, mCount, pass * RADIX_BITS, 0 }));
+        mScatterPipelineList.push_back(new ComputePipeline(mDevice, "resources/shaders/RadixSort_CS.spv", descriptorTypeList, { workGroupSize, mCount, pass * RADIX_BITS, 1 }));
+    }
+}
+
+RadixSort::~RadixSort()
+{
+    vkFreeMemory(mDevice, mTempKeyBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mTempKeyBuffer, nullptr);
+    vkFreeMemory(mDevice, mTempValueBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mTempValueBuffer, nullptr);
+    vkFreeMemory(mDevice, mHistogramBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mHistogramBuffer, nullptr);
+    vkFreeMemory(mDevice, mOffsetBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mOffsetBuffer, nullptr);
+
+    for (ComputePipeline* pipeline : mHistogramPipelineList)
+        delete pipeline;
+    for (ComputePipeline* pipeline : mScatterPipelineList)
+        delete pipeline;
+    delete mPrefixSum;
+}
+
+void RadixSort::Sort(VkCommandBuffer commandBuffer, VkBuffer keyBuffer, VkBuffer valueBuffer)
+{
+    VkBuffer keyBufferList[2] = { keyBuffer, mTempKeyBuffer };
+    VkBuffer valueBufferList[2] = { valueBuffer, mTempValueBuffer };
+
+    for (unsigned int pass = 0; pass < mPassCount; ++pass)
+    {
+        unsigned int in = pass % 2;
+        unsigned int out = 1 - in;
+        std::vector<VkBuffer> bufferList{ keyBufferList[in], valueBufferList[in], keyBufferList[out], valueBufferList[out], mHistogramBuffer, mOffsetBuffer };
+
+        mHistogramPipelineList[pass]->UpdateDescriptorSet(bufferList);
+        mHistogramPipelineList[pass]->DispatchLinear(commandBuffer, mGroupCount);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        mPrefixSum->Scan(commandBuffer, mHistogramBuffer, mOffsetBuffer);
+
+        mScatterPipelineList[pass]->UpdateDescriptorSet(bufferList);
+        mScatterPipelineList[pass]->DispatchLinear(commandBuffer, mGroupCount);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    // Result is in temp buffers after odd pass count.
+    if (mPassCount % 2 == 1)
+    {
+        VkBufferCopy bufferCopy;
+        bufferCopy.srcOffset = 0;
+        bufferCopy.dstOffset = 0;
+        bufferCopy.size = sizeof(uint32_t) * mCount;
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdCopyBuffer(commandBuffer, mTempKeyBuffer, keyBuffer, 1, &bufferCopy);
+        vkCmdCopyBuffer(commandBuffer, mTempValueBuffer, valueBuffer, 1, &bufferCopy);
+        vkTools::PipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+}
+
+unsigned int RadixSort::GetCount() const
+{
+    return mCount;
+}
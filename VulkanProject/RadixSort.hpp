@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+class ComputePipeline;
+class PrefixSum;
+
+// Stable key/value radix sort of uint buffers on GPU, 4 bits per pass.
+class RadixSort
+{
+    public:
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // count Number of keys to sort.
+        // workGroupSize Number of threads per compute work group.
+        // keyBits Number of low key bits to sort by. DEFAULT [32]
+        RadixSort(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int count, unsigned int workGroupSize, unsigned int keyBits = 32);
+
+        // Destructor.
+        ~RadixSort();
+
+        // Sort keys ascending, values follow keys. Odd pass counts copy result back, buffers then need transfer usage.
+        // commandBuffer Command buffer to record.
+        // keyBuffer Buffer of count uint keys.
+        // valueBuffer Buffer of count uint values.
+        void Sort(VkCommandBuffer commandBuffer, VkBuffer keyBuffer, VkBuffer valueBuffer);
+
+        // Get number of keys to sort.
+        // Returns key count.
+        unsigned int GetCount() const;
+
+    private:
+        VkDevice mDevice;
+        VkPhysicalDevice mPhysicalDevice;
+
+        unsigned int mCount;
+        unsigned int mGroupCount;
+        unsigned int mPassCount;
+
+        // Pipelines of each pass, digit shift is specialized.
+        std::vector<ComputePipeline*> mHistogramPipelineList;
+        std::vector<ComputePipeline*> mScatterPipelineList;
+        PrefixSum* mPrefixSum;
+
+        // Ping pong keys and values.
+        VkBuffer mTempKeyBuffer;
+        VkDeviceMemory mTempKeyBufferMemory;
+        VkBuffer mTempValueBuffer;
+        VkDeviceMemory mTempValueBufferMemory;
+
+        // Digit counts of each block and their prefix sum.
+        VkBuffer mHistogramBuffer;
+        VkDeviceMemory mHistogramBufferMemory;
+        VkBuffer mOffsetBuffer;
+        VkDeviceMemory mOffsetBufferMemory;
+};
@@ -1,19 +1,70 @@
 #include "Scene.hpp"
 #include "StorageSwapBuffer.hpp"
+#include "StorageColdBuffer.hpp"
+#include "vkTools.hpp"
 
-Scene::Scene(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int maxParticleCount)
+#include <assert.h>
+#include <algorithm>
+
+Scene::Scene(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int maxParticleCount, ParticleLayout particleLayout, ParticleStorage particleStorage, uint32_t updateFamilyIndex, uint32_t renderFamilyIndex)
 {
     mDevice = device;
     mPhysicalDevice = physicalDevice;
     mParticleCount = 0;
     mMaxParticleCount = maxParticleCount;
+    mParticleLayout = particleLayout;
+    mParticleStorage = particleStorage;
+    mUpdateFamilyIndex = updateFamilyIndex;
+    mRenderFamilyIndex = renderFamilyIndex;
+    mSortFrameInterval = 0;
+    mSortFrameCounter = 0;
+    mSortBoundsMin = glm::vec3(-100.f);
+    mSortBoundsMax = glm::vec3(100.f);
+
+    unsigned int bufferCount = GetParticleBufferCount();
+    if (mParticleLayout == PARTICLE_LAYOUT_SOA)
+    {
+        std::vector<uint32_t> sharedFamilyIndexList;
+        if (mUpdateFamilyIndex != VK_QUEUE_FAMILY_IGNORED && mRenderFamilyIndex != VK_QUEUE_FAMILY_IGNORED)
+            sharedFamilyIndexList = { mUpdateFamilyIndex, mRenderFamilyIndex };
+        mParticleBuffer = new StorageSwapBuffer(mDevice, mPhysicalDevice, sizeof(glm::vec4) * mMaxParticleCount, sizeof(glm::vec4), 0, bufferCount);
+        mVelocityBuffer = new StorageSwapBuffer(mDevice, mPhysicalDevice, sizeof(glm::vec4) * mMaxParticleCount, sizeof(glm::vec4), 0, bufferCount);
+        mColorBuffer = new StorageColdBuffer(mDevice, mPhysicalDevice, sizeof(glm::vec4) * mMaxParticleCount, sizeof(glm::vec4), mParticleBuffer, sharedFamilyIndexList);
+        mScaleBuffer = new StorageColdBuffer(mDevice, mPhysicalDevice, sizeof(glm::vec4) * mMaxParticleCount, sizeof(glm::vec4), mParticleBuffer, sharedFamilyIndexList);
+    }
+    else
+    {
+        mParticleBuffer = new StorageSwapBuffer(mDevice, mPhysicalDevice, sizeof(Particle) * mMaxParticleCount, sizeof(Particle), 0, bufferCount);
+        mVelocityBuffer = nullptr;
+        mColorBuffer = nullptr;
+        mScaleBuffer = nullptr;
+    }
+
+    // Alive lists are rebuilt by update each frame, so never in place.
+    unsigned int aliveBufferCount = (std::max)(bufferCount, 2u);
+    mAliveIndexBuffer = new StorageSwapBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * mMaxParticleCount, sizeof(uint32_t), 0, aliveBufferCount);
+    mIndirectBuffer = new StorageSwapBuffer(mDevice, mPhysicalDevice, sizeof(IndirectArguments), sizeof(IndirectArguments), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, aliveBufferCount);
+    mDeadIndexBuffer = new StorageBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * (4 + mMaxParticleCount), sizeof(uint32_t));
 
-    mParticleBuffer = new StorageSwapBuffer(mDevice, mPhysicalDevice, sizeof(Particle) * mMaxParticleCount, sizeof(Particle));
+    mGridEntryBuffer = new StorageBuffer(mDevice, mPhysicalDevice, sizeof(glm::uvec2) * mMaxParticleCount, sizeof(glm::uvec2));
+    mGridIndexBuffer = new StorageBuffer(mDevice, mPhysicalDevice, sizeof(uint32_t) * mMaxParticleCount, sizeof(uint32_t));
+    mDensityBuffer = new StorageBuffer(mDevice, mPhysicalDevice, sizeof(glm::vec2) * mMaxParticleCount, sizeof(glm::vec2));
+    mAccelerationBuffer = new StorageBuffer(mDevice, mPhysicalDevice, sizeof(glm::vec4) * mMaxParticleCount, sizeof(glm::vec4));
 }
 
 Scene::~Scene()
 {
     delete mParticleBuffer;
+    delete mVelocityBuffer;
+    delete mColorBuffer;
+    delete mScaleBuffer;
+    delete mAliveIndexBuffer;
+    delete mIndirectBuffer;
+    delete mDeadIndexBuffer;
+    delete mGridEntryBuffer;
+    delete mGridIndexBuffer;
+    delete mDensityBuffer;
+    delete mAccelerationBuffer;
 }
 
 void Scene::AddParticles(VkCommandBuffer commandBuffer, std::vector<Particle>& particleList)
@@ -21,9 +72,278 @@ void Scene::AddParticles(VkCommandBuffer commandBuffer, std::vector<Particle>& p
     unsigned int offset = mParticleCount * sizeof(Particle);
     unsigned int particleCount = (unsigned int)particleList.size();
     unsigned int bytes = particleCount * sizeof(Particle);
+    assert(mParticleCount + particleCount <= mMaxParticleCount);
 
-    mParticleBuffer->GetInputBuffer()->Write(commandBuffer, particleList.data(), bytes, offset);
-    mParticleBuffer->GetOutputBuffer()->Write(commandBuffer, particleList.data(), bytes, offset);
+    if (particleCount > 0 && mParticleLayout == PARTICLE_LAYOUT_SOA)
+    {
+        // Split into attribute streams.
+        std::vector<glm::vec4> positionList(particleCount), velocityList(particleCount), colorList(particleCount), scaleList(particleCount);
+        for (unsigned int i = 0; i < particleCount; ++i)
+        {
+            positionList[i] = particleList[i].position;
+            velocityList[i] = particleList[i].velocity;
+            colorList[i] = particleList[i].color;
+            scaleList[i] = particleList[i].scale;
+        }
+        unsigned int streamOffset = mParticleCount * sizeof(glm::vec4);
+        unsigned int streamBytes = particleCount * sizeof(glm::vec4);
+        for (unsigned int i = 0; i < mParticleBuffer->GetBufferCount(); ++i)
+        {
+            mParticleBuffer->GetBuffer(i)->Write(commandBuffer, positionList.data(), streamBytes, streamOffset);
+            mVelocityBuffer->GetBuffer(i)->Write(commandBuffer, velocityList.data(), streamBytes, streamOffset);
+        }
+        for (unsigned int i = 0; i < mColorBuffer->GetBufferCount(); ++i)
+            mColorBuffer->GetBuffer(i)->Write(commandBuffer, colorList.data(), streamBytes, streamOffset);
+        for (unsigned int i = 0; i < mScaleBuffer->GetBufferCount(); ++i)
+            mScaleBuffer->GetBuffer(i)->Write(commandBuffer, scaleList.data(), streamBytes, streamOffset);
+    }
+    else if (particleCount > 0)
+    {
+        for (unsigned int i = 0; i < mParticleBuffer->GetBufferCount(); ++i)
+            mParticleBuffer->GetBuffer(i)->Write(commandBuffer, particleList.data(), bytes, offset);
+    }
 
     mParticleCount += particleCount;
+
+    ResetLifecycle(commandBuffer);
+}
+
+void Scene::Clear(VkCommandBuffer commandBuffer)
+{
+    mParticleCount = 0;
+
+    ResetLifecycle(commandBuffer);
+}
+
+unsigned int Scene::AddEmitter(const ParticleEmitter& emitter)
+{
+    assert(mEmitterList.size() < mMaxEmitterCount);
+
+    mEmitterList.push_back(emitter);
+    mEmitAccumulatorList.push_back(0.f);
+
+    return (unsigned int)mEmitterList.size() - 1;
+}
+
+ParticleEmitter& Scene::GetEmitter(unsigned int index)
+{
+    assert(index < mEmitterList.size());
+
+    return mEmitterList[index];
+}
+
+void Scene::SetMortonSort(unsigned int frameInterval, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    assert(glm::all(glm::lessThan(boundsMin, boundsMax)));
+    mSortFrameInterval = frameInterval;
+    mSortFrameCounter = 0;
+    mSortBoundsMin = boundsMin;
+    mSortBoundsMax = boundsMax;
+}
+
+Scene::ParticleLayout Scene::GetParticleLayout() const
+{
+    return mParticleLayout;
+}
+
+Scene::ParticleStorage Scene::GetParticleStorage() const
+{
+    return mParticleStorage;
+}
+
+unsigned int Scene::GetParticleBufferCount() const
+{
+    switch (mParticleStorage)
+    {
+        case PARTICLE_STORAGE_IN_PLACE:
+            return 1;
+        case PARTICLE_STORAGE_TRIPLE_BUFFERED:
+            return 3;
+        default:
+            return 2;
+    }
+}
+
+void Scene::GetSwapState(std::vector<VkBuffer>& bufferList)
+{
+    bufferList.clear();
+    mParticleBuffer->GetState(bufferList);
+    if (mVelocityBuffer != nullptr)
+    {
+        mVelocityBuffer->GetState(bufferList);
+        mColorBuffer->GetState(bufferList);
+        mScaleBuffer->GetState(bufferList);
+    }
+    mAliveIndexBuffer->GetState(bufferList);
+    mIndirectBuffer->GetState(bufferList);
+}
+
+void Scene::ReadParticles(VkCommandPool commandPool, VkQueue queue, std::vector<uint32_t>& indexList, std::vector<Particle>& particleList)
+{
+    std::vector<StorageBuffer*> bufferList = { mParticleBuffer->GetInputBuffer(), mAliveIndexBuffer->GetInputBuffer(), mIndirectBuffer->GetInputBuffer() };
+    if (mParticleLayout == PARTICLE_LAYOUT_SOA)
+    {
+        bufferList.push_back(mVelocityBuffer->GetInputBuffer());
+        bufferList.push_back(mColorBuffer->GetInputBuffer());
+        bufferList.push_back(mScaleBuffer->GetInputBuffer());
+    }
+    VkCommandBuffer commandBuffer = vkTools::BeginSingleTimeCommand(mDevice, commandPool);
+    for (StorageBuffer* buffer : bufferList)
+        buffer->Download(commandBuffer);
+    vkTools::EndSingleTimeCommand(mDevice, commandPool, queue, commandBuffer);
+
+    IndirectArguments indirectArguments;
+    mIndirectBuffer->GetInputBuffer()->Read(&indirectArguments, sizeof(IndirectArguments), 0);
+    unsigned int aliveCount = indirectArguments.draw.vertexCount;
+    assert(aliveCount <= mMaxParticleCount);
+    indexList.resize(aliveCount);
+    if (aliveCount > 0)
+        mAliveIndexBuffer->GetInputBuffer()->Read(indexList.data(), aliveCount * sizeof(uint32_t), 0);
+    // Order of alive lists depends on order of atomics.
+    std::sort(indexList.begin(), indexList.end());
+
+    std::vector<Particle> slotList(mMaxParticleCount);
+    if (mParticleLayout == PARTICLE_LAYOUT_SOA)
+    {
+        std::vector<glm::vec4> positionList(mMaxParticleCount), velocityList(mMaxParticleCount), colorList(mMaxParticleCount), scaleList(mMaxParticleCount);
+        unsigned int streamBytes = mMaxParticleCount * sizeof(glm::vec4);
+        mParticleBuffer->GetInputBuffer()->Read(positionList.data(), streamBytes, 0);
+        mVelocityBuffer->GetInputBuffer()->Read(velocityList.data(), streamBytes, 0);
+        mColorBuffer->GetInputBuffer()->Read(colorList.data(), streamBytes, 0);
+        mScaleBuffer->GetInputBuffer()->Read(scaleList.data(), streamBytes, 0);
+        for (unsigned int i = 0; i < mMaxParticleCount; ++i)
+        {
+            slotList[i].position = positionList[i];
+            slotList[i].velocity = velocityList[i];
+            slotList[i].color = colorList[i];
+            slotList[i].scale = scaleList[i];
+        }
+    }
+    else
+    {
+        mParticleBuffer->GetInputBuffer()->Read(slotList.data(), mMaxParticleCount * sizeof(Particle), 0);
+    }
+
+    particleList.resize(aliveCount);
+    for (unsigned int i = 0; i < aliveCount; ++i)
+        particleList[i] = slotList[indexList[i]];
+}
+
+unsigned int Scene::GetParticleMemorySize() const
+{
+    unsigned int bufferCount = GetParticleBufferCount();
+    if (mParticleLayout == PARTICLE_LAYOUT_SOA)
+    {
+        // Positions and velocities in each buffer, colors and scales in each cold buffer created so far.
+        return (2 * bufferCount + mColorBuffer->GetBufferCount() + mScaleBuffer->GetBufferCount()) * sizeof(glm::vec4) * mMaxParticleCount;
+    }
+    return bufferCount * sizeof(Particle) * mMaxParticleCount;
+}
+
+void Scene::Substep()
+{
+    mParticleBuffer->Substep();
+    if (mVelocityBuffer != nullptr)
+        mVelocityBuffer->Substep();
+    mAliveIndexBuffer->Substep();
+    mIndirectBuffer->Substep();
+}
+
+void Scene::EndSubsteps()
+{
+    mParticleBuffer->EndSubsteps();
+    if (mVelocityBuffer != nullptr)
+        mVelocityBuffer->EndSubsteps();
+    mAliveIndexBuffer->EndSubsteps();
+    mIndirectBuffer->EndSubsteps();
+}
+
+void Scene::PrepareColdStreams(bool writeColor, bool writeScale)
+{
+    if (mParticleLayout != PARTICLE_LAYOUT_SOA)
+        return;
+
+    if (writeColor)
+        mColorBuffer->Write();
+    else
+        mColorBuffer->Share();
+    if (writeScale)
+        mScaleBuffer->Write();
+    else
+        mScaleBuffer->Share();
+}
+
+void Scene::GetRenderBuffers(bool input, std::vector<StorageBuffer*>& bufferList)
+{
+    // Velocities of PARTICLE_LAYOUT_SOA are not drawn and stay with update. Colors and scales are shared by both queue families.
+    bufferList.clear();
+    StorageSwapBuffer* swapBufferList[] = { mParticleBuffer, mAliveIndexBuffer, mIndirectBuffer };
+    for (StorageSwapBuffer* swapBuffer : swapBufferList)
+    {
+        if (swapBuffer != nullptr)
+            bufferList.push_back(input ? swapBuffer->GetInputBuffer() : swapBuffer->GetOutputBuffer());
+    }
+}
+
+void Scene::AcquireUpdateBuffers(VkCommandBuffer commandBuffer)
+{
+    std::vector<StorageBuffer*> bufferList;
+    GetRenderBuffers(false, bufferList);
+    for (StorageBuffer* buffer : bufferList)
+        buffer->AcquireOwnership(commandBuffer, mUpdateFamilyIndex, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+}
+
+void Scene::ReleaseUpdateBuffers(VkCommandBuffer commandBuffer)
+{
+    std::vector<StorageBuffer*> bufferList;
+    GetRenderBuffers(true, bufferList);
+    for (StorageBuffer* buffer : bufferList)
+        buffer->ReleaseOwnership(commandBuffer, mUpdateFamilyIndex, mRenderFamilyIndex, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+}
+
+void Scene::AcquireRenderBuffers(VkCommandBuffer commandBuffer)
+{
+    std::vector<StorageBuffer*> bufferList;
+    GetRenderBuffers(true, bufferList);
+    for (StorageBuffer* buffer : bufferList)
+        buffer->AcquireOwnership(commandBuffer, mRenderFamilyIndex, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+}
+
+void Scene::ReleaseRenderBuffers(VkCommandBuffer commandBuffer)
+{
+    std::vector<StorageBuffer*> bufferList;
+    GetRenderBuffers(true, bufferList);
+    for (StorageBuffer* buffer : bufferList)
+        buffer->ReleaseOwnership(commandBuffer, mRenderFamilyIndex, mUpdateFamilyIndex, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+}
+
+void Scene::ResetLifecycle(VkCommandBuffer commandBuffer)
+{
+    // Added particles are alive.
+    if (mParticleCount > 0)
+    {
+        std::vector<uint32_t> aliveList(mParticleCount);
+        for (unsigned int i = 0; i < mParticleCount; ++i)
+            aliveList[i] = i;
+        unsigned int bytes = mParticleCount * sizeof(uint32_t);
+        for (unsigned int i = 0; i < mAliveIndexBuffer->GetBufferCount(); ++i)
+            mAliveIndexBuffer->GetBuffer(i)->Write(commandBuffer, aliveList.data(), bytes, 0);
+    }
+
+    // Remaining slots are dead, lowest index on top of stack.
+    unsigned int deadCount = mMaxParticleCount - mParticleCount;
+    std::vector<uint32_t> deadList(4 + deadCount, 0);
+    deadList[0] = deadCount;
+    for (unsigned int i = 0; i < deadCount; ++i)
+        deadList[4 + i] = mMaxParticleCount - 1 - i;
+    mDeadIndexBuffer->Write(commandBuffer, deadList.data(), (unsigned int)deadList.size() * sizeof(uint32_t), 0);
+
+    // Group count is computed on GPU before each update.
+    IndirectArguments indirectArguments = {};
+    indirectArguments.draw.vertexCount = mParticleCount;
+    indirectArguments.draw.instanceCount = 1;
+    indirectArguments.dispatch.y = 1;
+    indirectArguments.dispatch.z = 1;
+    for (unsigned int i = 0; i < mIndirectBuffer->GetBufferCount(); ++i)
+        mIndirectBuffer->GetBuffer(i)->Write(commandBuffer, &indirectArguments, sizeof(IndirectArguments), 0);
 }
@@ -4,34 +4,193 @@
 #include "Particle.hpp"
 #include <vulkan/vulkan.h>
 
+class StorageBuffer;
 class StorageSwapBuffer;
+class StorageColdBuffer;
 class ParticleRenderSystem;
 class ParticleUpdateSystem;
+class ParticleUpdateSystemCPU;
+class ParticleStatistics;
 
 class Scene
 {
     friend ParticleRenderSystem;
     friend ParticleUpdateSystem;
+    friend ParticleUpdateSystemCPU;
+    friend ParticleStatistics;
 
     public:
+        // Memory layout of particle attributes.
+        enum ParticleLayout
+        {
+            // Array of Particle structs, double buffered.
+            PARTICLE_LAYOUT_AOS = 0,
+            // Stream per attribute. Hot position and velocity are double buffered, cold color and scale are not.
+            PARTICLE_LAYOUT_SOA = 1,
+            PARTICLE_LAYOUT_COUNT = 2
+        };
+
+        // Buffering of particle attributes written by update.
+        enum ParticleStorage
+        {
+            // Update reads input and writes output buffers, render draws input while update runs.
+            PARTICLE_STORAGE_DOUBLE_BUFFERED = 0,
+            // Update reads and writes one buffer, halving particle memory. Render must wait for update.
+            // Update system must support it with its settings, see ParticleUpdateSystem::SupportsInPlaceUpdate.
+            PARTICLE_STORAGE_IN_PLACE = 1,
+            // Update reads input and writes output, while render draws buffer of previous frame on another queue.
+            // Update of next frame need not wait for render of this frame.
+            PARTICLE_STORAGE_TRIPLE_BUFFERED = 2,
+            PARTICLE_STORAGE_COUNT = 3
+        };
+
+        // Indirect arguments of an alive list, written by GPU.
+        struct IndirectArguments
+        {
+            // vertexCount Number of alive particles.
+            VkDrawIndirectCommand draw;
+            // Work groups to update alive particles, split over X and Y by prepare within max group count.
+            VkDispatchIndirectCommand dispatch;
+            uint32_t pad;
+        };
+
         // Constructor.
         // device Vulkan device.
         // physicalDevice Vulkan physical device.
         // maxParticleCount Max number of particles in scene.
-        Scene(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int maxParticleCount);
+        // particleLayout Memory layout of particle attributes. DEFAULT [PARTICLE_LAYOUT_AOS]
+        // particleStorage Buffering of particle attributes written by update. Alive lists are at least double buffered. DEFAULT [PARTICLE_STORAGE_DOUBLE_BUFFERED]
+        // updateFamilyIndex Queue family of update and uploads. DEFAULT [VK_QUEUE_FAMILY_IGNORED]
+        // renderFamilyIndex Queue family of render. Buffers drawn by render change owner each frame if it differs from update. DEFAULT [VK_QUEUE_FAMILY_IGNORED]
+        Scene(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int maxParticleCount, ParticleLayout particleLayout = PARTICLE_LAYOUT_AOS, ParticleStorage particleStorage = PARTICLE_STORAGE_DOUBLE_BUFFERED,
+            uint32_t updateFamilyIndex = VK_QUEUE_FAMILY_IGNORED, uint32_t renderFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
 
         // Destructor.
         ~Scene();
 
-        // Adds partilces to scene.
+        // Adds partilces to scene. Particles spawned by emitters are removed.
         // commandBuffer Command buffer to make device copy.
         // particleList Vector of particles to add.
         void AddParticles(VkCommandBuffer commandBuffer, std::vector<Particle>& particleList);
 
+        // Removes all particles from scene. Must be called once before emitting into a scene without added particles.
+        // commandBuffer Command buffer to make device copy.
+        void Clear(VkCommandBuffer commandBuffer);
+
+        // Adds emitter spawning particles on the GPU each update.
+        // emitter Emitter to add.
+        // Returns index of emitter.
+        unsigned int AddEmitter(const ParticleEmitter& emitter);
+
+        // Get emitter.
+        // index Index of emitter.
+        // Returns emitter, changes apply on next update.
+        ParticleEmitter& GetEmitter(unsigned int index);
+
+        // Re-sort particles by 30 bit Morton code of position every frameInterval frames, so particles near in space are near in memory.
+        // Also compacts alive particles to the first indices.
+        // frameInterval Frames between sorts, zero disables.
+        // boundsMin Minimum corner of volume quantized to 1024^3 cells. DEFAULT [(-100, -100, -100)]
+        // boundsMax Maximum corner of volume, positions outside are clamped. Bounds also quantize Barnes-Hut tree keys. DEFAULT [(100, 100, 100)]
+        void SetMortonSort(unsigned int frameInterval, const glm::vec3& boundsMin = glm::vec3(-100.f), const glm::vec3& boundsMax = glm::vec3(100.f));
+
+        // Get memory layout of particle attributes.
+        // Returns particle layout.
+        ParticleLayout GetParticleLayout() const;
+
+        // Get buffering of particle attributes.
+        // Returns particle storage.
+        ParticleStorage GetParticleStorage() const;
+
+        // Get number of buffers of particle attributes written by update.
+        // Returns 1, 2 or 3.
+        unsigned int GetParticleBufferCount() const;
+
+        // Get buffers of swap buffers in current order. Commands recorded for equal lists bind the same buffers.
+        // bufferList Filled with buffers.
+        void GetSwapState(std::vector<VkBuffer>& bufferList);
+
+        // Read alive particles drawn by next render, held by input of swap buffers. Waits for queue to finish.
+        // commandPool Command pool of queue family owning input buffers, update family after an update.
+        // queue Queue of command pool.
+        // indexList Filled with slots of alive particles in ascending order.
+        // particleList Filled with particle of each slot.
+        void ReadParticles(VkCommandPool commandPool, VkQueue queue, std::vector<uint32_t>& indexList, std::vector<Particle>& particleList);
+
+        // Get device memory of particle attribute buffers, excluding staging buffers.
+        // Returns size in bytes.
+        unsigned int GetParticleMemorySize() const;
+
     private:
+        // Writes alive lists, dead list and indirect arguments for added particles.
+        void ResetLifecycle(VkCommandBuffer commandBuffer);
+
+        // Makes output of swap buffers input of next update substep, keeping input of frame unwritten.
+        void Substep();
+        // Restores input of frame after substeps, output holds result of last substep.
+        void EndSubsteps();
+        // Gives output of cold streams a buffer of its own when update writes them, shares input otherwise.
+        // Called before each update substep or sort that reads cold streams. Does nothing with PARTICLE_LAYOUT_AOS.
+        // writeColor Whether output colors are written.
+        // writeScale Whether output scales are written.
+        void PrepareColdStreams(bool writeColor, bool writeScale);
+
+        // Gets buffers drawn by render, input or output of swap buffers.
+        void GetRenderBuffers(bool input, std::vector<StorageBuffer*>& bufferList);
+
+        // Acquires output buffers drawn by an earlier render, before update writes them.
+        void AcquireUpdateBuffers(VkCommandBuffer commandBuffer);
+        // Releases input buffers to render, after update.
+        void ReleaseUpdateBuffers(VkCommandBuffer commandBuffer);
+        // Acquires input buffers released by update, before render culls, draws or copies from them.
+        void AcquireRenderBuffers(VkCommandBuffer commandBuffer);
+        // Releases input buffers to a later update, after render.
+        void ReleaseRenderBuffers(VkCommandBuffer commandBuffer);
+
         unsigned int mMaxParticleCount;
+        // Number of particles added from CPU, occupying first slots.
         unsigned int mParticleCount;
+        ParticleLayout mParticleLayout;
+        ParticleStorage mParticleStorage;
+        uint32_t mUpdateFamilyIndex;
+        uint32_t mRenderFamilyIndex;
+        // Particles, or positions with PARTICLE_LAYOUT_SOA. Input and output are the same buffer with PARTICLE_STORAGE_IN_PLACE.
         StorageSwapBuffer* mParticleBuffer;
+        // Attribute streams of PARTICLE_LAYOUT_SOA, nullptr otherwise.
+        StorageSwapBuffer* mVelocityBuffer;
+        // Follow states of particle buffer, written by emit, synthetic load and Morton sort while render draws input.
+        // Shared by update and render queue families.
+        StorageColdBuffer* mColorBuffer;
+        StorageColdBuffer* mScaleBuffer;
+
+        // Indices of alive particles. Input is read by update and render, output is written by update.
+        StorageSwapBuffer* mAliveIndexBuffer;
+        // IndirectArguments of alive index buffers.
+        StorageSwapBuffer* mIndirectBuffer;
+        // Stack of free particle indices. Header of int count and 3 pad words.
+        StorageBuffer* mDeadIndexBuffer;
+
+        // Spatial hash grid of input particles, built by update system when neighbor queries are enabled.
+        // Cell and slot within cell of each alive particle, as uvec2.
+        StorageBuffer* mGridEntryBuffer;
+        // Particle indices sorted by cell.
+        StorageBuffer* mGridIndexBuffer;
+
+        // Density and pressure of each grid sorted slot, as vec2.
+        StorageBuffer* mDensityBuffer;
+        // Acceleration of each particle written by force passes, as vec4.
+        StorageBuffer* mAccelerationBuffer;
+
+        // Morton sort, run by update system.
+        unsigned int mSortFrameInterval;
+        unsigned int mSortFrameCounter;
+        glm::vec3 mSortBoundsMin;
+        glm::vec3 mSortBoundsMax;
+
+        // Emitters.
+        static const unsigned int mMaxEmitterCount = 16;
+        std::vector<ParticleEmitter> mEmitterList;
+        std::vector<float> mEmitAccumulatorList;
 
         VkDevice mDevice;
         VkPhysicalDevice mPhysicalDevice;
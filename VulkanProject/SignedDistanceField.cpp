@@ -0,0 +1,418 @@
+#include "SignedDistanceField.hpp"
+
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+
+// Cache file header.
+static const char gCacheMagic[4] = { 'S', 'D', 'F', '1' };
+
+// Run function for every index on worker threads.
+static void ParallelFor(unsigned int count, unsigned int threadCount, const std::function<void(unsigned int)>& function)
+{
+    std::atomic<unsigned int> next(0);
+    auto Work = [&]()
+    {
+        for (unsigned int i = next++; i < count; i = next++)
+            function(i);
+    };
+    std::vector<std::thread> threadList;
+    for (unsigned int i = 1; i < threadCount; ++i)
+        threadList.push_back(std::thread(Work));
+    Work();
+    for (std::thread& thread : threadList)
+        thread.join();
+}
+
+// FNV-1a hash of bytes.
+static void Hash(uint64_t& hash, const void* data, std::size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+// Closest point on triangle abc to p.
+static glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f)
+        return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3)
+        return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+        return a + d1 / (d1 - d3) * ab;
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6)
+        return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+        return a + d2 / (d2 - d6) * ac;
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f)
+        return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+
+    float denominator = 1.f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Twice signed area of triangle abp. Exactly negated when a and b swap, so triangles sharing an edge agree on it.
+static float EdgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p)
+{
+    if (b.x < a.x || (b.x == a.x && b.y < a.y))
+        return -EdgeFunction(b, a, p);
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// Whether point on edge from a to b of counter clockwise triangle is covered. Exactly one of two triangles sharing the edge covers it.
+static bool CoversEdge(const glm::vec2& a, const glm::vec2& b)
+{
+    return b.y > a.y || (b.y == a.y && b.x > a.x);
+}
+
+// Appends triangles of OBJ file, polygons are split into fans.
+static void LoadOBJ(const std::string& path, const glm::mat4& transform, std::vector<glm::vec3>& triangleList)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open mesh: " << path << std::endl;
+        return;
+    }
+
+    std::vector<glm::vec3> vertexList;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::stringstream lineStream(line);
+        std::string type;
+        lineStream >> type;
+        if (type == "v")
+        {
+            glm::vec4 vertex(0.f, 0.f, 0.f, 1.f);
+            lineStream >> vertex.x >> vertex.y >> vertex.z;
+            vertexList.push_back(glm::vec3(transform * vertex));
+        }
+        else if (type == "f")
+        {
+            // Vertex index is first of v/vt/vn, negative indices count from end.
+            std::vector<int> indexList;
+            std::string token;
+            while (lineStream >> token)
+            {
+                int index = std::atoi(token.c_str());
+                indexList.push_back(index < 0 ? (int)vertexList.size() + index : index - 1);
+            }
+            for (std::size_t i = 2; i < indexList.size(); ++i)
+            {
+                triangleList.push_back(vertexList[indexList[0]]);
+                triangleList.push_back(vertexList[indexList[i - 1]]);
+                triangleList.push_back(vertexList[indexList[i]]);
+            }
+        }
+    }
+}
+
+SignedDistanceField::SignedDistanceField(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, const std::vector<Mesh>& meshList, const std::string& cachePath, unsigned int resolution, float padding, unsigned int threadCount)
+{
+    mResolution = meshList.empty() ? 1 : resolution;
+    mCached = false;
+    if (threadCount == 0)
+        threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<uint16_t> voxelList;
+    if (meshList.empty())
+    {
+        // Far outside, normal up.
+        mBoundsMin = glm::vec3(-1.f);
+        mBoundsMax = glm::vec3(1.f);
+        voxelList = { glm::packHalf1x16(0.f), glm::packHalf1x16(1.f), glm::packHalf1x16(0.f), glm::packHalf1x16(65504.f) };
+    }
+    else
+    {
+        // Key of cache, source files are identified by size and modification time.
+        uint64_t key = 14695981039346656037ull;
+        Hash(key, &mResolution, sizeof(mResolution));
+        Hash(key, &padding, sizeof(padding));
+        for (const Mesh& mesh : meshList)
+        {
+            struct stat fileStat;
+            int64_t fileInfo[2] = { 0, 0 };
+            if (stat(mesh.path.c_str(), &fileStat) == 0)
+            {
+                fileInfo[0] = (int64_t)fileStat.st_size;
+                fileInfo[1] = (int64_t)fileStat.st_mtime;
+            }
+            Hash(key, mesh.path.data(), mesh.path.size());
+            Hash(key, fileInfo, sizeof(fileInfo));
+            Hash(key, &mesh.transform, sizeof(mesh.transform));
+        }
+
+        if (!cachePath.empty() && ReadCache(cachePath, key, voxelList))
+        {
+            mCached = true;
+        }
+        else
+        {
+            std::vector<glm::vec3> triangleList;
+            for (const Mesh& mesh : meshList)
+                LoadOBJ(mesh.path, mesh.transform, triangleList);
+
+            // Cube around meshes, so voxels are cubes.
+            glm::vec3 meshMin(0.f);
+            glm::vec3 meshMax(0.f);
+            if (!triangleList.empty())
+            {
+                meshMin = meshMax = triangleList[0];
+                for (const glm::vec3& vertex : triangleList)
+                {
+                    meshMin = glm::min(meshMin, vertex);
+                    meshMax = glm::max(meshMax, vertex);
+                }
+            }
+            glm::vec3 center = (meshMin + meshMax) * 0.5f;
+            glm::vec3 extent = meshMax - meshMin;
+            float halfSize = (std::max)(extent.x, (std::max)(extent.y, extent.z)) * 0.5f + padding;
+            mBoundsMin = center - glm::vec3(halfSize);
+            mBoundsMax = center + glm::vec3(halfSize);
+
+            Bake(triangleList, voxelList, threadCount);
+            if (!cachePath.empty())
+                WriteCache(cachePath, key, voxelList);
+        }
+    }
+
+    mTexture = new Texture3D(device, physicalDevice, commandBuffer, glm::uvec3(mResolution), voxelList.data(), voxelList.size() * sizeof(uint16_t));
+}
+
+SignedDistanceField::~SignedDistanceField()
+{
+    delete mTexture;
+}
+
+void SignedDistanceField::Bake(const std::vector<glm::vec3>& triangleList, std::vector<uint16_t>& voxelList, unsigned int threadCount)
+{
+    const unsigned int n = mResolution;
+    const int triangleCount = (int)(triangleList.size() / 3);
+    const glm::vec3 voxelSize = (mBoundsMax - mBoundsMin) / (float)n;
+    auto VoxelIndex = [n](unsigned int x, unsigned int y, unsigned int z) { return ((std::size_t)z * n + y) * n + x; };
+    auto VoxelCenter = [&](unsigned int x, unsigned int y, unsigned int z) { return mBoundsMin + (glm::vec3(x, y, z) + 0.5f) * voxelSize; };
+    auto ClosestPoint = [&](const glm::vec3& p, int triangle) { return ClosestPointOnTriangle(p, triangleList[3 * triangle], triangleList[3 * triangle + 1], triangleList[3 * triangle + 2]); };
+    auto DistanceSquared = [&](const glm::vec3& p, int triangle) { glm::vec3 delta = p - ClosestPoint(p, triangle); return glm::dot(delta, delta); };
+    // Voxels whose centers are within range, clamped to field.
+    auto VoxelRange = [&](const glm::vec3& minimum, const glm::vec3& maximum, int margin, glm::ivec3& first, glm::ivec3& last)
+    {
+        first = glm::max(glm::ivec3(glm::ceil((minimum - mBoundsMin) / voxelSize - 0.5f)) - margin, glm::ivec3(0));
+        last = glm::min(glm::ivec3(glm::floor((maximum - mBoundsMin) / voxelSize - 0.5f)) + margin, glm::ivec3(n - 1));
+    };
+
+    std::vector<glm::vec3> triangleMinList(triangleCount);
+    std::vector<glm::vec3> triangleMaxList(triangleCount);
+    for (int t = 0; t < triangleCount; ++t)
+    {
+        triangleMinList[t] = glm::min(triangleList[3 * t], glm::min(triangleList[3 * t + 1], triangleList[3 * t + 2]));
+        triangleMaxList[t] = glm::max(triangleList[3 * t], glm::max(triangleList[3 * t + 1], triangleList[3 * t + 2]));
+    }
+
+    // Nearest triangle of each voxel, exact in band of one voxel around triangles. One z slice per task.
+    std::vector<int> nearestList(n * n * n, -1);
+    std::vector<float> bandDistanceList(n * n * n, 0.f);
+    ParallelFor(n, threadCount, [&](unsigned int z)
+    {
+        for (int t = 0; t < triangleCount; ++t)
+        {
+            glm::ivec3 first, last;
+            VoxelRange(triangleMinList[t], triangleMaxList[t], 1, first, last);
+            if ((int)z < first.z || (int)z > last.z)
+                continue;
+            for (int y = first.y; y <= last.y; ++y)
+                for (int x = first.x; x <= last.x; ++x)
+                {
+                    std::size_t index = VoxelIndex(x, y, z);
+                    float distanceSquared = DistanceSquared(VoxelCenter(x, y, z), t);
+                    if (nearestList[index] < 0 || distanceSquared < bandDistanceList[index])
+                    {
+                        nearestList[index] = t;
+                        bandDistanceList[index] = distanceSquared;
+                    }
+                }
+        }
+    });
+
+    // Jump flood nearest triangles to all voxels, halving step each pass with one extra pass of step one.
+    std::vector<unsigned int> stepList;
+    for (unsigned int step = n / 2; step >= 1; step /= 2)
+        stepList.push_back(step);
+    stepList.push_back(1);
+    std::vector<int> floodList(nearestList.size());
+    for (unsigned int step : stepList)
+    {
+        ParallelFor(n, threadCount, [&](unsigned int z)
+        {
+            for (unsigned int y = 0; y < n; ++y)
+                for (unsigned int x = 0; x < n; ++x)
+                {
+                    glm::vec3 p = VoxelCenter(x, y, z);
+                    int best = nearestList[VoxelIndex(x, y, z)];
+                    float bestDistanceSquared = best < 0 ? 0.f : DistanceSquared(p, best);
+                    for (int dz = -1; dz <= 1; ++dz)
+                        for (int dy = -1; dy <= 1; ++dy)
+                            for (int dx = -1; dx <= 1; ++dx)
+                            {
+                                glm::ivec3 neighbor = glm::ivec3(x, y, z) + glm::ivec3(dx, dy, dz) * (int)step;
+                                if (glm::any(glm::lessThan(neighbor, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(neighbor, glm::ivec3(n))))
+                                    continue;
+                                int candidate = nearestList[VoxelIndex(neighbor.x, neighbor.y, neighbor.z)];
+                                if (candidate < 0 || candidate == best)
+                                    continue;
+                                float distanceSquared = DistanceSquared(p, candidate);
+                                if (best < 0 || distanceSquared < bestDistanceSquared)
+                                {
+                                    best = candidate;
+                                    bestDistanceSquared = distanceSquared;
+                                }
+                            }
+                    floodList[VoxelIndex(x, y, z)] = best;
+                }
+        });
+        nearestList.swap(floodList);
+    }
+
+    // Inside where a ray along -x from voxel center crosses the surface an odd number of times.
+    std::vector<uint32_t> crossingList(n * n * n, 0);
+    std::vector<unsigned char> insideList(n * n * n, 0);
+    ParallelFor(n, threadCount, [&](unsigned int z)
+    {
+        float pz = VoxelCenter(0, 0, z).z;
+        for (int t = 0; t < triangleCount; ++t)
+        {
+            if (pz < triangleMinList[t].z || pz > triangleMaxList[t].z)
+                continue;
+            // Projected to yz plane and made counter clockwise.
+            glm::vec3 a = triangleList[3 * t];
+            glm::vec3 b = triangleList[3 * t + 1];
+            glm::vec3 c = triangleList[3 * t + 2];
+            float area = EdgeFunction(glm::vec2(a.y, a.z), glm::vec2(b.y, b.z), glm::vec2(c.y, c.z));
+            if (area == 0.f)
+                continue;
+            if (area < 0.f)
+                std::swap(b, c);
+            glm::vec2 a2(a.y, a.z);
+            glm::vec2 b2(b.y, b.z);
+            glm::vec2 c2(c.y, c.z);
+            glm::ivec3 first, last;
+            VoxelRange(triangleMinList[t], triangleMaxList[t], 0, first, last);
+            for (int y = first.y; y <= last.y; ++y)
+            {
+                glm::vec2 p(VoxelCenter(0, y, 0).y, pz);
+                float wa = EdgeFunction(b2, c2, p);
+                float wb = EdgeFunction(c2, a2, p);
+                float wc = EdgeFunction(a2, b2, p);
+                // Rays through shared edges and vertices cross exactly one triangle.
+                if (wa < 0.f || wb < 0.f || wc < 0.f || (wa == 0.f && !CoversEdge(b2, c2)) || (wb == 0.f && !CoversEdge(c2, a2)) || (wc == 0.f && !CoversEdge(a2, b2)))
+                    continue;
+                float px = (wa * a.x + wb * b.x + wc * c.x) / (wa + wb + wc);
+                int x = (std::max)((int)std::ceil((px - mBoundsMin.x) / voxelSize.x - 0.5f), 0);
+                if (x < (int)n)
+                    ++crossingList[VoxelIndex(x, y, z)];
+            }
+        }
+        for (unsigned int y = 0; y < n; ++y)
+        {
+            uint32_t crossings = 0;
+            for (unsigned int x = 0; x < n; ++x)
+            {
+                crossings += crossingList[VoxelIndex(x, y, z)];
+                insideList[VoxelIndex(x, y, z)] = crossings % 2;
+            }
+        }
+    });
+
+    // Pack normal and signed distance.
+    voxelList.resize(4 * n * n * n);
+    ParallelFor(n, threadCount, [&](unsigned int z)
+    {
+        for (unsigned int y = 0; y < n; ++y)
+            for (unsigned int x = 0; x < n; ++x)
+            {
+                std::size_t index = VoxelIndex(x, y, z);
+                glm::vec3 p = VoxelCenter(x, y, z);
+                int t = nearestList[index];
+                glm::vec4 voxel(0.f, 1.f, 0.f, 65504.f);
+                if (t >= 0)
+                {
+                    glm::vec3 delta = p - ClosestPoint(p, t);
+                    float distance = glm::length(delta);
+                    glm::vec3 normal = distance > 1e-6f ? delta / distance : glm::normalize(glm::cross(triangleList[3 * t + 1] - triangleList[3 * t], triangleList[3 * t + 2] - triangleList[3 * t]));
+                    voxel = insideList[index] ? glm::vec4(-normal, -distance) : glm::vec4(normal, distance);
+                }
+                for (int i = 0; i < 4; ++i)
+                    voxelList[4 * index + i] = glm::packHalf1x16(voxel[i]);
+            }
+    });
+}
+
+bool SignedDistanceField::ReadCache(const std::string& cachePath, uint64_t key, std::vector<uint16_t>& voxelList)
+{
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char magic[4];
+    uint64_t fileKey;
+    uint32_t resolution;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+    file.read(reinterpret_cast<char*>(&resolution), sizeof(resolution));
+    file.read(reinterpret_cast<char*>(&mBoundsMin), sizeof(mBoundsMin));
+    file.read(reinterpret_cast<char*>(&mBoundsMax), sizeof(mBoundsMax));
+    if (!file || std::memcmp(magic, gCacheMagic, sizeof(magic)) != 0 || fileKey != key || resolution != mResolution)
+        return false;
+
+    voxelList.resize(4 * (std::size_t)mResolution * mResolution * mResolution);
+    file.read(reinterpret_cast<char*>(voxelList.data()), voxelList.size() * sizeof(uint16_t));
+    return !file.fail();
+}
+
+void SignedDistanceField::WriteCache(const std::string& cachePath, uint64_t key, const std::vector<uint16_t>& voxelList)
+{
+    std::ofstream file(cachePath, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to write signed distance field cache: " << cachePath << std::endl;
+        return;
+    }
+
+    uint32_t resolution = mResolution;
+    file.write(gCacheMagic, sizeof(gCacheMagic));
+    file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    file.write(reinterpret_cast<const char*>(&resolution), sizeof(resolution));
+    file.write(reinterpret_cast<const char*>(&mBoundsMin), sizeof(mBoundsMin));
+    file.write(reinterpret_cast<const char*>(&mBoundsMax), sizeof(mBoundsMax));
+    file.write(reinterpret_cast<const char*>(voxelList.data()), voxelList.size() * sizeof(uint16_t));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Texture3D.hpp"
+
+// Signed distance field of triangle meshes, sampled from a 3D texture.
+// Baked on CPU worker threads at startup, or loaded from a cache file baked by an earlier run.
+class SignedDistanceField
+{
+    public:
+        // Mesh baked into field.
+        struct Mesh
+        {
+            // Path to OBJ file.
+            std::string path;
+            // Transform from mesh space to world space.
+            glm::mat4 transform;
+        };
+
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // commandBuffer Command buffer to upload texture.
+        // meshList Meshes to bake, the field is their union. Empty gives a single voxel far from any surface.
+        // cachePath Path of cache file, rebaked when meshes, transforms or resolution change. Empty disables cache. DEFAULT [""]
+        // resolution Number of voxels along each axis. DEFAULT [64]
+        // padding Distance around meshes covered by field. DEFAULT [1]
+        // threadCount Number of worker threads baking field. DEFAULT [0, hardware concurrency]
+        SignedDistanceField(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, const std::vector<Mesh>& meshList, const std::string& cachePath = "", unsigned int resolution = 64, float padding = 1.f, unsigned int threadCount = 0);
+
+        // Destructor.
+        ~SignedDistanceField();
+
+        // Cube covered by field in world space.
+        glm::vec3 mBoundsMin;
+        glm::vec3 mBoundsMax;
+
+        // Number of voxels along each axis.
+        unsigned int mResolution;
+
+        // Whether field was loaded from cache file.
+        bool mCached;
+
+        // Half float texture. xyz outward surface normal, w signed distance, negative inside.
+        Texture3D* mTexture;
+
+    private:
+        // Bakes triangles to voxels of packed half floats.
+        // triangleList Three world space vertices per triangle.
+        // voxelList Four half floats per voxel, x fastest.
+        // threadCount Number of worker threads.
+        void Bake(const std::vector<glm::vec3>& triangleList, std::vector<uint16_t>& voxelList, unsigned int threadCount);
+
+        // Reads cache file.
+        // Returns whether cache matches key.
+        bool ReadCache(const std::string& cachePath, uint64_t key, std::vector<uint16_t>& voxelList);
+
+        // Writes cache file.
+        void WriteCache(const std::string& cachePath, uint64_t key, const std::vector<uint16_t>& voxelList);
+};
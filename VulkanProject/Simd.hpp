@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+// Float vectors of the widest instruction set enabled at compile time: AVX2 with /arch:AVX2 or -mavx2, NEON on ARM, SSE2 on x86, scalar otherwise.
+// Lanes are independent. Masks have all bits of a lane set or clear.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SIMD_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2
+#endif
+
+namespace simd
+{
+#if defined(SIMD_AVX2)
+    const unsigned int WIDTH = 8;
+    typedef __m256 Float;
+    typedef __m256 Mask;
+    inline const char* GetName() { return "AVX2"; }
+    inline Float Load(const float* data) { return _mm256_loadu_ps(data); }
+    inline void Store(float* data, Float a) { _mm256_storeu_ps(data, a); }
+    inline Float Set(float a) { return _mm256_set1_ps(a); }
+    inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    inline Mask Greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline Mask LessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    inline Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    inline Float Select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+    inline Mask LoadMask(const uint32_t* data) { return _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)data)); }
+    inline void StoreMask(uint32_t* data, Mask mask) { _mm256_storeu_si256((__m256i*)data, _mm256_castps_si256(mask)); }
+#elif defined(SIMD_NEON)
+    const unsigned int WIDTH = 4;
+    typedef float32x4_t Float;
+    typedef uint32x4_t Mask;
+    inline const char* GetName() { return "NEON"; }
+    inline Float Load(const float* data) { return vld1q_f32(data); }
+    inline void Store(float* data, Float a) { vst1q_f32(data, a); }
+    inline Float Set(float a) { return vdupq_n_f32(a); }
+    inline Float Add(Float a, Float b) { return vaddq_f32(a, b); }
+    inline Float Sub(Float a, Float b) { return vsubq_f32(a, b); }
+    inline Float Mul(Float a, Float b) { return vmulq_f32(a, b); }
+    inline Mask Greater(Float a, Float b) { return vcgtq_f32(a, b); }
+    inline Mask LessEqual(Float a, Float b) { return vcleq_f32(a, b); }
+    inline Mask And(Mask a, Mask b) { return vandq_u32(a, b); }
+    inline Float Select(Mask mask, Float a, Float b) { return vbslq_f32(mask, a, b); }
+    inline Mask LoadMask(const uint32_t* data) { return vld1q_u32(data); }
+    inline void StoreMask(uint32_t* data, Mask mask) { vst1q_u32(data, mask); }
+#elif defined(SIMD_SSE2)
+    const unsigned int WIDTH = 4;
+    typedef __m128 Float;
+    typedef __m128 Mask;
+    inline const char* GetName() { return "SSE2"; }
+    inline Float Load(const float* data) { return _mm_loadu_ps(data); }
+    inline void Store(float* data, Float a) { _mm_storeu_ps(data, a); }
+    inline Float Set(float a) { return _mm_set1_ps(a); }
+    inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+    inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    inline Mask Greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+    inline Mask LessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+    inline Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    inline Float Select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    inline Mask LoadMask(const uint32_t* data) { return _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)data)); }
+    inline void StoreMask(uint32_t* data, Mask mask) { _mm_storeu_si128((__m128i*)data, _mm_castps_si128(mask)); }
+#else
+    const unsigned int WIDTH = 1;
+    typedef float Float;
+    typedef uint32_t Mask;
+    inline const char* GetName() { return "scalar"; }
+    inline Float Load(const float* data) { return *data; }
+    inline void Store(float* data, Float a) { *data = a; }
+    inline Float Set(float a) { return a; }
+    inline Float Add(Float a, Float b) { return a + b; }
+    inline Float Sub(Float a, Float b) { return a - b; }
+    inline Float Mul(Float a, Float b) { return a * b; }
+    inline Mask Greater(Float a, Float b) { return a > b ? 0xFFFFFFFFu : 0u; }
+    inline Mask LessEqual(Float a, Float b) { return a <= b ? 0xFFFFFFFFu : 0u; }
+    inline Mask And(Mask a, Mask b) { return a & b; }
+    inline Float Select(Mask mask, Float a, Float b) { return mask != 0u ? a : b; }
+    inline Mask LoadMask(const uint32_t* data) { return *data; }
+    inline void StoreMask(uint32_t* data, Mask mask) { *data = mask; }
+#endif
+}
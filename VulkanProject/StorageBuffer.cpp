@@ -1,27 +1,29 @@
 #include "StorageBuffer.hpp"
 #include "vkTools.hpp"
+#include <cstring>
 
-StorageBuffer::StorageBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride)
+StorageBuffer::StorageBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride, VkBufferUsageFlags usageFlags, const std::vector<uint32_t>& queueFamilyIndexList)
 {
     mDevice = device;
     mPhysicalDevice = physicalDevice;
     mSize = totalSize;
     mStride = stride;
+    mReleaseSrcFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    mReleaseDstFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     
     // Storage buffer.
+    // Always bound at offset 0, so element stride need not match min offset alignment.
     uint32_t minOffsetAlignment;
     vkTools::CreateBuffer(mDevice, mPhysicalDevice, mSize,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        mBuffer, mBufferMemory, minOffsetAlignment
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mBuffer, mBufferMemory, minOffsetAlignment, queueFamilyIndexList
         );
-    MsgAssert(mStride % minOffsetAlignment, 0, "Vulkan runtime error. VKERROR: Unsupported storage buffer alignment.");
 
     // Staging buffer.
     vkTools::CreateBuffer(mDevice, mPhysicalDevice, mSize,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         mStagingBuffer, mStagingBufferMemory, minOffsetAlignment
         );
-    MsgAssert(mStride % minOffsetAlignment, 0, "Vulkan runtime error. VKERROR: Unsupported storage buffer alignment.");
 }
 
 StorageBuffer::~StorageBuffer()
@@ -58,3 +60,55 @@ void StorageBuffer::Write(VkCommandBuffer commandBuffer, void* data, unsigned in
 
     vkTools::CopyBuffer(commandBuffer, mStagingBuffer, mBuffer, mSize, 0, 0);
 }
+
+void StorageBuffer::Update(VkCommandBuffer commandBuffer, const void* data, unsigned int byteSize, unsigned int offset)
+{
+    assert(offset + byteSize <= mSize);
+    assert(byteSize % 4 == 0 && offset % 4 == 0 && byteSize <= 65536);
+
+    vkCmdUpdateBuffer(commandBuffer, mBuffer, offset, byteSize, data);
+}
+
+void StorageBuffer::Download(VkCommandBuffer commandBuffer)
+{
+    // Copies writes of earlier commands, and makes copy visible to host.
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    vkTools::CopyBuffer(commandBuffer, mBuffer, mStagingBuffer, mSize, 0, 0);
+    vkTools::PipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+void StorageBuffer::Read(void* data, unsigned int byteSize, unsigned int offset)
+{
+    assert(offset + byteSize <= mSize);
+
+    void* mappedMemory;
+    vkTools::VkErrorCheck(vkMapMemory(mDevice, mStagingBufferMemory, offset, byteSize, 0, &mappedMemory));
+    std::memcpy(data, mappedMemory, byteSize);
+    vkUnmapMemory(mDevice, mStagingBufferMemory);
+}
+
+void StorageBuffer::ReleaseOwnership(VkCommandBuffer commandBuffer, uint32_t srcFamilyIndex, uint32_t dstFamilyIndex, VkPipelineStageFlags srcStageFlags, VkAccessFlags srcAccessFlags)
+{
+    assert(mReleaseDstFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+    if (srcFamilyIndex == dstFamilyIndex)
+        return;
+
+    mReleaseSrcFamilyIndex = srcFamilyIndex;
+    mReleaseDstFamilyIndex = dstFamilyIndex;
+    vkTools::BufferBarrier(commandBuffer, mBuffer, srcStageFlags, srcAccessFlags, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, srcFamilyIndex, dstFamilyIndex);
+}
+
+void StorageBuffer::AcquireOwnership(VkCommandBuffer commandBuffer, uint32_t dstFamilyIndex, VkPipelineStageFlags dstStageFlags, VkAccessFlags dstAccessFlags)
+{
+    if (mReleaseDstFamilyIndex != dstFamilyIndex)
+        return;
+
+    // Same barrier as release, accesses of other side are ignored.
+    vkTools::BufferBarrier(commandBuffer, mBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, dstStageFlags, dstAccessFlags, mReleaseSrcFamilyIndex, mReleaseDstFamilyIndex);
+    mReleaseSrcFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    mReleaseDstFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <vector>
 
 class StorageBuffer
 {
@@ -10,7 +11,9 @@ class StorageBuffer
         // physicalDevice Vulkan physical device.
         // totalSize Total size in bytes.
         // stride Stride of each element in bytes.
-        StorageBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride);
+        // usageFlags Additional buffer usage, e.g. indirect. DEFAULT [0]
+        // queueFamilyIndexList Queue families accessing buffer concurrently, exclusive to one family at a time if fewer than two differ. DEFAULT [{}]
+        StorageBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride, VkBufferUsageFlags usageFlags = 0, const std::vector<uint32_t>& queueFamilyIndexList = {});
 
         // Destructor.
         ~StorageBuffer();
@@ -34,6 +37,38 @@ class StorageBuffer
         // off Offset to write data in bytes.
         void Write(VkCommandBuffer commandBuffer, void* data, unsigned int byteSize, unsigned int offset);
 
+        // Write to storage buffer with data recorded in command buffer, so writes of frames in flight do not share staging memory.
+        // commandBuffer Command buffer to make write.
+        // data Data to write.
+        // byteSize Size of data in bytes, multiple of 4 and at most 65536.
+        // offset Offset to write data in bytes, multiple of 4.
+        void Update(VkCommandBuffer commandBuffer, const void* data, unsigned int byteSize, unsigned int offset);
+
+        // Copy storage buffer to staging buffer, to be read once command buffer completes.
+        // commandBuffer Command buffer to make copy, of queue family owning buffer.
+        void Download(VkCommandBuffer commandBuffer);
+
+        // Read staging buffer written by a completed download.
+        // data Data to read into.
+        // byteSize Size of data in bytes.
+        // offset Offset to read data in bytes.
+        void Read(void* data, unsigned int byteSize, unsigned int offset);
+
+        // Release exclusive buffer to other queue family. Does nothing if families are the same.
+        // commandBuffer Command buffer of source queue family.
+        // srcFamilyIndex Queue family owning buffer.
+        // dstFamilyIndex Queue family to acquire buffer.
+        // srcStageFlags Stages of source queue accessing buffer.
+        // srcAccessFlags Writes of source queue to make available.
+        void ReleaseOwnership(VkCommandBuffer commandBuffer, uint32_t srcFamilyIndex, uint32_t dstFamilyIndex, VkPipelineStageFlags srcStageFlags, VkAccessFlags srcAccessFlags);
+
+        // Acquire buffer released to queue family. Does nothing if buffer is not released to it.
+        // commandBuffer Command buffer of destination queue family, submitted after release.
+        // dstFamilyIndex Queue family to acquire buffer.
+        // dstStageFlags Stages of destination queue accessing buffer.
+        // dstAccessFlags Accesses of destination queue.
+        void AcquireOwnership(VkCommandBuffer commandBuffer, uint32_t dstFamilyIndex, VkPipelineStageFlags dstStageFlags, VkAccessFlags dstAccessFlags);
+
         // Storage buffer.
         VkBuffer mBuffer;
         VkDeviceMemory mBufferMemory;
@@ -51,4 +86,8 @@ class StorageBuffer
 
         // Storage buffer size in bytes.
         unsigned int mSize;
+
+        // Queue families of release not yet acquired, VK_QUEUE_FAMILY_IGNORED if none.
+        uint32_t mReleaseSrcFamilyIndex;
+        uint32_t mReleaseDstFamilyIndex;
 };
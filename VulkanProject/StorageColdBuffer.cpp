@@ -0,0 +1,101 @@
+#include "StorageColdBuffer.hpp"
+#include "StorageSwapBuffer.hpp"
+
+#include <assert.h>
+
+StorageColdBuffer::StorageColdBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride, StorageSwapBuffer* swapBuffer, const std::vector<uint32_t>& queueFamilyIndexList)
+{
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mTotalSize = totalSize;
+    mStride = stride;
+    mQueueFamilyIndexList = queueFamilyIndexList;
+    mSwapBuffer = swapBuffer;
+
+    // Every state starts with the same stream.
+    mBufferList.push_back(new StorageBuffer(mDevice, mPhysicalDevice, mTotalSize, mStride, 0, mQueueFamilyIndexList));
+    for (unsigned int i = 0; i < mSwapBuffer->GetBufferCount(); ++i)
+        mStateMap[mSwapBuffer->GetBuffer(i)] = mBufferList[0];
+}
+
+StorageColdBuffer::~StorageColdBuffer()
+{
+    for (StorageBuffer* buffer : mBufferList)
+        delete buffer;
+}
+
+StorageBuffer* StorageColdBuffer::GetOutputBuffer()
+{
+    return GetStateBuffer(mSwapBuffer->GetOutputBuffer());
+}
+
+StorageBuffer* StorageColdBuffer::GetInputBuffer()
+{
+    return GetStateBuffer(mSwapBuffer->GetInputBuffer());
+}
+
+unsigned int StorageColdBuffer::GetBufferCount()
+{
+    return (unsigned int)mBufferList.size();
+}
+
+StorageBuffer* StorageColdBuffer::GetBuffer(unsigned int index)
+{
+    assert(index < mBufferList.size());
+
+    return mBufferList[index];
+}
+
+void StorageColdBuffer::Share()
+{
+    GetStateBuffer(mSwapBuffer->GetOutputBuffer()) = GetStateBuffer(mSwapBuffer->GetInputBuffer());
+}
+
+void StorageColdBuffer::Write()
+{
+    StorageBuffer* state = mSwapBuffer->GetOutputBuffer();
+    if (state == mSwapBuffer->GetInputBuffer())
+        return;
+
+    StorageBuffer*& buffer = GetStateBuffer(state);
+    if (!IsReferenced(buffer, state))
+        return;
+
+    for (StorageBuffer* freeBuffer : mBufferList)
+    {
+        if (!IsReferenced(freeBuffer, state))
+        {
+            buffer = freeBuffer;
+            return;
+        }
+    }
+    buffer = new StorageBuffer(mDevice, mPhysicalDevice, mTotalSize, mStride, 0, mQueueFamilyIndexList);
+    mBufferList.push_back(buffer);
+}
+
+void StorageColdBuffer::GetState(std::vector<VkBuffer>& bufferList)
+{
+    for (auto& state : mStateMap)
+    {
+        bufferList.push_back(state.first->mBuffer);
+        bufferList.push_back(state.second->mBuffer);
+    }
+}
+
+StorageBuffer*& StorageColdBuffer::GetStateBuffer(StorageBuffer* state)
+{
+    auto it = mStateMap.find(state);
+    if (it == mStateMap.end())
+        it = mStateMap.insert(std::make_pair(state, mBufferList[0])).first;
+    return it->second;
+}
+
+bool StorageColdBuffer::IsReferenced(StorageBuffer* buffer, StorageBuffer* exceptState)
+{
+    for (auto& state : mStateMap)
+    {
+        if (state.first != exceptState && state.second == buffer)
+            return true;
+    }
+    return false;
+}
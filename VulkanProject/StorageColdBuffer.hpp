@@ -0,0 +1,74 @@
+#pragma once
+
+#include "StorageBuffer.hpp"
+
+#include <map>
+#include <vector>
+
+class StorageSwapBuffer;
+
+// Attribute stream following the states of a swap buffer, but written by fewer updates.
+// Output shares the buffer of input until an update writes it, so updates that do not write the stream do not copy it.
+class StorageColdBuffer
+{
+    public:
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // totalSize Total size in bytes.
+        // stride Stride of each element in bytes.
+        // swapBuffer Swap buffer whose input and output states are followed, must outlive cold buffer.
+        // queueFamilyIndexList Queue families sharing buffers concurrently, empty for exclusive ownership. DEFAULT [{}]
+        StorageColdBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride, StorageSwapBuffer* swapBuffer, const std::vector<uint32_t>& queueFamilyIndexList = {});
+
+        // Destructor.
+        ~StorageColdBuffer();
+
+        // Get storage buffer of output of swap buffer.
+        // Returns output storage buffer, the input one unless written.
+        StorageBuffer* GetOutputBuffer();
+
+        // Get storage buffer of input of swap buffer.
+        // Returns input storage buffer.
+        StorageBuffer* GetInputBuffer();
+
+        // Get number of storage buffers, grows when written.
+        // Returns buffer count.
+        unsigned int GetBufferCount();
+
+        // Get storage buffer, e.g. to initialise every buffer.
+        // index Index of buffer, less than buffer count.
+        // Returns storage buffer.
+        StorageBuffer* GetBuffer(unsigned int index);
+
+        // Makes output share buffer of input, before an update that does not write the stream.
+        void Share();
+
+        // Gives output a buffer no other state of swap buffer refers to, before an update writes the stream.
+        // Readers of other states, e.g. render of input, are not raced. Buffer is created when none is free.
+        // Output keeps its buffer if not shared. With a single swap buffer the stream is written in place.
+        void Write();
+
+        // Append buffer of each state of swap buffer. Equal lists mean output and input from here use the same buffers.
+        // bufferList List to append to.
+        void GetState(std::vector<VkBuffer>& bufferList);
+
+    private:
+        // Get buffer of state, first buffer for states not yet seen.
+        StorageBuffer*& GetStateBuffer(StorageBuffer* state);
+
+        // Check if any state of swap buffer other than exceptState refers to buffer.
+        bool IsReferenced(StorageBuffer* buffer, StorageBuffer* exceptState);
+
+        VkDevice mDevice;
+        VkPhysicalDevice mPhysicalDevice;
+        unsigned int mTotalSize;
+        unsigned int mStride;
+        std::vector<uint32_t> mQueueFamilyIndexList;
+
+        StorageSwapBuffer* mSwapBuffer;
+        // Storage buffers.
+        std::vector<StorageBuffer*> mBufferList;
+        // Buffer of each storage buffer of swap buffer, including scratch buffers of substeps.
+        std::map<StorageBuffer*, StorageBuffer*> mStateMap;
+};
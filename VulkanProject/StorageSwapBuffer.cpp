@@ -1,15 +1,26 @@
 #include "StorageSwapBuffer.hpp"
 
-StorageSwapBuffer::StorageSwapBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride)
+#include <assert.h>
+#include <utility>
+
+StorageSwapBuffer::StorageSwapBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride, VkBufferUsageFlags usageFlags, unsigned int bufferCount)
 {
+    assert(bufferCount > 0 && bufferCount <= mMaxBufferCount);
+    mDevice = device;
+    mPhysicalDevice = physicalDevice;
+    mTotalSize = totalSize;
+    mStride = stride;
+    mUsageFlags = usageFlags;
+    mBufferCount = bufferCount;
     for (unsigned int i = 0; i < mBufferCount; ++i)
-        mBuffers[i] = new StorageBuffer(device, physicalDevice, totalSize, stride);
+        mBuffers[i] = new StorageBuffer(device, physicalDevice, totalSize, stride, usageFlags);
 }
 
 StorageSwapBuffer::~StorageSwapBuffer()
 {
     for (unsigned int i = 0; i < mBufferCount; ++i)
         delete mBuffers[i];
+    delete mScratchBuffer;
 }
 
 StorageBuffer* StorageSwapBuffer::GetOutputBuffer()
@@ -19,10 +30,66 @@ StorageBuffer* StorageSwapBuffer::GetOutputBuffer()
 
 StorageBuffer* StorageSwapBuffer::GetInputBuffer()
 {
-    return mBuffers[(mBufferIndex + 1) % mBufferCount];
+    // Output of previous swap.
+    return mBuffers[(mBufferIndex + mBufferCount - 1) % mBufferCount];
+}
+
+unsigned int StorageSwapBuffer::GetBufferCount()
+{
+    return mBufferCount;
+}
+
+StorageBuffer* StorageSwapBuffer::GetBuffer(unsigned int index)
+{
+    assert(index < mBufferCount);
+
+    return mBuffers[index];
 }
 
 void StorageSwapBuffer::Swap()
 {
     mBufferIndex = (mBufferIndex + 1) % mBufferCount;
 }
+
+void StorageSwapBuffer::Substep()
+{
+    if (mBufferCount == 1)
+        return;
+
+    StorageBuffer*& input = mBuffers[(mBufferIndex + mBufferCount - 1) % mBufferCount];
+    StorageBuffer*& output = mBuffers[mBufferIndex];
+    if (mFrameInputBuffer == nullptr)
+    {
+        // Input of frame is parked, scratch becomes output.
+        if (mScratchBuffer == nullptr)
+            mScratchBuffer = new StorageBuffer(mDevice, mPhysicalDevice, mTotalSize, mStride, mUsageFlags);
+        mFrameInputBuffer = input;
+        input = output;
+        output = mScratchBuffer;
+        mScratchBuffer = nullptr;
+    }
+    else
+    {
+        std::swap(input, output);
+    }
+}
+
+void StorageSwapBuffer::EndSubsteps()
+{
+    if (mFrameInputBuffer == nullptr)
+        return;
+
+    StorageBuffer*& input = mBuffers[(mBufferIndex + mBufferCount - 1) % mBufferCount];
+    mScratchBuffer = input;
+    input = mFrameInputBuffer;
+    mFrameInputBuffer = nullptr;
+}
+
+void StorageSwapBuffer::GetState(std::vector<VkBuffer>& bufferList)
+{
+    bufferList.push_back(GetOutputBuffer()->mBuffer);
+    bufferList.push_back(GetInputBuffer()->mBuffer);
+    for (unsigned int i = 0; i < mBufferCount; ++i)
+        bufferList.push_back(mBuffers[i]->mBuffer);
+    bufferList.push_back(mScratchBuffer != nullptr ? mScratchBuffer->mBuffer : VK_NULL_HANDLE);
+}
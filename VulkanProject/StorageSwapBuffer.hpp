@@ -10,7 +10,10 @@ class StorageSwapBuffer
         // physicalDevice Vulkan physical device.
         // totalSize Total size in bytes.
         // stride Stride of each element in bytes.
-        StorageSwapBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride);
+        // usageFlags Additional buffer usage, e.g. indirect. DEFAULT [0]
+        // bufferCount Number of storage buffers, 1 makes input and output the same buffer for in-place updates.
+        // 3 keeps the buffer read before input unwritten, so it can be drawn while update runs. DEFAULT [2]
+        StorageSwapBuffer(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int totalSize, unsigned int stride, VkBufferUsageFlags usageFlags = 0, unsigned int bufferCount = 2);
 
         // Destructor.
         ~StorageSwapBuffer();
@@ -23,14 +26,47 @@ class StorageSwapBuffer
         // Returns input storage buffer.
         StorageBuffer* GetInputBuffer();
 
-        // Swaps read and write storage buffer. 
+        // Get number of storage buffers.
+        // Returns buffer count.
+        unsigned int GetBufferCount();
+
+        // Get storage buffer, e.g. to initialise every buffer.
+        // index Index of buffer, less than buffer count.
+        // Returns storage buffer.
+        StorageBuffer* GetBuffer(unsigned int index);
+
+        // Swaps read and write storage buffer, output becomes input. Rotates through buffers with more than two.
         void Swap();
 
+        // Makes output of substep input of next substep. Input of first substep is kept unwritten for readers of this frame.
+        // Third buffer is created on first use. Does nothing with a single buffer.
+        void Substep();
+
+        // Restores input of first substep as input, with output of last substep as output.
+        void EndSubsteps();
+
+        // Append output, input, every buffer and scratch buffer of substeps, VK_NULL_HANDLE when not created.
+        // Equal lists mean swaps and substeps from here use the same buffers.
+        // bufferList List to append to.
+        void GetState(std::vector<VkBuffer>& bufferList);
+
     private:
+        VkDevice mDevice;
+        VkPhysicalDevice mPhysicalDevice;
+        unsigned int mTotalSize;
+        unsigned int mStride;
+        VkBufferUsageFlags mUsageFlags;
+
+        // Max storage buffer count.
+        static const unsigned int mMaxBufferCount = 3;
         // Storage buffer count.
-        static const unsigned int mBufferCount = 2;
+        unsigned int mBufferCount;
         // Storeage buffers.
-        StorageBuffer* mBuffers[mBufferCount];
+        StorageBuffer* mBuffers[mMaxBufferCount];
         // Buffer index.
         unsigned int mBufferIndex = 0;
+        // Written by substeps in turn with output.
+        StorageBuffer* mScratchBuffer = nullptr;
+        // Input of first substep while substepping.
+        StorageBuffer* mFrameInputBuffer = nullptr;
 };
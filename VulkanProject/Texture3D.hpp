@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// 3D texture sampled by compute shaders with trilinear filtering.
+class Texture3D
+{
+    public:
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // commandBuffer Command buffer to record upload, texture is ready for compute shaders after it.
+        // extent Number of texels along each axis.
+        // data Texels, x fastest.
+        // byteSize Size of data in bytes.
+        // format Texel format, must support linear filtering. DEFAULT [VK_FORMAT_R16G16B16A16_SFLOAT]
+        Texture3D(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, const glm::uvec3& extent, const void* data, std::size_t byteSize, VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT);
+
+        // Destructor.
+        ~Texture3D();
+
+        // Number of texels along each axis.
+        glm::uvec3 mExtent;
+
+        // Texture.
+        VkImage mImage;
+        VkDeviceMemory mImageMemory;
+        VkImageView mImageView;
+        // Trilinear sampler clamped to edge.
+        VkSampler mSampler;
+
+    private:
+        VkDevice mDevice;
+        VkPhysicalDevice mPhysicalDevice;
+
+        // Staging buffer of upload, kept until upload has completed.
+        VkBuffer mStagingBuffer;
+        VkDeviceMemory mStagingBufferMemory;
+};
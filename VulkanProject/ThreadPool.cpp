@@ -0,0 +1,120 @@
+#include "ThreadPool.hpp"
+
+#include <assert.h>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : mTaskQueueList((std::max)(threadCount == 0 ? std::thread::hardware_concurrency() : threadCount, 1u))
+{
+    mThreadCount = (unsigned int)mTaskQueueList.size();
+    mPendingCount = 0;
+    mGeneration = 0;
+    mStop = false;
+    for (unsigned int i = 1; i < mThreadCount; ++i)
+        mThreadList.push_back(std::thread(&ThreadPool::WorkerMain, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWakeCondition.notify_all();
+    for (std::thread& thread : mThreadList)
+        thread.join();
+}
+
+void ThreadPool::ParallelFor(unsigned int count, unsigned int rangeSize, const std::function<void(unsigned int, unsigned int)>& function)
+{
+    assert(mPendingCount == 0);
+    if (count == 0)
+        return;
+    rangeSize = (std::max)(rangeSize, 1u);
+    unsigned int taskCount = (count + rangeSize - 1) / rangeSize;
+    if (mThreadCount == 1 || taskCount == 1)
+    {
+        for (unsigned int begin = 0; begin < count; begin += rangeSize)
+            function(begin, (std::min)(begin + rangeSize, count));
+        return;
+    }
+
+    // Contiguous ranges per queue, so each thread starts on its own part of the arrays.
+    mPendingCount = taskCount;
+    for (unsigned int i = 0; i < taskCount; ++i)
+    {
+        Task task;
+        task.begin = i * rangeSize;
+        task.end = (std::min)(task.begin + rangeSize, count);
+        task.function = &function;
+        TaskQueue& taskQueue = mTaskQueueList[(unsigned long long)i * mThreadCount / taskCount];
+        std::lock_guard<std::mutex> lock(taskQueue.mutex);
+        taskQueue.taskList.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mGeneration;
+    }
+    mWakeCondition.notify_all();
+
+    while (RunTask(0));
+
+    // Tasks stolen by workers may still run.
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mPendingCount == 0; });
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+    return mThreadCount;
+}
+
+void ThreadPool::WorkerMain(unsigned int queueIndex)
+{
+    unsigned int generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeCondition.wait(lock, [&] { return mStop || mGeneration != generation; });
+            if (mStop)
+                return;
+            generation = mGeneration;
+        }
+        while (RunTask(queueIndex));
+    }
+}
+
+bool ThreadPool::RunTask(unsigned int queueIndex)
+{
+    Task task;
+    bool found = false;
+    for (unsigned int i = 0; i < mThreadCount && !found; ++i)
+    {
+        TaskQueue& taskQueue = mTaskQueueList[(queueIndex + i) % mThreadCount];
+        std::lock_guard<std::mutex> lock(taskQueue.mutex);
+        if (taskQueue.taskList.empty())
+            continue;
+        // Own tasks in order, stolen tasks from the far end of victim's ranges.
+        if (i == 0)
+        {
+            task = taskQueue.taskList.front();
+            taskQueue.taskList.pop_front();
+        }
+        else
+        {
+            task = taskQueue.taskList.back();
+            taskQueue.taskList.pop_back();
+        }
+        found = true;
+    }
+    if (!found)
+        return false;
+
+    (*task.function)(task.begin, task.end);
+    if (--mPendingCount == 0)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDoneCondition.notify_all();
+    }
+    return true;
+}
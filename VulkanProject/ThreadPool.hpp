@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads running parallel loops. Each thread owns a deque of tasks, pops its own tasks from the front and
+// steals from the back of other deques when empty, so uneven tasks balance without one shared queue.
+class ThreadPool
+{
+    public:
+        // Constructor.
+        // threadCount Number of threads including caller of ParallelFor. DEFAULT [0, hardware concurrency]
+        ThreadPool(unsigned int threadCount = 0);
+
+        // Destructor.
+        ~ThreadPool();
+
+        // Run function for every range of indices, on workers and calling thread. Returns when every range has run.
+        // Not reentrant, function must not call ParallelFor.
+        // count Number of indices.
+        // rangeSize Indices per task, ranges start at multiples of it.
+        // function Called with begin and end of range.
+        void ParallelFor(unsigned int count, unsigned int rangeSize, const std::function<void(unsigned int, unsigned int)>& function);
+
+        // Get number of threads.
+        // Returns thread count including caller.
+        unsigned int GetThreadCount() const;
+
+    private:
+        struct Task
+        {
+            unsigned int begin;
+            unsigned int end;
+            const std::function<void(unsigned int, unsigned int)>* function;
+        };
+        struct TaskQueue
+        {
+            std::mutex mutex;
+            std::deque<Task> taskList;
+        };
+
+        // Waits for loops and runs tasks until every queue is empty.
+        void WorkerMain(unsigned int queueIndex);
+        // Runs own front task or steals back task of another queue.
+        // Returns false if every queue is empty.
+        bool RunTask(unsigned int queueIndex);
+
+        unsigned int mThreadCount;
+        // Queue of each thread, caller of ParallelFor owns first.
+        std::vector<TaskQueue> mTaskQueueList;
+        std::vector<std::thread> mThreadList;
+
+        // Tasks of loop not yet run.
+        std::atomic<unsigned int> mPendingCount;
+        // Incremented by each loop to wake workers.
+        unsigned int mGeneration;
+        bool mStop;
+        std::mutex mMutex;
+        std::condition_variable mWakeCondition;
+        std::condition_variable mDoneCondition;
+};
@@ -0,0 +1,61 @@
+#include "UniformRing.hpp"
+#include "vkTools.hpp"
+
+#include <assert.h>
+#include <cstring>
+#include <algorithm>
+
+UniformRing::UniformRing(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int frameSize, unsigned int frameCount)
+{
+    assert(frameCount > 0);
+    mDevice = device;
+    mFrameCount = frameCount;
+
+    // Regions and blocks start at offsets aligned for both uniform and storage bindings.
+    VkPhysicalDeviceProperties physicalDeviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+    mMinOffsetAlignment = (uint32_t)(std::max)(physicalDeviceProperties.limits.minUniformBufferOffsetAlignment, physicalDeviceProperties.limits.minStorageBufferOffsetAlignment);
+    mFrameSize = (frameSize + mMinOffsetAlignment - 1) / mMinOffsetAlignment * mMinOffsetAlignment;
+
+    uint32_t minOffsetAligment;
+    vkTools::CreateBuffer(mDevice, physicalDevice, (std::size_t)mFrameSize * mFrameCount,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        mBuffer, mBufferMemory, minOffsetAligment
+        );
+
+    void* mappedMemory;
+    vkTools::VkErrorCheck(vkMapMemory(mDevice, mBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedMemory));
+    mMappedMemory = static_cast<unsigned char*>(mappedMemory);
+
+    BeginFrame(0);
+}
+
+UniformRing::~UniformRing()
+{
+    vkUnmapMemory(mDevice, mBufferMemory);
+    vkFreeMemory(mDevice, mBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mBuffer, nullptr);
+}
+
+void UniformRing::BeginFrame(unsigned int frameIndex)
+{
+    mOffset = (frameIndex % mFrameCount) * mFrameSize;
+    mFrameEnd = mOffset + mFrameSize;
+}
+
+uint32_t UniformRing::Push(const void* data, unsigned int byteSize)
+{
+    uint32_t offset;
+    std::memcpy(Reserve(byteSize, offset), data, byteSize);
+    return offset;
+}
+
+void* UniformRing::Reserve(unsigned int byteSize, uint32_t& offset)
+{
+    assert(mOffset + byteSize <= mFrameEnd);
+
+    offset = mOffset;
+    mOffset = (mOffset + byteSize + mMinOffsetAlignment - 1) / mMinOffsetAlignment * mMinOffsetAlignment;
+
+    return mMappedMemory + offset;
+}
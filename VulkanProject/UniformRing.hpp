@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Host visible uniform buffer, persistently mapped and split in one region per frame in flight.
+// Blocks are read with dynamic uniform or storage offsets, as indirect arguments or as copy source, and not overwritten until their region is reused frameCount frames later.
+// Blocks pushed in the same order each frame have the same offsets in every frame of a region, so recorded command buffers stay valid.
+class UniformRing
+{
+    public:
+        // Constructor.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // frameSize Size of region of each frame in bytes.
+        // frameCount Number of frames in flight.
+        UniformRing(VkDevice device, VkPhysicalDevice physicalDevice, unsigned int frameSize, unsigned int frameCount);
+
+        // Destructor.
+        ~UniformRing();
+
+        // Begin pushing to region of frame. Frame frameCount frames ago must be complete.
+        // frameIndex Index of frame.
+        void BeginFrame(unsigned int frameIndex);
+
+        // Copy block to region of current frame.
+        // data Block to copy.
+        // byteSize Size of block in bytes.
+        // Returns dynamic offset of block in bytes.
+        uint32_t Push(const void* data, unsigned int byteSize);
+
+        // Reserve block in region of current frame, to be written in place.
+        // byteSize Size of block in bytes.
+        // offset Set to dynamic offset of block in bytes.
+        // Returns mapped memory of block.
+        void* Reserve(unsigned int byteSize, uint32_t& offset);
+
+        VkBuffer mBuffer;
+
+    private:
+        VkDevice mDevice;
+        VkDeviceMemory mBufferMemory;
+        // Mapped for the lifetime of ring.
+        unsigned char* mMappedMemory;
+
+        unsigned int mFrameSize;
+        unsigned int mFrameCount;
+        uint32_t mMinOffsetAlignment;
+        // Next offset and end of region of current frame.
+        unsigned int mOffset;
+        unsigned int mFrameEnd;
+};
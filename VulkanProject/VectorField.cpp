@@ -0,0 +1,128 @@
+#include "VectorField.hpp"
+
+#include <glm/gtc/packing.hpp>
+#include <cstdint>
+
+// Integer hash, matches Particles_Update_CS.
+static uint32_t HashNoise(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Pseudo random gradient of lattice point, components in [-1, 1].
+static glm::vec3 NoiseGradient(const glm::ivec3& lattice, uint32_t seed)
+{
+    uint32_t hash = HashNoise((uint32_t)lattice.x ^ HashNoise((uint32_t)lattice.y ^ HashNoise((uint32_t)lattice.z ^ seed)));
+    return glm::vec3((float)(hash & 1023u), (float)((hash >> 10) & 1023u), (float)((hash >> 20) & 1023u)) / 511.5f - 1.f;
+}
+
+// Gradient noise, zero at lattice points.
+static float GradientNoise(const glm::vec3& position, uint32_t seed)
+{
+    glm::vec3 cell = glm::floor(position);
+    glm::vec3 f = position - cell;
+    glm::vec3 u = f * f * f * (f * (f * 6.f - 15.f) + 10.f);
+    glm::ivec3 lattice(cell);
+
+    float corner[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::ivec3 offset(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+        corner[i] = glm::dot(NoiseGradient(lattice + offset, seed), f - glm::vec3(offset));
+    }
+    float x00 = glm::mix(corner[0], corner[1], u.x);
+    float x10 = glm::mix(corner[2], corner[3], u.x);
+    float x01 = glm::mix(corner[4], corner[5], u.x);
+    float x11 = glm::mix(corner[6], corner[7], u.x);
+    return glm::mix(glm::mix(x00, x10, u.y), glm::mix(x01, x11, u.y), u.z);
+}
+
+glm::vec3 VectorField::CurlNoise(const glm::vec3& position, unsigned int seed)
+{
+    // Central differences of three potential components.
+    const float epsilon = 1e-2f;
+    glm::vec3 dx(epsilon, 0.f, 0.f);
+    glm::vec3 dy(0.f, epsilon, 0.f);
+    glm::vec3 dz(0.f, 0.f, epsilon);
+    uint32_t seedX = seed * 3u;
+    uint32_t seedY = seed * 3u + 1u;
+    uint32_t seedZ = seed * 3u + 2u;
+    float dZdY = GradientNoise(position + dy, seedZ) - GradientNoise(position - dy, seedZ);
+    float dYdZ = GradientNoise(position + dz, seedY) - GradientNoise(position - dz, seedY);
+    float dXdZ = GradientNoise(position + dz, seedX) - GradientNoise(position - dz, seedX);
+    float dZdX = GradientNoise(position + dx, seedZ) - GradientNoise(position - dx, seedZ);
+    float dYdX = GradientNoise(position + dx, seedY) - GradientNoise(position - dx, seedY);
+    float dXdY = GradientNoise(position + dy, seedX) - GradientNoise(position - dy, seedX);
+    return glm::vec3(dZdY - dYdZ, dXdZ - dZdX, dYdX - dXdY) / (2.f * epsilon);
+}
+
+glm::vec3 VectorField::Sample(const glm::vec3& uvw) const
+{
+    // Texel centers at (i + 0.5) / resolution.
+    glm::vec3 texel = uvw * glm::vec3(mResolution) - 0.5f;
+    glm::vec3 cell = glm::floor(texel);
+    glm::vec3 f = texel - cell;
+    glm::ivec3 lattice(cell);
+    glm::ivec3 maxLattice = glm::ivec3(mResolution) - 1;
+
+    glm::vec3 corner[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::ivec3 voxel = glm::clamp(lattice + glm::ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1), glm::ivec3(0), maxLattice);
+        corner[i] = glm::vec3(mVoxelList[((std::size_t)voxel.z * mResolution.y + voxel.y) * mResolution.x + voxel.x]);
+    }
+    glm::vec3 x00 = glm::mix(corner[0], corner[1], f.x);
+    glm::vec3 x10 = glm::mix(corner[2], corner[3], f.x);
+    glm::vec3 x01 = glm::mix(corner[4], corner[5], f.x);
+    glm::vec3 x11 = glm::mix(corner[6], corner[7], f.x);
+    return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+}
+
+VectorField::VectorField(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, const std::vector<glm::vec4>& voxelList, const glm::uvec3& resolution)
+{
+    mNoiseFrequency = 0.f;
+    mNoiseSeed = 0;
+    Upload(device, physicalDevice, commandBuffer, voxelList, resolution);
+}
+
+VectorField::VectorField(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, unsigned int resolution, float frequency, unsigned int seed)
+{
+    mNoiseFrequency = frequency;
+    mNoiseSeed = seed;
+
+    // Sampled at voxel centers, so trilinear filtering reproduces noise between them.
+    std::vector<glm::vec4> voxelList;
+    voxelList.reserve((std::size_t)resolution * resolution * resolution);
+    for (unsigned int z = 0; z < resolution; ++z)
+        for (unsigned int y = 0; y < resolution; ++y)
+            for (unsigned int x = 0; x < resolution; ++x)
+            {
+                glm::vec3 position = (glm::vec3(x, y, z) + 0.5f) / (float)resolution;
+                voxelList.push_back(glm::vec4(CurlNoise(position * frequency, seed), 0.f));
+            }
+    Upload(device, physicalDevice, commandBuffer, voxelList, glm::uvec3(resolution));
+}
+
+VectorField::~VectorField()
+{
+    delete mTexture;
+}
+
+void VectorField::Upload(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, const std::vector<glm::vec4>& voxelList, const glm::uvec3& resolution)
+{
+    std::vector<uint16_t> halfList(voxelList.size() * 4);
+    mVoxelList.resize(voxelList.size());
+    mResolution = resolution;
+    for (std::size_t i = 0; i < voxelList.size(); ++i)
+        for (int c = 0; c < 4; ++c)
+        {
+            halfList[4 * i + c] = glm::packHalf1x16(voxelList[i][c]);
+            mVoxelList[i][c] = glm::unpackHalf1x16(halfList[4 * i + c]);
+        }
+    mTexture = new Texture3D(device, physicalDevice, commandBuffer, resolution, halfList.data(), halfList.size() * sizeof(uint16_t));
+}
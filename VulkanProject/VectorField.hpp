@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Texture3D.hpp"
+
+// Vector field sampled from a 3D texture, e.g. forces or velocities. Covers unit cube [0, 1] of field space.
+class VectorField
+{
+    public:
+        // Constructor of imported grid, e.g. velocities exported from a fluid solver.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // commandBuffer Command buffer to upload texture.
+        // voxelList Vector of each voxel in field space, x fastest. w is unused.
+        // resolution Number of voxels along each axis.
+        VectorField(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, const std::vector<glm::vec4>& voxelList, const glm::uvec3& resolution);
+
+        // Constructor of curl noise, divergence free so particles swirl without clumping.
+        // device Vulkan device.
+        // physicalDevice Vulkan physical device.
+        // commandBuffer Command buffer to upload texture.
+        // resolution Number of voxels along each axis.
+        // frequency Noise cells across field.
+        // seed Noise seed. DEFAULT [0]
+        VectorField(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, unsigned int resolution, float frequency, unsigned int seed = 0);
+
+        // Destructor.
+        ~VectorField();
+
+        // Evaluate curl noise, same as analytic noise of Particles_Update_CS.
+        // position Position in noise space, field space times frequency.
+        // seed Noise seed.
+        // Returns curl of noise potential.
+        static glm::vec3 CurlNoise(const glm::vec3& position, unsigned int seed);
+
+        // Sample vectors on CPU, trilinear between voxel centers and clamped to edge as texture sampler.
+        // uvw Position in field space.
+        // Returns vector in field space.
+        glm::vec3 Sample(const glm::vec3& uvw) const;
+
+        // Noise cells across field, zero for imported grid.
+        float mNoiseFrequency;
+        unsigned int mNoiseSeed;
+
+        // Half float texture, xyz vector.
+        Texture3D* mTexture;
+
+        // Voxels of texture on host, rounded to half float, x fastest.
+        std::vector<glm::vec4> mVoxelList;
+        glm::uvec3 mResolution;
+
+    private:
+        // Creates texture of vectors.
+        void Upload(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandBuffer commandBuffer, const std::vector<glm::vec4>& voxelList, const glm::uvec3& resolution);
+};
@@ -7,11 +7,14 @@
 #include <sstream>
 #include <map>
 
-VkRenderer::VkRenderer(unsigned int winWidth, unsigned int winHeight)
+VkRenderer::VkRenderer(unsigned int winWidth, unsigned int winHeight, unsigned int frameCount)
 {
+    assert(frameCount > 0);
     mWinWidth = winWidth;
     mWinHeight = winHeight;
     mClose = false;
+    mFrameCount = frameCount;
+    mPresentIndex = 0;
 
     // Window.
     InitialiseGLFW();
@@ -41,36 +44,44 @@ void VkRenderer::Close()
     mClose = true;
 }
 
-void VkRenderer::Present(FrameBuffer* fb)
+void VkRenderer::Present(FrameBuffer* fb, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore)
 {
-    vkTools::VkErrorCheck(vkAcquireNextImageKHR(mDevice, mSwapchainKHR, (std::numeric_limits<uint64_t>::max)(), mPresentCompleteSemaphore, VK_NULL_HANDLE, &mActiveSwapchainImageIndex));
+    // Copy of frame count presents ago waits acquire semaphore, and its command buffer is reused.
+    unsigned int frameSlot = mPresentIndex++ % mFrameCount;
+    VkCommandBuffer presentCommandBuffer = mPresentCommandBufferList[frameSlot];
+    VkSemaphore presentCompleteSemaphore = mPresentCompleteSemaphoreList[frameSlot];
+    VkSemaphore copyCompleteSemaphore = mCopyCompleteSemaphoreList[frameSlot];
+    vkTools::WaitFence(mDevice, mPresentFenceList[frameSlot]);
+
+    vkTools::VkErrorCheck(vkAcquireNextImageKHR(mDevice, mSwapchainKHR, (std::numeric_limits<uint64_t>::max)(), presentCompleteSemaphore, VK_NULL_HANDLE, &mActiveSwapchainImageIndex));
     assert(mActiveSwapchainImageIndex <= mSwapchainFrameBufferList.size());
     FrameBuffer* backBuffer = mSwapchainFrameBufferList[mActiveSwapchainImageIndex];
 
     // Reset present command buffer.
-    vkTools::ResetCommandBuffer(mPresentCommandBuffer);
-    vkTools::BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, mPresentCommandBuffer);
+    vkTools::ResetCommandBuffer(presentCommandBuffer);
+    vkTools::BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, presentCommandBuffer);
 
     // Copy frame buffer to back buffer.
-    backBuffer->TransitionImageLayout(mPresentCommandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    backBuffer->Copy(mPresentCommandBuffer, fb);
-    backBuffer->TransitionImageLayout(mPresentCommandBuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-
-    // Execute present command buffer.
-    vkTools::EndCommandBuffer(mPresentCommandBuffer);
-    vkTools::QueueSubmit(mPresentQueue, { mPresentCommandBuffer }, { mCopyCompleteSemaphore });
-
-    // Wait for frame to complete.
-    vkTools::QueueSubmit(mPresentQueue, {}, {}, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, { mCopyCompleteSemaphore });
-
-    vkTools::WaitQueue(mPresentQueue);
-
-    // Present to screen.
+    backBuffer->TransitionImageLayout(presentCommandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    backBuffer->Copy(presentCommandBuffer, fb);
+    backBuffer->TransitionImageLayout(presentCommandBuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    // Execute present command buffer when back buffer is acquired and frame buffer is rendered.
+    vkTools::EndCommandBuffer(presentCommandBuffer);
+    std::vector<VkSemaphore> copyWaitSemaphoreList = { presentCompleteSemaphore };
+    if (waitSemaphore != VK_NULL_HANDLE)
+        copyWaitSemaphoreList.push_back(waitSemaphore);
+    std::vector<VkSemaphore> copySignalSemaphoreList = { copyCompleteSemaphore };
+    if (signalSemaphore != VK_NULL_HANDLE)
+        copySignalSemaphoreList.push_back(signalSemaphore);
+    vkTools::QueueSubmit(mPresentQueue, { presentCommandBuffer }, copySignalSemaphoreList, VK_PIPELINE_STAGE_TRANSFER_BIT, copyWaitSemaphoreList, mPresentFenceList[frameSlot]);
+
+    // Present to screen when copy is complete.
     VkPresentInfoKHR presentInfoKHR;
     presentInfoKHR.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfoKHR.pNext = NULL;
     presentInfoKHR.pResults = NULL;
-    std::vector<VkSemaphore> waitSemaphoresList = { mPresentCompleteSemaphore };
+    std::vector<VkSemaphore> waitSemaphoresList = { copyCompleteSemaphore };
     presentInfoKHR.pWaitSemaphores = waitSemaphoresList.data();
     presentInfoKHR.waitSemaphoreCount = waitSemaphoresList.size();
     VkSwapchainKHR swapchains[] = { mSwapchainKHR };
@@ -79,8 +90,6 @@ void VkRenderer::Present(FrameBuffer* fb)
     presentInfoKHR.pImageIndices = &mActiveSwapchainImageIndex;
 
     vkQueuePresentKHR(mPresentQueue, &presentInfoKHR);
-
-    vkTools::WaitQueue(mPresentQueue);
 }
 
 void VkRenderer::InitialiseGLFW()
@@ -474,7 +483,9 @@ void VkRenderer::InitialiseCommandPool()
 
     commandPoolCreateInfo.queueFamilyIndex = mGraphicsFamilyIndex;
     vkTools::VkErrorCheck(vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &mGraphicsCommandPool));
-    vkTools::CreateCommandBuffer(mDevice, mGraphicsCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, mPresentCommandBuffer);
+    mPresentCommandBufferList.resize(mFrameCount);
+    for (unsigned int i = 0; i < mFrameCount; ++i)
+        vkTools::CreateCommandBuffer(mDevice, mGraphicsCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, mPresentCommandBufferList[i]);
 
     commandPoolCreateInfo.queueFamilyIndex = mComputeFamilyIndex;
     vkTools::VkErrorCheck(vkCreateCommandPool(mDevice, &commandPoolCreateInfo, nullptr, &mComputeCommandPool));
@@ -485,7 +496,7 @@ void VkRenderer::InitialiseCommandPool()
 
 void VkRenderer::DeInitialiseCommandPool()
 {
-    vkFreeCommandBuffers(mDevice, mGraphicsCommandPool, 1, &mPresentCommandBuffer);
+    vkFreeCommandBuffers(mDevice, mGraphicsCommandPool, mPresentCommandBufferList.size(), mPresentCommandBufferList.data());
     vkDestroyCommandPool(mDevice, mGraphicsCommandPool, nullptr);
     vkDestroyCommandPool(mDevice, mComputeCommandPool, nullptr);
     vkDestroyCommandPool(mDevice, mTransferCommandPool, nullptr);
@@ -493,14 +504,25 @@ void VkRenderer::DeInitialiseCommandPool()
 
 void VkRenderer::InitialiseSemaphores()
 {
-    vkTools::CreateVkSemaphore(mDevice, mPresentCompleteSemaphore);
-    vkTools::CreateVkSemaphore(mDevice, mCopyCompleteSemaphore);
+    mPresentCompleteSemaphoreList.resize(mFrameCount);
+    mCopyCompleteSemaphoreList.resize(mFrameCount);
+    mPresentFenceList.resize(mFrameCount);
+    for (unsigned int i = 0; i < mFrameCount; ++i)
+    {
+        vkTools::CreateVkSemaphore(mDevice, mPresentCompleteSemaphoreList[i]);
+        vkTools::CreateVkSemaphore(mDevice, mCopyCompleteSemaphoreList[i]);
+        vkTools::CreateFence(mDevice, mPresentFenceList[i], true);
+    }
 }
 
 void VkRenderer::DeInitialiseSemaphores()
 {
-    vkDestroySemaphore(mDevice, mPresentCompleteSemaphore, nullptr);
-    vkDestroySemaphore(mDevice, mCopyCompleteSemaphore, nullptr);
+    for (unsigned int i = 0; i < mFrameCount; ++i)
+    {
+        vkDestroySemaphore(mDevice, mPresentCompleteSemaphoreList[i], nullptr);
+        vkDestroySemaphore(mDevice, mCopyCompleteSemaphoreList[i], nullptr);
+        vkDestroyFence(mDevice, mPresentFenceList[i], nullptr);
+    }
 }
 
 void VkRenderer::InitialiseSwapchanFrameBuffers()
@@ -19,7 +19,8 @@ class VkRenderer
         // Constructor.
         // winWidth Window width in pixels.
         // winHeight Window height in pixels.
-        VkRenderer(unsigned int winWidth = 640, unsigned int winHeight = 640);
+        // frameCount Number of presents in flight, each with own command buffer, semaphores and fence. DEFAULT [1]
+        VkRenderer(unsigned int winWidth = 640, unsigned int winHeight = 640, unsigned int frameCount = 1);
 
         // Destructor.
         ~VkRenderer();
@@ -31,7 +32,10 @@ class VkRenderer
         void Close();
 
         // Present frame buffer to screen.
-        void Present(FrameBuffer* fb);
+        // fb Frame buffer to present.
+        // waitSemaphore Semaphore signaled when frame buffer is rendered, VK_NULL_HANDLE if rendering is complete. DEFAULT [VK_NULL_HANDLE]
+        // signalSemaphore Semaphore to signal when frame buffer is copied and may be rendered again. DEFAULT [VK_NULL_HANDLE]
+        void Present(FrameBuffer* fb, VkSemaphore waitSemaphore = VK_NULL_HANDLE, VkSemaphore signalSemaphore = VK_NULL_HANDLE);
 
         // GLFW window.
         GLFWwindow* mGLFWwindow;
@@ -46,7 +50,8 @@ class VkRenderer
         uint32_t mPresentFamilyIndex;
         VkQueue mPresentQueue;
         VkCommandPool mPresentCommandPool;
-        VkCommandBuffer mPresentCommandBuffer;
+        // Of each present in flight.
+        std::vector<VkCommandBuffer> mPresentCommandBufferList;
 
         uint32_t mGraphicsFamilyIndex;
         VkCommandPool mGraphicsCommandPool;
@@ -68,8 +73,11 @@ class VkRenderer
         VkSwapchainKHR mSwapchainKHR;
         std::vector<FrameBuffer*> mSwapchainFrameBufferList;
 
-        VkSemaphore mCopyCompleteSemaphore;
-        VkSemaphore mPresentCompleteSemaphore;
+        // Of each present in flight.
+        std::vector<VkSemaphore> mCopyCompleteSemaphoreList;
+        std::vector<VkSemaphore> mPresentCompleteSemaphoreList;
+        // Signaled when present command buffer is complete. Of each present in flight.
+        std::vector<VkFence> mPresentFenceList;
 
         VkRenderPass mRenderPass;
 
@@ -114,6 +122,8 @@ class VkRenderer
         unsigned int mWinWidth;
         unsigned int mWinHeight;
         bool mClose;
+        unsigned int mFrameCount;
+        unsigned int mPresentIndex;
         uint32_t mActiveSwapchainImageIndex;
         std::map<uint32_t, uint32_t> mFamilyQueueCountMap;
 };
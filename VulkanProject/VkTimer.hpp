@@ -106,6 +106,12 @@ class VkTimer {
             return mActive;
         }
 
+        // Whether timer is reset, i.e. has no timestamps to read.
+        bool IsReset()
+        {
+            return mReset;
+        }
+
         // Resert timer.
         void Reset(VkCommandBuffer commandBuffer)
         {
@@ -116,6 +122,25 @@ class VkTimer {
             vkCmdResetQueryPool(commandBuffer, mStopQuery, 0, 1);
         }
 
+        // Reset and start timer in one command buffer, for command buffers submitted more than once.
+        void ResetStart(VkCommandBuffer commandBuffer)
+        {
+            assert(!mActive);
+            mReset = true;
+
+            vkCmdResetQueryPool(commandBuffer, mStartQuery, 0, 1);
+            vkCmdResetQueryPool(commandBuffer, mStopQuery, 0, 1);
+            Start(commandBuffer);
+        }
+
+        // Mark timestamps as written again, by resubmitting command buffer recorded with ResetStart and Stop.
+        void Resubmit()
+        {
+            assert(!mActive);
+            mReset = false;
+            mAccurateTime = false;
+        }
+
     private:
         VkDevice mDevice;
         VkPhysicalDevice mPhysicalDevice;
@@ -1,6 +1,13 @@
 #include <crtdbg.h>
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "VkRenderer.hpp"
 #include "CPUTimer.hpp"
@@ -11,51 +18,383 @@
 #include "vkTools.hpp"
 #include "ParticleRenderSystem.hpp"
 #include "ParticleUpdateSystem.hpp"
+#include "ParticleUpdateSystemCPU.hpp"
+#include "ParticleStatistics.hpp"
 #include "Scene.hpp"
 #include "Profiler.hpp"
+#include "Benchmark.hpp"
+#include "GoldenState.hpp"
+#include "SignedDistanceField.hpp"
+#include "VectorField.hpp"
+#include "DescriptorSetCache.hpp"
 
 #define SKIP_TIME_NANO 5000000000
 
 #define PROFILE_FRAME_COUNT 1000
 
-int main()
+#define VERIFY_DT (1.f / 60.f)
+
+#define UNSTABLE_SPEED 1000.f
+
+int main(int argc, char* argv[])
 {
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 
+    // +++ COMMAND LINE +++ //
+    // -workgroupsize N Override compute work group size from device table.
+    // -grid X Y Number of particles along each axis of initial grid.
+    // -emit RATE Particles per second spawned by GPU emitter at origin.
+    // -layout aos|soa Memory layout of particle attributes.
+    // -benchmark FRAMES Measure frames after skip time, report and exit.
+    // -collision RADIUS Particle-particle collisions of particles with radius.
+    // -sort FRAMES Re-sort particles by Morton code every number of frames.
+    // -fluid Simulate particles as SPH fluid in box around grid.
+    // -gravity G TILE All-pairs gravity of unit mass grid particles, TILE bodies per shared memory tile (0 for work group size).
+    // -sdf RADIUS Collide particles of radius with skull and plate above emitter, baked to signed distance field cached in resources/assets.
+    // -barneshut G THETA Barnes-Hut gravity of unit mass grid particles with opening angle THETA.
+    // -forcefield STRENGTH sampled|analytic Curl noise and vortex force volumes, noise sampled from texture or evaluated per particle.
+    // -fixedstep STEP MAX Simulate by fixed time step, at most MAX substeps per frame.
+    // -integrator euler|semiimplicit|verlet|rk2 Time integrator of update.
+    // -inplace Update particles in place in one buffer, update waits for render of previous frame. Ignored with collisions.
+    // -doublebuffer Double buffer particles, update waits for render of previous frame. Triple buffered by default, so update overlaps render.
+    // -frames N Frames in flight, 2 or 3. CPU records next frame while GPU executes previous ones.
+    // -prerecord Record command buffers of each frame in flight once and resubmit them while commands are unchanged. Frames in flight match particle buffer count.
+    // -cpu THREADS Update particles on CPU with SIMD kernels on THREADS threads (0 for hardware concurrency), uploaded each frame. Ignores -fluid, -gravity, -barneshut, -sdf, -sort and -prerecord.
+    //              Synthetic load writes the color its loop converges to without iterating, so times are compared with GPU updates doing far more work.
+    // -quads Draw particles as instanced quads pulled by vertex shader, instead of points expanded by geometry shader. Benchmarks compare with the geometry shader, use -grid for 100k-10M particles.
+    // -cull Cull particles outside view frustum on GPU before draw, visible particles compacted into indirect draw arguments. Benchmarks compare with drawing every particle.
+    // -lod DIAMETER COVERAGE Draw particles projected smaller than DIAMETER pixels as single pixel points, discard those covering less than COVERAGE pixels. Implies -cull.
+    // -splat Splat points of -lod, or every particle without -lod, to one pixel each by compute with integer atomics, resolved into frame buffer over drawn quads. Implies -cull. Benchmarks compare with -cull.
+    // -tiled Blend quads by compute in screen tiles, each sorted back to front and written once per pixel, instead of raster. Implies -cull. Frames overflowing tile bins are drawn by raster while bins grow. F2 reports overdraw of tiles. Benchmarks compare with -cull.
+    // -statistics Reduce particles to bounds, kinetic energy and speeds on GPU each frame, read frames in flight later. Warns when simulation is unstable. Ignored with -inplace.
+    // -verify FRAMES SNAPSHOT Update FRAMES frames of 1/60 s, then compare particles with a CPU reference update and with SNAPSHOT file, written if missing. Exits with 1 on mismatch.
+    //                         Ignores -emit, as slots of spawned particles depend on order of GPU atomics, and what -cpu ignores except -fluid. Run on a software driver, e.g. lavapipe via VK_ICD_FILENAMES, for snapshots independent of GPU.
+    //                         -fluid is compared with the CPU fluid reference, which ignores -collision, -forcefield and -fixedstep.
+    unsigned int workGroupSize = 0;
+    int lenX = 1;
+    int lenY = 1;
+    float emitRate = 0.f;
+    Scene::ParticleLayout particleLayout = Scene::PARTICLE_LAYOUT_AOS;
+    unsigned int benchmarkFrameCount = 0;
+    float collisionRadius = 0.f;
+    unsigned int sortFrameInterval = 0;
+    bool fluid = false;
+    float gravitationalConstant = 0.f;
+    unsigned int gravityTileSize = 0;
+    float openingAngle = 0.f;
+    float distanceFieldRadius = 0.f;
+    float forceFieldStrength = 0.f;
+    bool analyticNoise = false;
+    float fixedTimestep = 0.f;
+    unsigned int maxSubstepCount = 8;
+    Scene::ParticleStorage particleStorage = Scene::PARTICLE_STORAGE_TRIPLE_BUFFERED;
+    ParticleUpdateSystem::Integrator integrator = ParticleUpdateSystem::INTEGRATOR_SEMI_IMPLICIT_EULER;
+    unsigned int framesInFlight = 2;
+    bool prerecord = false;
+    bool cpuUpdate = false;
+    unsigned int cpuThreadCount = 0;
+    bool quads = false;
+    bool cull = false;
+    float pointDiameter = 0.f;
+    float discardCoverage = 0.f;
+    bool splat = false;
+    bool tiled = false;
+    bool statistics = false;
+    unsigned int verifyFrameCount = 0;
+    std::string verifySnapshotPath;
+    std::string benchmarkName = "default";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-workgroupsize") == 0 && i + 1 < argc)
+            workGroupSize = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-grid") == 0 && i + 2 < argc)
+        {
+            lenX = std::atoi(argv[++i]);
+            lenY = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "-emit") == 0 && i + 1 < argc)
+            emitRate = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "-layout") == 0 && i + 1 < argc)
+            particleLayout = std::strcmp(argv[++i], "soa") == 0 ? Scene::PARTICLE_LAYOUT_SOA : Scene::PARTICLE_LAYOUT_AOS;
+        else if (std::strcmp(argv[i], "-benchmark") == 0 && i + 1 < argc)
+            benchmarkFrameCount = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-collision") == 0 && i + 1 < argc)
+            collisionRadius = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "-sort") == 0 && i + 1 < argc)
+            sortFrameInterval = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-fluid") == 0)
+            fluid = true;
+        else if (std::strcmp(argv[i], "-gravity") == 0 && i + 2 < argc)
+        {
+            gravitationalConstant = (float)std::atof(argv[++i]);
+            gravityTileSize = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "-sdf") == 0 && i + 1 < argc)
+            distanceFieldRadius = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "-barneshut") == 0 && i + 2 < argc)
+        {
+            gravitationalConstant = (float)std::atof(argv[++i]);
+            openingAngle = (float)std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "-forcefield") == 0 && i + 2 < argc)
+        {
+            forceFieldStrength = (float)std::atof(argv[++i]);
+            analyticNoise = std::strcmp(argv[++i], "analytic") == 0;
+        }
+        else if (std::strcmp(argv[i], "-fixedstep") == 0 && i + 2 < argc)
+        {
+            fixedTimestep = (float)std::atof(argv[++i]);
+            maxSubstepCount = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "-inplace") == 0)
+            particleStorage = Scene::PARTICLE_STORAGE_IN_PLACE;
+        else if (std::strcmp(argv[i], "-doublebuffer") == 0)
+            particleStorage = Scene::PARTICLE_STORAGE_DOUBLE_BUFFERED;
+        else if (std::strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            framesInFlight = glm::clamp(std::atoi(argv[++i]), 2, 3);
+        else if (std::strcmp(argv[i], "-prerecord") == 0)
+            prerecord = true;
+        else if (std::strcmp(argv[i], "-cpu") == 0 && i + 1 < argc)
+        {
+            cpuUpdate = true;
+            cpuThreadCount = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "-quads") == 0)
+            quads = true;
+        else if (std::strcmp(argv[i], "-cull") == 0)
+            cull = true;
+        else if (std::strcmp(argv[i], "-lod") == 0 && i + 2 < argc)
+        {
+            cull = true;
+            pointDiameter = (float)std::atof(argv[++i]);
+            discardCoverage = (float)std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "-splat") == 0)
+        {
+            cull = true;
+            splat = true;
+        }
+        else if (std::strcmp(argv[i], "-tiled") == 0)
+        {
+            cull = true;
+            tiled = true;
+        }
+        else if (std::strcmp(argv[i], "-statistics") == 0)
+            statistics = true;
+        else if (std::strcmp(argv[i], "-verify") == 0 && i + 2 < argc)
+        {
+            verifyFrameCount = std::atoi(argv[++i]);
+            verifySnapshotPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "-integrator") == 0 && i + 1 < argc)
+        {
+            ++i;
+            if (std::strcmp(argv[i], "euler") == 0)
+                integrator = ParticleUpdateSystem::INTEGRATOR_EXPLICIT_EULER;
+            else if (std::strcmp(argv[i], "verlet") == 0)
+                integrator = ParticleUpdateSystem::INTEGRATOR_VERLET;
+            else if (std::strcmp(argv[i], "rk2") == 0)
+                integrator = ParticleUpdateSystem::INTEGRATOR_RK2;
+            else
+                integrator = ParticleUpdateSystem::INTEGRATOR_SEMI_IMPLICIT_EULER;
+        }
+        else
+            std::cout << "Unknown argument: " << argv[i] << std::endl;
+    }
+    // Verified updates are stepped by CPU reference, so they are limited as CPU update and emit nothing.
+    if (verifyFrameCount > 0 && emitRate > 0.f)
+    {
+        std::cout << "Verify, -emit ignored." << std::endl;
+        emitRate = 0.f;
+    }
+    // CPU update has no force passes, distance field or sort, and records its upload every frame.
+    if ((cpuUpdate || verifyFrameCount > 0) && ((fluid && cpuUpdate) || gravitationalConstant > 0.f || distanceFieldRadius > 0.f || sortFrameInterval > 0 || prerecord))
+    {
+        std::cout << (cpuUpdate ? "CPU update, -fluid" : "Verify") << ", -gravity, -barneshut, -sdf, -sort and -prerecord ignored." << std::endl;
+        fluid = fluid && !cpuUpdate;
+        gravitationalConstant = 0.f;
+        distanceFieldRadius = 0.f;
+        sortFrameInterval = 0;
+        prerecord = false;
+    }
+    // CPU fluid reference has no collisions or force fields and steps each frame once.
+    if (verifyFrameCount > 0 && fluid && (collisionRadius > 0.f || forceFieldStrength > 0.f || fixedTimestep > 0.f))
+    {
+        std::cout << "Verify fluid, -collision, -forcefield and -fixedstep ignored." << std::endl;
+        collisionRadius = 0.f;
+        forceFieldStrength = 0.f;
+        fixedTimestep = 0.f;
+    }
+    // Benchmark is named by its arguments. Sorted runs are compared with the same arguments without sorting,
+    // sampled force fields with the same arguments evaluating noise analytically, prerecorded runs with runs recording every frame,
+    // CPU updates with GPU updates of the same arguments, instanced quads with geometry shader expansion, culled draws and levels of detail with draws of every particle as quads,
+    // splatted and tiled particles with culled draws of every particle as quads, structure of arrays with array of structs.
+    std::string baselineName;
+    for (int i = 1; i < argc; ++i)
+    {
+        benchmarkName = (i == 1 ? "" : benchmarkName + " ") + argv[i];
+        // Values of options compared without them name the benchmark, but not its baseline.
+        int valueCount = 0;
+        if (std::strcmp(argv[i], "-sort") == 0 || std::strcmp(argv[i], "-cpu") == 0)
+            valueCount = 1;
+        else if (std::strcmp(argv[i], "-lod") == 0)
+            valueCount = 2;
+        if (valueCount > 0)
+        {
+            for (; valueCount > 0 && i + 1 < argc; --valueCount)
+                benchmarkName += " " + std::string(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "-prerecord") == 0 || std::strcmp(argv[i], "-quads") == 0 || std::strcmp(argv[i], "-cull") == 0)
+            continue;
+        else if (std::strcmp(argv[i], "-splat") == 0 || std::strcmp(argv[i], "-tiled") == 0)
+            baselineName += (baselineName.empty() ? "" : " ") + std::string("-cull");
+        else if (std::strcmp(argv[i], "-layout") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "soa") == 0)
+        {
+            benchmarkName += " " + std::string(argv[++i]);
+            baselineName += (baselineName.empty() ? "" : " ") + std::string("-layout aos");
+        }
+        else if (std::strcmp(argv[i], "sampled") == 0 && i > 1 && std::strcmp(argv[i - 2], "-forcefield") == 0)
+            baselineName += " analytic";
+        else
+            baselineName += (baselineName.empty() ? "" : " ") + std::string(argv[i]);
+    }
+    // Commands of a frame in flight are resubmitted while it draws the same swap buffers, so every frame in flight must see one buffer rotation.
+    // Updates reading neighbors fall back from in-place to triple buffering below.
+    if (prerecord)
+    {
+        bool tripleBuffered = particleStorage == Scene::PARTICLE_STORAGE_TRIPLE_BUFFERED || (particleStorage == Scene::PARTICLE_STORAGE_IN_PLACE && !ParticleUpdateSystem::SupportsInPlaceUpdate(collisionRadius));
+        framesInFlight = tripleBuffered ? 3 : 2;
+    }
+    // --- COMMAND LINE --- //
+
     // +++ INIT +++ //
     unsigned int width = 1920 / 2;
     unsigned int height = 1080 / 2;
-    VkRenderer renderer(width, height);
+    VkRenderer renderer(width, height, framesInFlight);
     VkDevice device = renderer.mDevice;
     VkPhysicalDevice physicalDevice = renderer.mPhysicalDevice;
-    VkCommandPool graphicsCommandPool = renderer.mGraphicsCommandPool;
     VkCommandPool computeCommandPool = renderer.mComputeCommandPool;
     VkQueue graphicsQueue = renderer.mGraphicsQueue;
     VkQueue computeQueue = renderer.mComputeQueue;
-    //VkSemaphore graphicsCompleteSemaphore, computeCompleteSemaphore;
-    //vkTools::CreateVkSemaphore(device, graphicsCompleteSemaphore);
-    //vkTools::CreateVkSemaphore(device, computeCompleteSemaphore);
-
-    VkCommandBuffer graphicsCommandBuffer;
-    vkTools::CreateCommandBuffer(device, graphicsCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, graphicsCommandBuffer);
-    VkCommandBuffer computeCommandBuffer;
-    vkTools::CreateCommandBuffer(device, computeCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, computeCommandBuffer);
+    // Graphics of frame N waits compute of frame N, compute waits graphics of an earlier frame. Alternate between even and odd frames.
+    VkSemaphore computeCompleteSemaphore[2], graphicsCompleteSemaphore[2];
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        vkTools::CreateVkSemaphore(device, computeCompleteSemaphore[i]);
+        vkTools::CreateVkSemaphore(device, graphicsCompleteSemaphore[i]);
+    }
+    // Present waits render, render of next frame waits copy of frame buffer by present.
+    VkSemaphore renderCompleteSemaphore, frameBufferCopiedSemaphore;
+    vkTools::CreateVkSemaphore(device, renderCompleteSemaphore);
+    vkTools::CreateVkSemaphore(device, frameBufferCopiedSemaphore);
+    // Each frame in flight records into own command pools, reset once per frame when its fence of queue is signaled.
+    // Timestamps of frame are read at the same time, as queries of frames in flight may not be reset.
+    // Prerecorded command buffers are reset only when commands of frame differ from those recorded.
+    struct FrameSlot
+    {
+        bool computeRecorded;
+        bool graphicsRecorded;
+        ParticleUpdateSystem::Structure updateStructure;
+        std::vector<VkBuffer> renderSwapState;
+        VkCommandPool computeCommandPool;
+        VkCommandPool graphicsCommandPool;
+        VkCommandBuffer computeCommandBuffer;
+        VkCommandBuffer graphicsCommandBuffer;
+        VkFence computeFence;
+        VkFence graphicsFence;
+        VkTimer* computeTimer;
+        VkTimer* graphicsTimer;
+        VkTimer* treeBuildTimer;
+        VkTimer* treeTraverseTimer;
+    };
+    std::vector<FrameSlot> frameSlotList(framesInFlight);
+    for (FrameSlot& frame : frameSlotList)
+    {
+        frame.computeRecorded = false;
+        frame.graphicsRecorded = false;
+        vkTools::CreateCommandPool(device, renderer.mComputeFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, frame.computeCommandPool);
+        vkTools::CreateCommandPool(device, renderer.mGraphicsFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, frame.graphicsCommandPool);
+        vkTools::CreateCommandBuffer(device, frame.computeCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, frame.computeCommandBuffer);
+        vkTools::CreateCommandBuffer(device, frame.graphicsCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, frame.graphicsCommandBuffer);
+        vkTools::CreateFence(device, frame.computeFence, true);
+        vkTools::CreateFence(device, frame.graphicsFence, true);
+        frame.computeTimer = new VkTimer(device, physicalDevice);
+        frame.graphicsTimer = new VkTimer(device, physicalDevice);
+        frame.treeBuildTimer = new VkTimer(device, physicalDevice);
+        frame.treeTraverseTimer = new VkTimer(device, physicalDevice);
+    }
+    std::cout << "Frames in flight: " << framesInFlight << (prerecord ? ", prerecorded" : "") << std::endl;
 
     VkRenderPass renderPass = renderer.mRenderPass;
 
-    VkCommandBuffer transferCommandBuffer = vkTools::BeginSingleTimeCommand(device, renderer.mTransferCommandPool);
+    // Scene is uploaded on compute queue, which owns its buffers until first render.
+    VkCommandBuffer sceneUploadCommandBuffer = vkTools::BeginSingleTimeCommand(device, computeCommandPool);
 
-    ParticleUpdateSystem particleUpdateSystem(device, physicalDevice);
-    ParticleRenderSystem particleRenderSystem(device, physicalDevice, width, height, renderer.mSurfaceFormatKHR.format, renderPass);
+    ParticleUpdateSystem particleUpdateSystem(device, physicalDevice, workGroupSize, 1 << 20, framesInFlight);
+    std::cout << "Compute work group size: " << particleUpdateSystem.GetWorkGroupSize() << std::endl;
+    particleUpdateSystem.SetCollision(collisionRadius);
+    ParticleUpdateSystemCPU* cpuUpdateSystem = nullptr;
+    if (cpuUpdate)
+    {
+        cpuUpdateSystem = new ParticleUpdateSystemCPU(device, physicalDevice, cpuThreadCount, framesInFlight);
+        cpuUpdateSystem->SetCollision(collisionRadius);
+        std::cout << "CPU update: " << cpuUpdateSystem->GetThreadCount() << " threads, " << ParticleUpdateSystemCPU::GetSimdName() << std::endl;
+    }
+    // Reference of -verify, stepped after main loop. Fluid is stepped by UpdateFluidCPU instead.
+    ParticleUpdateSystemCPU* referenceUpdateSystem = nullptr;
+    if (verifyFrameCount > 0 && !fluid)
+    {
+        referenceUpdateSystem = new ParticleUpdateSystemCPU(device, physicalDevice, cpuThreadCount);
+        referenceUpdateSystem->SetCollision(collisionRadius);
+    }
+    // CPU systems mirror settings of GPU update system.
+    std::vector<ParticleUpdateSystemCPU*> cpuUpdateSystemList;
+    if (cpuUpdateSystem != nullptr)
+        cpuUpdateSystemList.push_back(cpuUpdateSystem);
+    if (referenceUpdateSystem != nullptr)
+        cpuUpdateSystemList.push_back(referenceUpdateSystem);
+    ParticleRenderSystem particleRenderSystem(device, physicalDevice, width, height, renderer.mSurfaceFormatKHR.format, renderPass, framesInFlight, prerecord);
+    particleRenderSystem.SetRenderMode(quads ? ParticleRenderSystem::RENDER_MODE_INSTANCED_QUADS : ParticleRenderSystem::RENDER_MODE_GEOMETRY_SHADER);
+    particleRenderSystem.SetFrustumCulling(cull);
+    particleRenderSystem.SetLevelOfDetail(pointDiameter, discardCoverage);
+    particleRenderSystem.SetComputeSplatting(splat);
+    particleRenderSystem.SetTiledBlending(tiled);
+    std::cout << "Render mode: " << (quads ? "instanced quads" : "geometry shader") << (cull ? ", frustum culled" : "") << (pointDiameter > 0.f ? ", points below " + std::to_string(pointDiameter) + " pixels" : "") << (splat ? ", points splatted" : "") << (tiled ? ", quads blended in tiles" : "") << std::endl;
 
     InputManager inputManager(renderer.mGLFWwindow);
 
     FrameBuffer frameBuffer(device, physicalDevice, width, height, renderer.mSurfaceFormatKHR.format, renderPass);
     Camera camera(60.f, &frameBuffer);
 
-    int lenX = 1;
-    int lenY = 1;
-    Scene scene(device, physicalDevice, lenX * lenY);
+    ParticleEmitter emitter;
+    emitter.position = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    emitter.velocity = glm::vec4(0.f, 2.f, 0.f, 1.f);
+    emitter.color = glm::vec4(1.f, 0.5f, 0.2f, 1.f);
+    emitter.scale = glm::vec4(0.2f, 0.2f, 0.f, 0.f);
+    emitter.rate = emitRate;
+    emitter.lifetime = 5.f;
+    // Room for every particle of emitter alive at once, plus one frame of slack.
+    unsigned int emitCapacity = (unsigned int)(emitter.rate * (emitter.lifetime + 1.f));
+    if (particleStorage == Scene::PARTICLE_STORAGE_IN_PLACE && !particleUpdateSystem.SupportsInPlaceUpdate())
+    {
+        std::cout << "Update reads neighbor particles, in-place storage ignored." << std::endl;
+        particleStorage = Scene::PARTICLE_STORAGE_TRIPLE_BUFFERED;
+    }
+    Scene scene(device, physicalDevice, lenX * lenY + emitCapacity, particleLayout, particleStorage, renderer.mComputeFamilyIndex, renderer.mGraphicsFamilyIndex);
+    std::cout << "Particle layout: " << (particleLayout == Scene::PARTICLE_LAYOUT_SOA ? "SoA" : "AoS") << std::endl;
+    const char* particleStorageName[] = { "double buffered", "in place", "triple buffered" };
+    std::cout << "Particle storage: " << particleStorageName[particleStorage] << ", " << scene.GetParticleMemorySize() / 1024 << " KiB" << std::endl;
+    if (emitter.rate > 0.f)
+        scene.AddEmitter(emitter);
+    // Input buffers drawn this frame are reduced by compute before update, in place they are owned by render then.
+    ParticleStatistics* particleStatistics = nullptr;
+    if (statistics && particleStorage == Scene::PARTICLE_STORAGE_IN_PLACE)
+        std::cout << "In-place storage, -statistics ignored." << std::endl;
+    else if (statistics)
+        particleStatistics = new ParticleStatistics(device, physicalDevice, lenX * lenY + emitCapacity, framesInFlight);
+    // Initial particles and fluid parameters of -verify with -fluid.
+    std::vector<Particle> verifyParticleList;
+    ParticleUpdateSystem::FluidParameters fluidParameters;
     {
         std::vector<Particle> particleList;
         Particle particle;
@@ -68,24 +407,115 @@ int main()
             {
                 particle.position = glm::vec4(x * spacing, y * spacing, 0.f, 0.f);
                 //particle.velocity = -glm::normalize(particle.position + glm::vec4(speed, speed, 0.f, 0.f));
-                particle.velocity = glm::vec4(0.f, 0.f, 0.f, 0.f);
+                particle.velocity = glm::vec4(0.f, 0.f, 0.f, 1.f);
                 particle.color = glm::vec4((float)y / lenY, 0.7f, 1.f - (float)x / lenX, 1.f);
                 particleList.push_back(particle);
             }
         }
-        scene.AddParticles(transferCommandBuffer, particleList);
+        scene.AddParticles(sceneUploadCommandBuffer, particleList);
+        for (ParticleUpdateSystemCPU* cpuSystem : cpuUpdateSystemList)
+            cpuSystem->Load(&scene, particleList);
+        if (verifyFrameCount > 0 && fluid)
+            verifyParticleList = particleList;
 
         camera.mPosition.x = (lenX - 1) / 2.f * spacing;
         camera.mPosition.y = (lenY - 1) / 2.f * spacing;
         camera.mPosition.z = -50.f;
+
+        // Sort volume around grid and emitter.
+        float extent = (std::max)(lenX, lenY) * spacing + 20.f;
+        scene.SetMortonSort(sortFrameInterval, glm::vec3(-20.f), glm::vec3(extent));
+
+        // Fluid box is wider than grid so the column can spread.
+        if (fluid)
+        {
+            fluidParameters.smoothingRadius = 1.5f * spacing;
+            fluidParameters.boundsMin = glm::vec4(-spacing, -spacing, -5.f * spacing, 0.f);
+            fluidParameters.boundsMax = glm::vec4(2.f * lenX * spacing, lenY * spacing, 5.f * spacing, 0.f);
+            particleUpdateSystem.SetFluidParameters(fluidParameters);
+            particleUpdateSystem.SetMode(ParticleUpdateSystem::MODE_FLUID);
+        }
+
+        if (gravitationalConstant > 0.f && openingAngle > 0.f)
+        {
+            particleUpdateSystem.SetGravity(gravitationalConstant, spacing * 0.5f);
+            particleUpdateSystem.SetBarnesHut(openingAngle);
+            particleUpdateSystem.SetMode(ParticleUpdateSystem::MODE_BARNES_HUT);
+        }
+        else if (gravitationalConstant > 0.f)
+        {
+            particleUpdateSystem.SetGravity(gravitationalConstant, spacing * 0.5f, gravityTileSize);
+            particleUpdateSystem.SetMode(ParticleUpdateSystem::MODE_GRAVITY);
+            std::cout << "Gravity tile size: " << particleUpdateSystem.GetGravityTileSize() << std::endl;
+        }
+
+        particleUpdateSystem.SetIntegrator(integrator);
+        particleUpdateSystem.SetFixedTimestep(fixedTimestep, maxSubstepCount);
+        for (ParticleUpdateSystemCPU* cpuSystem : cpuUpdateSystemList)
+        {
+            cpuSystem->SetIntegrator(integrator);
+            cpuSystem->SetFixedTimestep(fixedTimestep, maxSubstepCount);
+        }
+    }
+    vkTools::EndSingleTimeCommand(device, computeCommandPool, computeQueue, sceneUploadCommandBuffer);
+
+    // Skull above emitter and plate above skull. Uploaded on compute queue, which samples it.
+    SignedDistanceField* distanceField = nullptr;
+    if (distanceFieldRadius > 0.f)
+    {
+        std::vector<SignedDistanceField::Mesh> meshList{
+            { "resources/assets/Skull/skull.obj", glm::scale(glm::translate(glm::mat4(), glm::vec3(0.f, 6.f, 0.f)), glm::vec3(3.f)) },
+            { "resources/assets/OBJBox.obj", glm::scale(glm::translate(glm::mat4(), glm::vec3(0.f, 12.f, 0.f)), glm::vec3(10.f, 0.5f, 10.f)) }
+        };
+        float bakeTime;
+        {
+            CPUTIMER(bakeTime);
+            VkCommandBuffer uploadCommandBuffer = vkTools::BeginSingleTimeCommand(device, computeCommandPool);
+            distanceField = new SignedDistanceField(device, physicalDevice, uploadCommandBuffer, meshList, "resources/assets/Collision.sdf", 128);
+            vkTools::EndSingleTimeCommand(device, computeCommandPool, computeQueue, uploadCommandBuffer);
+        }
+        std::cout << "Signed distance field " << (distanceField->mCached ? "loaded" : "baked") << " in " << bakeTime / 1000000.f << " ms" << std::endl;
+        particleUpdateSystem.SetDistanceField(distanceField, distanceFieldRadius);
+    }
+
+    // Curl noise over volume around grid and emitter, and vortex around emitter column. Vortex is an imported style velocity grid, always sampled.
+    VectorField* noiseField = nullptr;
+    VectorField* vortexField = nullptr;
+    if (forceFieldStrength > 0.f)
+    {
+        VkCommandBuffer uploadCommandBuffer = vkTools::BeginSingleTimeCommand(device, computeCommandPool);
+        noiseField = new VectorField(device, physicalDevice, uploadCommandBuffer, 64, 4.f);
+        const unsigned int vortexResolution = 32;
+        std::vector<glm::vec4> vortexList;
+        for (unsigned int z = 0; z < vortexResolution; ++z)
+            for (unsigned int y = 0; y < vortexResolution; ++y)
+                for (unsigned int x = 0; x < vortexResolution; ++x)
+                {
+                    glm::vec3 position = (glm::vec3(x, y, z) + 0.5f) / (float)vortexResolution - 0.5f;
+                    vortexList.push_back(glm::vec4(-position.z, 0.5f, position.x, 0.f) * 4.f);
+                }
+        vortexField = new VectorField(device, physicalDevice, uploadCommandBuffer, vortexList, glm::uvec3(vortexResolution));
+        vkTools::EndSingleTimeCommand(device, computeCommandPool, computeQueue, uploadCommandBuffer);
+
+        float extent = (std::max)(lenX, lenY) + 20.f;
+        particleUpdateSystem.SetForceField(0, noiseField, glm::scale(glm::translate(glm::mat4(), glm::vec3(-20.f)), glm::vec3(extent + 20.f)), forceFieldStrength);
+        particleUpdateSystem.SetForceField(1, vortexField, glm::scale(glm::translate(glm::mat4(), glm::vec3(-4.f, 0.f, -4.f)), glm::vec3(8.f, 12.f, 8.f)), 0.f, 1.f);
+        particleUpdateSystem.SetAnalyticNoise(analyticNoise);
+        for (ParticleUpdateSystemCPU* cpuSystem : cpuUpdateSystemList)
+        {
+            cpuSystem->SetForceField(0, noiseField, glm::scale(glm::translate(glm::mat4(), glm::vec3(-20.f)), glm::vec3(extent + 20.f)), forceFieldStrength);
+            cpuSystem->SetForceField(1, vortexField, glm::scale(glm::translate(glm::mat4(), glm::vec3(-4.f, 0.f, -4.f)), glm::vec3(8.f, 12.f, 8.f)), 0.f, 1.f);
+            cpuSystem->SetAnalyticNoise(analyticNoise);
+        }
+        std::cout << "Force field noise: " << (analyticNoise ? "analytic" : "sampled") << std::endl;
     }
-    vkTools::EndSingleTimeCommand(device, renderer.mTransferCommandPool, renderer.mTransferQueue, transferCommandBuffer);
     // --- INIT --- //
 
     // +++ MAIN LOOP +++ //
+    int exitCode = 0;
     {
         double startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-        double currentTime = 0.0;
+        double currentTime = startTime;
         double totalTime = 0.0;
         double totalMeasureTime = 0.0;
         float mt = 0.f;
@@ -99,10 +529,39 @@ int main()
         std::cout << "Hold F1 to sync compute/graphics. " << std::endl;
         std::cout << "Hold F2 to profile. " << std::endl;
         std::cout << "Hold F3 to show average frame time. " << std::endl;
+        if (particleStatistics != nullptr)
+            std::cout << "Hold F4 to frame particles. " << std::endl;
         unsigned int frameCount = 0;
-        VkTimer gpuComputeTimer(device, physicalDevice);
-        VkTimer gpuGraphicsTimer(device, physicalDevice);
+        bool barnesHut = gravitationalConstant > 0.f && openingAngle > 0.f;
         Profiler profiler(1600, 200);
+        Benchmark benchmark(benchmarkName, benchmarkFrameCount);
+        if (sortFrameInterval > 0 || (forceFieldStrength > 0.f && !analyticNoise) || prerecord || cpuUpdate || quads || cull || particleLayout == Scene::PARTICLE_LAYOUT_SOA)
+            benchmark.SetBaseline(baselineName);
+        // Compute of frame N writes buffers drawn by graphics of frame N - computeLag. Compute of frame N + 1 overlaps graphics of frame N if lag is 2.
+        const unsigned int computeLag = particleStorage == Scene::PARTICLE_STORAGE_TRIPLE_BUFFERED ? 2 : 1;
+        unsigned int frameIndex = 0;
+        // GPU times of last completed frames, read when their fence is signaled. Begin and end in nano seconds.
+        float computeTime = 0.f;
+        float graphicsTime = 0.f;
+        float treeBuildTime = 0.f;
+        float treeTraverseTime = 0.f;
+        float overlapTime = 0.f;
+        // Time of CPU update and upload recording in nano seconds.
+        float cpuUpdateTime = 0.f;
+        uint64_t computeBeginTime = 0, computeEndTime = 0;
+        uint64_t graphicsBeginTime = 0, graphicsEndTime = 0;
+        // Descriptors written while recording frame, zero once every combination of swapped buffers is cached.
+        unsigned int descriptorWriteCount = 0;
+        // Command buffers recorded this frame, zero when prerecorded ones are resubmitted.
+        unsigned int recordCount = 0;
+        std::vector<VkBuffer> swapState;
+        // Statistics of last completed frame, and whether it was unstable.
+        ParticleStatistics::Statistics particleStatisticsResult;
+        bool particleStatisticsValid = false;
+        bool unstable = false;
+        // Overdraw of each tile of last completed frame with tiled blending.
+        std::vector<float> tileOverdrawList;
+        bool tileOverdrawValid = false;
         while (renderer.Running())
         {
             //glm::clamp(dt, 1.f / 6000.f, 1.f / 60.f);
@@ -112,53 +571,172 @@ int main()
                 double lastTime = currentTime;
                 currentTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
                 dt = (currentTime - lastTime) / 1000000000;
+                // Verified frames are stepped by fixed delta time, repeatable by reference.
+                if (verifyFrameCount > 0)
+                    dt = VERIFY_DT;
                 totalTime = currentTime - startTime;
 
                 CPUTIMER(mt);
+                unsigned int totalDescriptorWriteCount = DescriptorSetCache::GetWriteCount();
+
+                // Resources of frame framesInFlight frames ago are reused once its fences are signaled.
+                FrameSlot& frame = frameSlotList[frameIndex % framesInFlight];
+                VkCommandBuffer computeCommandBuffer = frame.computeCommandBuffer;
+                VkCommandBuffer graphicsCommandBuffer = frame.graphicsCommandBuffer;
+                VkTimer& gpuComputeTimer = *frame.computeTimer;
+                VkTimer& gpuGraphicsTimer = *frame.graphicsTimer;
+                VkTimer& gpuTreeBuildTimer = *frame.treeBuildTimer;
+                VkTimer& gpuTreeTraverseTimer = *frame.treeTraverseTimer;
 
                 // +++ UPDATE +++ //
-                //vkTools::WaitQueue(computeQueue);
-                vkTools::ResetCommandBuffer(computeCommandBuffer);
-                vkTools::BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, computeCommandBuffer);
-                if (totalTime > SKIP_TIME_NANO) gpuComputeTimer.Start(computeCommandBuffer);
+                recordCount = 0;
+                vkTools::WaitFence(device, frame.computeFence);
+                // Timers of compute of this slot were written by its last submission.
+                if (!gpuComputeTimer.IsReset())
+                {
+                    computeTime = 1.f / 1000000.f * gpuComputeTimer.GetDeltaTime();
+                    computeBeginTime = gpuComputeTimer.GetBeginTime();
+                    computeEndTime = computeBeginTime + gpuComputeTimer.GetDeltaTime();
+                    // Graphics times are of the frame before this slot's compute, which it may overlap.
+                    int64_t overlap = (int64_t)(std::min)(computeEndTime, graphicsEndTime) - (int64_t)(std::max)(computeBeginTime, graphicsBeginTime);
+                    overlapTime = 1.f / 1000000.f * (std::max)(overlap, (int64_t)0);
+                }
+                if (!gpuTreeBuildTimer.IsReset())
+                    treeBuildTime = 1.f / 1000000.f * gpuTreeBuildTimer.GetDeltaTime();
+                if (!gpuTreeTraverseTimer.IsReset())
+                    treeTraverseTime = 1.f / 1000000.f * gpuTreeTraverseTimer.GetDeltaTime();
 
-                camera.Update(20.f, 2.f, dt, &inputManager);
-                particleUpdateSystem.Update(computeCommandBuffer, &scene, dt);
+                // Statistics recorded by last compute of slot, framesInFlight frames ago.
+                if (particleStatistics != nullptr && particleStatistics->Read(frameIndex, particleStatisticsResult))
+                {
+                    particleStatisticsValid = true;
+                    bool frameUnstable = !std::isfinite(particleStatisticsResult.kineticEnergy) || !(particleStatisticsResult.maxSpeed <= UNSTABLE_SPEED);
+                    if (frameUnstable && !unstable)
+                        std::cout << "Simulation unstable at frame " << particleStatisticsResult.frameIndex << ": max speed " << particleStatisticsResult.maxSpeed << ", kinetic energy " << particleStatisticsResult.kineticEnergy << std::endl;
+                    unstable = frameUnstable;
+                    // Move camera back along its front direction until bounding sphere of particles fits field of view.
+                    if (inputManager.KeyPressed(GLFW_KEY_F4) && particleStatisticsResult.aliveCount > 0 && !frameUnstable)
+                    {
+                        glm::vec3 center = (particleStatisticsResult.boundsMin + particleStatisticsResult.boundsMax) * 0.5f;
+                        float radius = (std::max)(glm::length(particleStatisticsResult.boundsMax - particleStatisticsResult.boundsMin) * 0.5f, 1.f);
+                        camera.mPosition = center - camera.mFrontDirection * (radius / std::sin(glm::radians(camera.mFov) * 0.5f));
+                    }
+                }
 
-                if (totalTime > SKIP_TIME_NANO) gpuComputeTimer.Stop(computeCommandBuffer);
-                vkTools::EndCommandBuffer(computeCommandBuffer);
-                //vkTools::QueueSubmit(computeQueue, { computeCommandBuffer }, { computeCompleteSemaphore });
-                vkTools::QueueSubmit(computeQueue, { computeCommandBuffer });
-                // SYNC_COMPUTE_GRAPHICS
-                if (syncComputeGraphics) vkTools::WaitQueue(computeQueue);
+                camera.Update(20.f, 2.f, dt, &inputManager);
+                ParticleUpdateSystem::Structure updateStructure;
+                if (cpuUpdateSystem == nullptr)
+                    updateStructure = particleUpdateSystem.Prepare(&scene, dt, frameIndex);
+                if (prerecord && frame.computeRecorded && updateStructure == frame.updateStructure)
+                {
+                    // Constants of frame are in uniform ring, commands are those of last submission of slot.
+                    if (particleStatistics != nullptr)
+                        particleStatistics->Record(VK_NULL_HANDLE, &scene, frameIndex);
+                    particleUpdateSystem.Record(VK_NULL_HANDLE, &scene);
+                    gpuComputeTimer.Resubmit();
+                }
+                else
+                {
+                    vkTools::ResetCommandPool(device, frame.computeCommandPool);
+                    vkTools::BeginCommandBuffer(prerecord ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, computeCommandBuffer);
+                    // Prerecorded timers are reset by every submission. Tree timers are not prerecorded.
+                    if (prerecord)
+                        gpuComputeTimer.ResetStart(computeCommandBuffer);
+                    else
+                    {
+                        if (!gpuComputeTimer.IsReset())
+                            gpuComputeTimer.Reset(computeCommandBuffer);
+                        if (!gpuTreeBuildTimer.IsReset())
+                            gpuTreeBuildTimer.Reset(computeCommandBuffer);
+                        if (!gpuTreeTraverseTimer.IsReset())
+                            gpuTreeTraverseTimer.Reset(computeCommandBuffer);
+                        if (totalTime > SKIP_TIME_NANO) gpuComputeTimer.Start(computeCommandBuffer);
+                    }
+
+                    bool measureTree = barnesHut && totalTime > SKIP_TIME_NANO && !prerecord;
+                    if (particleStatistics != nullptr)
+                        particleStatistics->Record(computeCommandBuffer, &scene, frameIndex);
+                    if (cpuUpdateSystem != nullptr)
+                    {
+                        CPUTIMER(cpuUpdateTime);
+                        cpuUpdateSystem->Update(computeCommandBuffer, &scene, dt, frameIndex);
+                    }
+                    else
+                        particleUpdateSystem.Record(computeCommandBuffer, &scene, measureTree ? &gpuTreeBuildTimer : nullptr, measureTree ? &gpuTreeTraverseTimer : nullptr);
+
+                    if (gpuComputeTimer.IsActive()) gpuComputeTimer.Stop(computeCommandBuffer);
+                    vkTools::EndCommandBuffer(computeCommandBuffer);
+                    frame.computeRecorded = true;
+                    frame.updateStructure = updateStructure;
+                    ++recordCount;
+                }
+                std::vector<VkSemaphore> computeWaitSemaphoreList;
+                if (frameIndex >= computeLag)
+                    computeWaitSemaphoreList.push_back(graphicsCompleteSemaphore[(frameIndex - computeLag) % 2]);
+                vkTools::QueueSubmit(computeQueue, { computeCommandBuffer }, { computeCompleteSemaphore[frameIndex % 2] }, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, computeWaitSemaphoreList, frame.computeFence);
                 // --- UPDATE --- //
 
                 // +++ RENDER +++ //
-                //vkTools::WaitQueue(graphicsQueue);
-                vkTools::ResetCommandBuffer(graphicsCommandBuffer);
-                vkTools::BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, graphicsCommandBuffer);
-                if (totalTime > SKIP_TIME_NANO) gpuGraphicsTimer.Start(graphicsCommandBuffer);
-
-                camera.mpFrameBuffer->Clear(graphicsCommandBuffer, 0.2f, 0.2f, 0.2f);
-                particleRenderSystem.Render(graphicsCommandBuffer, &scene, &camera);
-
-                if (totalTime > SKIP_TIME_NANO) gpuGraphicsTimer.Stop(graphicsCommandBuffer);
-                vkTools::EndCommandBuffer(graphicsCommandBuffer);
-                //vkTools::QueueSubmit(graphicsQueue, { graphicsCommandBuffer }, { graphicsCompleteSemaphore });
-                vkTools::QueueSubmit(graphicsQueue, { graphicsCommandBuffer });
+                vkTools::WaitFence(device, frame.graphicsFence);
+                if (!gpuGraphicsTimer.IsReset())
+                {
+                    graphicsTime = 1.f / 1000000.f * gpuGraphicsTimer.GetDeltaTime();
+                    graphicsBeginTime = gpuGraphicsTimer.GetBeginTime();
+                    graphicsEndTime = graphicsBeginTime + gpuGraphicsTimer.GetDeltaTime();
+                }
+                // Overdraw recorded by last graphics of slot, framesInFlight frames ago.
+                if (tiled && particleRenderSystem.ReadTileOverdraw(frameIndex, tileOverdrawList))
+                    tileOverdrawValid = true;
+
+                particleRenderSystem.Prepare(&camera, frameIndex);
+                scene.GetSwapState(swapState);
+                if (prerecord && frame.graphicsRecorded && swapState == frame.renderSwapState)
+                {
+                    // View of frame is in uniform ring.
+                    particleRenderSystem.Record(VK_NULL_HANDLE, &scene, &camera);
+                    gpuGraphicsTimer.Resubmit();
+                }
+                else
+                {
+                    vkTools::ResetCommandPool(device, frame.graphicsCommandPool);
+                    vkTools::BeginCommandBuffer(prerecord ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, graphicsCommandBuffer);
+                    if (prerecord)
+                        gpuGraphicsTimer.ResetStart(graphicsCommandBuffer);
+                    else
+                    {
+                        if (!gpuGraphicsTimer.IsReset())
+                            gpuGraphicsTimer.Reset(graphicsCommandBuffer);
+                        if (totalTime > SKIP_TIME_NANO) gpuGraphicsTimer.Start(graphicsCommandBuffer);
+                    }
+
+                    camera.mpFrameBuffer->Clear(graphicsCommandBuffer, 0.2f, 0.2f, 0.2f);
+                    particleRenderSystem.Record(graphicsCommandBuffer, &scene, &camera);
+
+                    if (gpuGraphicsTimer.IsActive()) gpuGraphicsTimer.Stop(graphicsCommandBuffer);
+                    vkTools::EndCommandBuffer(graphicsCommandBuffer);
+                    frame.graphicsRecorded = true;
+                    frame.renderSwapState = swapState;
+                    ++recordCount;
+                }
+                // Draws input of compute of this frame, after it released buffers. Frame buffer is cleared after present copied it.
+                std::vector<VkSemaphore> graphicsWaitSemaphoreList = { computeCompleteSemaphore[frameIndex % 2] };
+                if (frameIndex > 0)
+                    graphicsWaitSemaphoreList.push_back(frameBufferCopiedSemaphore);
+                vkTools::QueueSubmit(graphicsQueue, { graphicsCommandBuffer }, { graphicsCompleteSemaphore[frameIndex % 2], renderCompleteSemaphore }, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, graphicsWaitSemaphoreList, frame.graphicsFence);
                 // --- RENDER --- //
+                descriptorWriteCount = DescriptorSetCache::GetWriteCount() - totalDescriptorWriteCount;
 
-                // Wait on CPU for compute and graphics to complete.
-                vkTools::WaitQueue(computeQueue);
-                vkTools::WaitQueue(graphicsQueue);
+                // SYNC_COMPUTE_GRAPHICS
+                // Compute of next frame is not recorded until graphics completes. Fence is reset when slot is reused.
+                if (syncComputeGraphics) vkTools::WaitFence(device, frame.graphicsFence, false);
+                ++frameIndex;
+                if (verifyFrameCount > 0 && frameIndex >= verifyFrameCount)
+                    renderer.Close();
             }
 
             // +++ PRESENET +++ //
-            // Wait for frame to complete.
-            //vkTools::QueueSubmit(graphicsQueue, {}, {}, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, { computeCompleteSemaphore, graphicsCompleteSemaphore });
-
-            // Present frame.
-            renderer.Present(camera.mpFrameBuffer);
+            // Present frame when rendered.
+            renderer.Present(camera.mpFrameBuffer, renderCompleteSemaphore, frameBufferCopiedSemaphore);
             // --- PRESENET --- //
 
             // +++ PROFILING +++ //
@@ -170,19 +748,33 @@ int main()
                 totalMeasureTime += mt;
                 ++frameCount;
 
-                float computeTime = 1.f / 1000000.f * gpuComputeTimer.GetDeltaTime();
-                float graphicsTime = 1.f / 1000000.f * gpuGraphicsTimer.GetDeltaTime();
-                VkCommandBuffer resetTimerCommandBuffer = vkTools::BeginSingleTimeCommand(device, renderer.mGraphicsCommandPool);
-                gpuComputeTimer.Reset(resetTimerCommandBuffer);
-                gpuGraphicsTimer.Reset(resetTimerCommandBuffer);
-                vkTools::EndSingleTimeCommand(device, renderer.mGraphicsCommandPool, renderer.mGraphicsQueue, resetTimerCommandBuffer);
-
+                // GPU times lag frames in flight behind, as compute and graphics of those frames may still run.
                 if (inputManager.KeyPressed(GLFW_KEY_F2))
                 {
-                    std::cout << "GPU(Total) : " << computeTime + graphicsTime << " ms | GPU(Compute): " << computeTime << " ms | GPU(Graphics) : " << graphicsTime << " ms" << std::endl;
-                    profiler.Rectangle(gpuComputeTimer.GetBeginTime(), 1, gpuComputeTimer.GetDeltaTime(), 1, 0.f, 0.f, 1.f);
-                    profiler.Rectangle(gpuGraphicsTimer.GetBeginTime(), 0, gpuGraphicsTimer.GetDeltaTime(), 1, 0.f, 1.f, 0.f);
-                    profiler.Point(gpuGraphicsTimer.GetBeginTime(), totalMeasureTime / frameCount, syncComputeGraphics ? "'-ro'" : "'-bo'");
+                    std::cout << "GPU(Total) : " << computeTime + graphicsTime << " ms | GPU(Compute): " << computeTime << " ms | GPU(Graphics) : " << graphicsTime << " ms | GPU(Overlap) : " << overlapTime << " ms" << std::endl;
+                    std::cout << "CPU(Descriptor writes) : " << descriptorWriteCount << " | CPU(Recorded command buffers) : " << recordCount << std::endl;
+                    if (cpuUpdateSystem != nullptr)
+                        std::cout << "CPU(Update) : " << cpuUpdateTime / 1000000.f << " ms" << std::endl;
+                    if (particleStatisticsValid)
+                    {
+                        const ParticleStatistics::Statistics& result = particleStatisticsResult;
+                        std::cout << "GPU(Statistics) frame " << result.frameIndex << " : alive " << result.aliveCount << " | bounds (" << result.boundsMin.x << ", " << result.boundsMin.y << ", " << result.boundsMin.z << ") - ("
+                            << result.boundsMax.x << ", " << result.boundsMax.y << ", " << result.boundsMax.z << ") | kinetic energy " << result.kineticEnergy << " | mean speed " << result.meanSpeed << " | max speed " << result.maxSpeed << std::endl;
+                    }
+                    // Raster suits scenes of low overdraw, tiles those where overdraw of some tiles is high.
+                    if (tileOverdrawValid)
+                    {
+                        unsigned int tileCountX, tileCountY;
+                        particleRenderSystem.GetTileCount(tileCountX, tileCountY);
+                        std::size_t maxTile = std::max_element(tileOverdrawList.begin(), tileOverdrawList.end()) - tileOverdrawList.begin();
+                        float meanOverdraw = std::accumulate(tileOverdrawList.begin(), tileOverdrawList.end(), 0.f) / tileOverdrawList.size();
+                        std::cout << "GPU(Tile overdraw) : mean " << meanOverdraw << " | max " << tileOverdrawList[maxTile] << " at tile (" << maxTile % tileCountX << ", " << maxTile / tileCountX << ") of " << tileCountX << "x" << tileCountY << std::endl;
+                    }
+                    if (barnesHut)
+                        std::cout << "GPU(Tree build) : " << treeBuildTime << " ms | GPU(Tree traverse) : " << treeTraverseTime << " ms" << std::endl;
+                    profiler.Rectangle(computeBeginTime, 1, computeEndTime - computeBeginTime, 1, 0.f, 0.f, 1.f);
+                    profiler.Rectangle(graphicsBeginTime, 0, graphicsEndTime - graphicsBeginTime, 1, 0.f, 1.f, 0.f);
+                    profiler.Point(graphicsBeginTime, totalMeasureTime / frameCount, syncComputeGraphics ? "'-ro'" : "'-bo'");
                 }
 
                 // CALCULATE AVERAGE FRAME TIME OF LAST NUMBER OF FRAMES
@@ -194,21 +786,104 @@ int main()
                 {
                     std::cout << "CPU(Average delta time of last " << PROFILE_FRAME_COUNT << " frames) : " << averageTime / PROFILE_FRAME_COUNT / 1000000 << " ms : FrameCount: " << frameCount << std::endl;
                 }
+
+                benchmark.Sample("CPU(Frame) ms", mt / 1000000.0);
+                benchmark.Sample("GPU(Compute) ms", computeTime);
+                benchmark.Sample("GPU(Graphics) ms", graphicsTime);
+                benchmark.Sample("GPU(Overlap) ms", overlapTime);
+                benchmark.Sample("CPU(Descriptor writes)", descriptorWriteCount);
+                benchmark.Sample("CPU(Recorded command buffers)", recordCount);
+                if (cpuUpdateSystem != nullptr)
+                    benchmark.Sample("CPU(Update) ms", cpuUpdateTime / 1000000.0);
+                if (barnesHut)
+                {
+                    benchmark.Sample("GPU(Tree build) ms", treeBuildTime);
+                    benchmark.Sample("GPU(Tree traverse) ms", treeTraverseTime);
+                }
+                else if (gravitationalConstant > 0.f && computeTime > 0.f)
+                {
+                    // Every grid particle interacts with every other, including itself. Lower bound, compute time includes other passes.
+                    double particleCount = (double)lenX * lenY;
+                    double interactionsPerSecond = particleCount * particleCount / (computeTime / 1000.0);
+                    benchmark.Sample("GPU(Gravity) interactions/s", interactionsPerSecond);
+                    if (inputManager.KeyPressed(GLFW_KEY_F2))
+                        std::cout << "GPU(Gravity) : " << interactionsPerSecond / 1e9 << " billion interactions/s" << std::endl;
+                }
+                if (benchmark.EndFrame())
+                    renderer.Close();
             }
             // --- PROFILING --- //
         }
+
+        // +++ VERIFY +++ //
+        // Newest particles are held by input buffers, owned by compute queue after render of last frame.
+        if (verifyFrameCount > 0)
+        {
+            vkDeviceWaitIdle(device);
+            std::vector<uint32_t> indexList, referenceIndexList, snapshotIndexList;
+            std::vector<Particle> particleList, referenceParticleList, snapshotParticleList;
+            scene.ReadParticles(computeCommandPool, computeQueue, indexList, particleList);
+            if (referenceUpdateSystem != nullptr)
+            {
+                for (unsigned int i = 0; i < frameIndex; ++i)
+                    referenceUpdateSystem->Update(VK_NULL_HANDLE, &scene, VERIFY_DT, i);
+                referenceUpdateSystem->GetParticles(referenceIndexList, referenceParticleList);
+            }
+            else
+            {
+                // Particles are loaded in slot order.
+                referenceParticleList = verifyParticleList;
+                for (uint32_t i = 0; i < referenceParticleList.size(); ++i)
+                    referenceIndexList.push_back(i);
+                for (unsigned int i = 0; i < frameIndex; ++i)
+                    ParticleUpdateSystem::UpdateFluidCPU(referenceIndexList, referenceParticleList, fluidParameters, integrator, VERIFY_DT);
+            }
+
+            // Neighbor sums of fluid are accumulated in another order on GPU.
+            GoldenState goldenState = fluid ? GoldenState(1e-3f, 1024) : GoldenState();
+            std::string updateName = cpuUpdate ? "CPU update" : "GPU update";
+            bool verified = goldenState.Compare(updateName + " vs CPU reference, " + std::to_string(frameIndex) + " frames", indexList, particleList, referenceIndexList, referenceParticleList);
+            if (GoldenState::Load(verifySnapshotPath, snapshotIndexList, snapshotParticleList))
+                verified = goldenState.Compare(updateName + " vs " + verifySnapshotPath, indexList, particleList, snapshotIndexList, snapshotParticleList) && verified;
+            else if (GoldenState::Save(verifySnapshotPath, indexList, particleList))
+                std::cout << "Golden state snapshot written: " << verifySnapshotPath << std::endl;
+            else
+                std::cout << "Golden state snapshot not written: " << verifySnapshotPath << std::endl;
+            exitCode = verified ? 0 : 1;
+        }
+        // --- VERIFY --- //
     }
     // --- MAIN LOOP --- //
 
     // +++ SHUTDOWN +++ //
-    vkTools::WaitQueue(renderer.mPresentQueue);
-    vkTools::WaitQueue(graphicsQueue);
-    vkTools::WaitQueue(computeQueue);
-    vkTools::FreeCommandBuffer(device, graphicsCommandPool, graphicsCommandBuffer);
-    vkTools::FreeCommandBuffer(device, computeCommandPool, computeCommandBuffer);
-    //vkDestroySemaphore(device, graphicsCompleteSemaphore, nullptr);
-    //vkDestroySemaphore(device, computeCompleteSemaphore, nullptr);
+    vkDeviceWaitIdle(device);
+    for (FrameSlot& frame : frameSlotList)
+    {
+        vkTools::FreeCommandBuffer(device, frame.computeCommandPool, frame.computeCommandBuffer);
+        vkTools::FreeCommandBuffer(device, frame.graphicsCommandPool, frame.graphicsCommandBuffer);
+        vkDestroyCommandPool(device, frame.computeCommandPool, nullptr);
+        vkDestroyCommandPool(device, frame.graphicsCommandPool, nullptr);
+        vkDestroyFence(device, frame.computeFence, nullptr);
+        vkDestroyFence(device, frame.graphicsFence, nullptr);
+        delete frame.computeTimer;
+        delete frame.graphicsTimer;
+        delete frame.treeBuildTimer;
+        delete frame.treeTraverseTimer;
+    }
+    delete cpuUpdateSystem;
+    delete referenceUpdateSystem;
+    delete particleStatistics;
+    delete distanceField;
+    delete noiseField;
+    delete vortexField;
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        vkDestroySemaphore(device, computeCompleteSemaphore[i], nullptr);
+        vkDestroySemaphore(device, graphicsCompleteSemaphore[i], nullptr);
+    }
+    vkDestroySemaphore(device, renderCompleteSemaphore, nullptr);
+    vkDestroySemaphore(device, frameBufferCopiedSemaphore, nullptr);
     // --- SHUTDOWN --- //
 
-    return 0;
+    return exitCode;
 }
@@ -2,4 +2,22 @@ glslangValidator.exe -V Particles_Render_VS.vert -o Particles_Render_VS.spv
 glslangValidator.exe -V Particles_Render_GS.geom -o Particles_Render_GS.spv
 glslangValidator.exe -V Particles_Render_PS.frag -o Particles_Render_PS.spv
 glslangValidator.exe -V Particles_Update_CS.comp -o Particles_Update_CS.spv
+glslangValidator.exe -V Particles_Prepare_CS.comp -o Particles_Prepare_CS.spv
+glslangValidator.exe -V Particles_Emit_CS.comp -o Particles_Emit_CS.spv
+glslangValidator.exe -V Particles_Grid_CS.comp -o Particles_Grid_CS.spv
+glslangValidator.exe -V PrefixSum_CS.comp -o PrefixSum_CS.spv
+glslangValidator.exe -V RadixSort_CS.comp -o RadixSort_CS.spv
+glslangValidator.exe -V Particles_Morton_CS.comp -o Particles_Morton_CS.spv
+glslangValidator.exe -V Particles_Fluid_CS.comp -o Particles_Fluid_CS.spv
+glslangValidator.exe -V Particles_Gravity_CS.comp -o Particles_Gravity_CS.spv
+glslangValidator.exe -V Particles_BarnesHut_CS.comp -o Particles_BarnesHut_CS.spv
+glslangValidator.exe -V Particles_Statistics_CS.comp -o Particles_Statistics_CS.spv
+glslangValidator.exe -V Particles_Render_Quad_VS.vert -o Particles_Render_Quad_VS.spv
+glslangValidator.exe -V Particles_Cull_CS.comp -o Particles_Cull_CS.spv
+glslangValidator.exe -V Particles_Render_Point_VS.vert -o Particles_Render_Point_VS.spv
+glslangValidator.exe -V Particles_Render_Point_PS.frag -o Particles_Render_Point_PS.spv
+glslangValidator.exe -V Particles_Splat_CS.comp -o Particles_Splat_CS.spv
+glslangValidator.exe -V Particles_Splat_Resolve_VS.vert -o Particles_Splat_Resolve_VS.spv
+glslangValidator.exe -V Particles_Splat_Resolve_PS.frag -o Particles_Splat_Resolve_PS.spv
+glslangValidator.exe -V Particles_Tile_CS.comp -o Particles_Tile_CS.spv
 pause
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 450
+
+layout(early_fragment_tests) in;
+
+// Input, color and weight of additive blend.
+layout(location = 0) in vec4 PSInput;
+
+// Output.
+layout(location = 0) out vec4 PSOutput0;
+
+void main()
+{
+    PSOutput0 = PSInput;
+}
@@ -0,0 +1,58 @@
+#version 450
+
+struct Particle
+{
+    vec4 position;
+    vec4 velocity;
+    vec4 color;
+    vec4 scale;
+};
+layout(binding = 0) buffer VSInput { Particle g_Input[]; };
+
+// Visible indices, points from first vertex of draw.
+layout(binding = 1) buffer VSAlive { uint g_Alive[]; };
+
+// Structure of arrays layout, set by specialization constant.
+layout(constant_id = 0) const bool PARTICLE_LAYOUT_SOA = false;
+layout(binding = 2) buffer VSPosition { vec4 g_Positions[]; };
+layout(binding = 3) buffer VSColor { vec4 g_Colors[]; };
+layout(binding = 4) buffer VSScale { vec4 g_Scales[]; };
+
+// Meta data.
+struct MetaData
+{
+    mat4 vpMatrix;
+    vec4 lensPosition;
+    vec4 lensUpDirection;
+    vec4 lodParameters;
+};
+// Meta data, pushed with each draw, or read from uniform ring by command buffers recorded once. Set by specialization constant.
+layout(constant_id = 1) const bool META_DATA_BUFFER = false;
+layout(push_constant) uniform VSMetaData { MetaData g_MetaData; };
+layout(binding = 5) uniform VSMetaDataBuffer { MetaData g_MetaDataBuffer; };
+
+// Mean of pixel shader falloff over quad.
+#define MEAN_FALLOFF 0.1488f
+
+// Color and weight of additive blend.
+layout(location = 0) out vec4 VSOutput;
+
+// Single pixel point of particle smaller than a pixel, weighted by its coverage so blended energy matches its quad.
+void main()
+{
+    MetaData metaData = META_DATA_BUFFER ? g_MetaDataBuffer : g_MetaData;
+    mat4 vpMatrix = metaData.vpMatrix;
+    vec4 lodParameters = metaData.lodParameters;
+
+    uint index = g_Alive[gl_VertexIndex];
+    vec3 worldPosition = PARTICLE_LAYOUT_SOA ? g_Positions[index].xyz : g_Input[index].position.xyz;
+    vec3 color = PARTICLE_LAYOUT_SOA ? g_Colors[index].xyz : g_Input[index].color.xyz;
+    vec2 scale = PARTICLE_LAYOUT_SOA ? g_Scales[index].xy : g_Input[index].scale.xy;
+
+    gl_Position = vec4(worldPosition, 1.f) * vpMatrix;
+    vec2 extents = scale * vec2(length(vpMatrix[0].xyz), length(vpMatrix[1].xyz)) * lodParameters.xy / gl_Position.w;
+    gl_Position.y = -gl_Position.y;
+    gl_PointSize = 1.f;
+
+    VSOutput = vec4(color, MEAN_FALLOFF * min(extents.x * extents.y, 1.f));
+}
@@ -0,0 +1,74 @@
+#version 450
+
+struct Particle
+{
+    vec4 position;
+    vec4 velocity;
+    vec4 color;
+    vec4 scale;
+};
+layout(binding = 0) buffer VSInput { Particle g_Input[]; };
+
+// Alive indices.
+layout(binding = 1) buffer VSAlive { uint g_Alive[]; };
+
+// Structure of arrays layout, set by specialization constant.
+layout(constant_id = 0) const bool PARTICLE_LAYOUT_SOA = false;
+layout(binding = 2) buffer VSPosition { vec4 g_Positions[]; };
+layout(binding = 3) buffer VSColor { vec4 g_Colors[]; };
+layout(binding = 4) buffer VSScale { vec4 g_Scales[]; };
+
+// Meta data.
+struct MetaData
+{
+    mat4 vpMatrix;
+    vec4 lensPosition;
+    vec4 lensUpDirection;
+    vec4 lodParameters;
+};
+// Meta data, pushed with each draw, or read from uniform ring by command buffers recorded once. Set by specialization constant.
+layout(constant_id = 1) const bool META_DATA_BUFFER = false;
+layout(push_constant) uniform VSMetaData { MetaData g_MetaData; };
+layout(binding = 5) uniform VSMetaDataBuffer { MetaData g_MetaDataBuffer; };
+
+// Output, as output of geometry shader.
+struct VSOutputStruct
+{
+    vec4 position;
+    vec3 worldPosition;
+    vec3 color;
+    vec2 uv;
+};
+layout(location = 0) out VSOutputStruct VSOutput;
+
+// Corner gl_VertexIndex of triangle strip quad of particle gl_InstanceIndex, pulled from buffers.
+void main()
+{
+    MetaData metaData = META_DATA_BUFFER ? g_MetaDataBuffer : g_MetaData;
+    mat4 vpMatrix = metaData.vpMatrix;
+    vec3 lensPosition = metaData.lensPosition.xyz;
+    vec3 lensUpDirection = metaData.lensUpDirection.xyz;
+
+    uint index = g_Alive[gl_InstanceIndex];
+    vec3 worldPosition = PARTICLE_LAYOUT_SOA ? g_Positions[index].xyz : g_Input[index].position.xyz;
+    vec3 color = PARTICLE_LAYOUT_SOA ? g_Colors[index].xyz : g_Input[index].color.xyz;
+    vec2 scale = PARTICLE_LAYOUT_SOA ? g_Scales[index].xy : g_Input[index].scale.xy;
+
+    vec3 particleFrontDirection = normalize(lensPosition - worldPosition);
+    vec3 paticleSideDirection = cross(particleFrontDirection, lensUpDirection);
+    vec3 paticleUpDirection = cross(paticleSideDirection, particleFrontDirection);
+
+    uint i = uint(gl_VertexIndex);
+    uint x = uint(i == 1 || i == 3);
+    uint y = uint(i == 0 || i == 1);
+
+    gl_Position.xyz = worldPosition + paticleSideDirection * (x * 2.f - 1.f) * scale.x + paticleUpDirection * (y * 2.f - 1.f) * scale.y;
+    gl_Position.w = 1.f;
+    VSOutput.position = gl_Position;
+    VSOutput.worldPosition = gl_Position.xyz;
+    VSOutput.color = color;
+    VSOutput.uv = vec2(x, 1.f - y);
+
+    gl_Position = gl_Position * vpMatrix;
+    gl_Position.y = -gl_Position.y;
+}
@@ -9,9 +9,29 @@ struct Particle
 };
 layout(binding = 0) buffer VSInput { Particle g_Input[]; };
 
+// Alive indices.
+layout(binding = 1) buffer VSAlive { uint g_Alive[]; };
+
+// Structure of arrays layout, set by specialization constant. Velocity is not read.
+layout(constant_id = 0) const bool PARTICLE_LAYOUT_SOA = false;
+layout(binding = 2) buffer VSPosition { vec4 g_Positions[]; };
+layout(binding = 3) buffer VSColor { vec4 g_Colors[]; };
+layout(binding = 4) buffer VSScale { vec4 g_Scales[]; };
+
 layout(location = 0) out Particle VSOutput;
 
 void main()
 {
-    VSOutput = g_Input[gl_VertexIndex];
+    uint index = g_Alive[gl_VertexIndex];
+    if (PARTICLE_LAYOUT_SOA)
+    {
+        VSOutput.position = g_Positions[index];
+        VSOutput.velocity = vec4(0.f, 0.f, 0.f, 0.f);
+        VSOutput.color = g_Colors[index];
+        VSOutput.scale = g_Scales[index];
+    }
+    else
+    {
+        VSOutput = g_Input[index];
+    }
 }
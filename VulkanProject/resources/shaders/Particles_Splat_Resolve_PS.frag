@@ -0,0 +1,21 @@
+#version 450
+
+// Width of frame buffer in pixels.
+layout(constant_id = 0) const uint FRAME_WIDTH = 1;
+
+// Red, green and blue of each pixel in 1 / COLOR_SCALE units, accumulated by splatting pass.
+layout(binding = 0) buffer PSAccumulation { uint g_Accumulation[]; };
+
+// Fixed point scale of accumulated color.
+#define COLOR_SCALE 4096.f
+
+// Output, added to frame buffer.
+layout(location = 0) out vec4 PSOutput0;
+
+void main()
+{
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    uint offset = (pixel.y * FRAME_WIDTH + pixel.x) * 3;
+    vec3 color = vec3(g_Accumulation[offset], g_Accumulation[offset + 1], g_Accumulation[offset + 2]) / COLOR_SCALE;
+    PSOutput0 = vec4(color, 1.f);
+}
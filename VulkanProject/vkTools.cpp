@@ -6,6 +6,8 @@
 #include <Windows.h>
 #endif
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <fstream>
 #include <assert.h>
@@ -660,7 +662,7 @@ void vkTools::CopyBuffer( const VkCommandBuffer& command_buffer, VkBuffer src_bu
     vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &region);
 }
 
-void vkTools::CreateBuffer( const VkDevice& device, const VkPhysicalDevice& physical_device, std::size_t total_size, VkBufferUsageFlags buffer_usage_flags, VkMemoryPropertyFlags memory_property_flags, VkBuffer& buffer, VkDeviceMemory& buffer_memory, uint32_t& min_offset_alignment )
+void vkTools::CreateBuffer( const VkDevice& device, const VkPhysicalDevice& physical_device, std::size_t total_size, VkBufferUsageFlags buffer_usage_flags, VkMemoryPropertyFlags memory_property_flags, VkBuffer& buffer, VkDeviceMemory& buffer_memory, uint32_t& min_offset_alignment, const std::vector<uint32_t>& queue_family_index_list )
 {
     VkPhysicalDeviceProperties physical_device_proterties;
     vkGetPhysicalDeviceProperties(physical_device, &physical_device_proterties);
@@ -677,6 +679,16 @@ void vkTools::CreateBuffer( const VkDevice& device, const VkPhysicalDevice& phys
     buffer_create_info.size = total_size;
     buffer_create_info.usage = buffer_usage_flags;
     buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    std::vector<uint32_t> unique_queue_family_index_list;
+    for (uint32_t queue_family_index : queue_family_index_list)
+        if (std::find(unique_queue_family_index_list.begin(), unique_queue_family_index_list.end(), queue_family_index) == unique_queue_family_index_list.end())
+            unique_queue_family_index_list.push_back(queue_family_index);
+    if (unique_queue_family_index_list.size() > 1)
+    {
+        buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_create_info.queueFamilyIndexCount = (uint32_t)unique_queue_family_index_list.size();
+        buffer_create_info.pQueueFamilyIndices = unique_queue_family_index_list.data();
+    }
     vkTools::VkErrorCheck(vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer));
 
     {
@@ -695,6 +707,47 @@ void vkTools::CreateBuffer( const VkDevice& device, const VkPhysicalDevice& phys
 }
 
 
+void vkTools::PipelineBarrier( const VkCommandBuffer& command_buffer, VkPipelineStageFlags src_stage_flags, VkAccessFlags src_access_flags, VkPipelineStageFlags dst_stage_flags, VkAccessFlags dst_access_flags )
+{
+    VkMemoryBarrier memory_barrier = {};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = src_access_flags;
+    memory_barrier.dstAccessMask = dst_access_flags;
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        src_stage_flags, dst_stage_flags,
+        0,
+        1, &memory_barrier,
+        0, nullptr,
+        0, nullptr
+    );
+}
+
+
+void vkTools::BufferBarrier( const VkCommandBuffer& command_buffer, VkBuffer buffer, VkPipelineStageFlags src_stage_flags, VkAccessFlags src_access_flags, VkPipelineStageFlags dst_stage_flags, VkAccessFlags dst_access_flags, uint32_t src_queue_family_index, uint32_t dst_queue_family_index )
+{
+    VkBufferMemoryBarrier buffer_memory_barrier = {};
+    buffer_memory_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_memory_barrier.srcAccessMask = src_access_flags;
+    buffer_memory_barrier.dstAccessMask = dst_access_flags;
+    buffer_memory_barrier.srcQueueFamilyIndex = src_queue_family_index;
+    buffer_memory_barrier.dstQueueFamilyIndex = dst_queue_family_index;
+    buffer_memory_barrier.buffer = buffer;
+    buffer_memory_barrier.offset = 0;
+    buffer_memory_barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        src_stage_flags, dst_stage_flags,
+        0,
+        0, nullptr,
+        1, &buffer_memory_barrier,
+        0, nullptr
+    );
+}
+
+
 VkCommandBuffer vkTools::BeginSingleTimeCommand( const VkDevice& device, const VkCommandPool& command_pool ) {
     VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
     command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -739,6 +792,38 @@ void vkTools::CreateVkSemaphore(const VkDevice& device, VkSemaphore& semaphore)
     vkTools::VkErrorCheck(vkCreateSemaphore(device, &semaphore_create_info, nullptr, &semaphore));
 }
 
+void vkTools::CreateFence(const VkDevice& device, VkFence& fence, bool signaled)
+{
+    VkFenceCreateInfo fence_create_info;
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_create_info.pNext = NULL;
+    fence_create_info.flags = signaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0;
+
+    vkTools::VkErrorCheck(vkCreateFence(device, &fence_create_info, nullptr, &fence));
+}
+
+void vkTools::WaitFence(const VkDevice& device, const VkFence& fence, bool reset)
+{
+    VkErrorCheck(vkWaitForFences(device, 1, &fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()));
+    if (reset)
+        VkErrorCheck(vkResetFences(device, 1, &fence));
+}
+
+void vkTools::CreateCommandPool(const VkDevice& device, uint32_t queue_family_index, VkCommandPoolCreateFlags command_pool_create_flags, VkCommandPool& command_pool)
+{
+    VkCommandPoolCreateInfo command_pool_create_info = {};
+    command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.flags = command_pool_create_flags;
+    command_pool_create_info.queueFamilyIndex = queue_family_index;
+
+    VkErrorCheck(vkCreateCommandPool(device, &command_pool_create_info, nullptr, &command_pool));
+}
+
+void vkTools::ResetCommandPool(const VkDevice& device, const VkCommandPool& command_pool)
+{
+    VkErrorCheck(vkResetCommandPool(device, command_pool, 0));
+}
+
 void vkTools::CreateCommandBuffer(const VkDevice& device, const VkCommandPool& command_pool, const VkCommandBufferLevel command_buffer_level, VkCommandBuffer& command_buffer)
 {
     VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
@@ -775,19 +860,21 @@ void vkTools::EndCommandBuffer( const VkCommandBuffer& command_buffer ) {
 }
 
 
-void vkTools::QueueSubmit(const VkQueue& queue, const std::vector<VkCommandBuffer>& command_buffer_list, const std::vector<VkSemaphore>& signal_semaphore_list, VkPipelineStageFlags wait_dst_stage_flags, const std::vector<VkSemaphore>& wait_semaphore_list ) {
+void vkTools::QueueSubmit(const VkQueue& queue, const std::vector<VkCommandBuffer>& command_buffer_list, const std::vector<VkSemaphore>& signal_semaphore_list, VkPipelineStageFlags wait_dst_stage_flags, const std::vector<VkSemaphore>& wait_semaphore_list, VkFence fence ) {
     VkSubmitInfo submit_info;
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit_info.pNext = NULL;
+    // Every semaphore is waited at the same stage.
+    std::vector<VkPipelineStageFlags> wait_dst_stage_flags_list(wait_semaphore_list.size(), wait_dst_stage_flags);
     submit_info.waitSemaphoreCount = wait_semaphore_list.size();
     submit_info.pWaitSemaphores = wait_semaphore_list.data();
-    submit_info.pWaitDstStageMask = &wait_dst_stage_flags;
+    submit_info.pWaitDstStageMask = wait_dst_stage_flags_list.data();
     submit_info.commandBufferCount = command_buffer_list.size();
     submit_info.pCommandBuffers = command_buffer_list.data();
     submit_info.signalSemaphoreCount = signal_semaphore_list.size();
     submit_info.pSignalSemaphores = signal_semaphore_list.data();
 
-    VkErrorCheck(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    VkErrorCheck(vkQueueSubmit(queue, 1, &submit_info, fence));
 }
 
 
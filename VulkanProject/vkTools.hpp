@@ -64,17 +64,27 @@ namespace vkTools
 
     void WriteBuffer(const VkCommandBuffer& command_buffer, VkDevice device, VkDeviceMemory src_buffer_memory, void* data, std::uint32_t byte_size, std::uint32_t byte_offset);
     void CopyBuffer( const VkCommandBuffer& command_buffer, VkBuffer src_buffer, VkBuffer dst_buffer, std::uint32_t byte_size, std::uint32_t src_byte_offset, std::uint32_t dst_byte_offset );
-    void CreateBuffer( const VkDevice& device, const VkPhysicalDevice& physical_device, std::size_t total_size, VkBufferUsageFlags buffer_usage_flags, VkMemoryPropertyFlags memory_property_flags, VkBuffer& buffer, VkDeviceMemory& buffer_memory, uint32_t& min_offset_alignment );
+    // Buffer is shared concurrently when queue_family_index_list holds more than one distinct family, exclusive otherwise.
+    void CreateBuffer( const VkDevice& device, const VkPhysicalDevice& physical_device, std::size_t total_size, VkBufferUsageFlags buffer_usage_flags, VkMemoryPropertyFlags memory_property_flags, VkBuffer& buffer, VkDeviceMemory& buffer_memory, uint32_t& min_offset_alignment, const std::vector<uint32_t>& queue_family_index_list = {} );
+    void PipelineBarrier( const VkCommandBuffer& command_buffer, VkPipelineStageFlags src_stage_flags, VkAccessFlags src_access_flags, VkPipelineStageFlags dst_stage_flags, VkAccessFlags dst_access_flags );
+    // Barrier of whole buffer. Transfers ownership when queue families differ, recorded as release on source queue and acquire on destination queue.
+    void BufferBarrier( const VkCommandBuffer& command_buffer, VkBuffer buffer, VkPipelineStageFlags src_stage_flags, VkAccessFlags src_access_flags, VkPipelineStageFlags dst_stage_flags, VkAccessFlags dst_access_flags, uint32_t src_queue_family_index = VK_QUEUE_FAMILY_IGNORED, uint32_t dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED );
 
     VkCommandBuffer BeginSingleTimeCommand( const VkDevice& device, const VkCommandPool& command_pool );
     void EndSingleTimeCommand( const VkDevice& device, const VkCommandPool& command_pool, const VkQueue& queue, const VkCommandBuffer& command_buffer );
 
     void CreateVkSemaphore(const VkDevice& device, VkSemaphore& semaphore);
+    void CreateFence(const VkDevice& device, VkFence& fence, bool signaled = false);
+    // Wait for fence on CPU, and reset it unless it is waited again before next submit.
+    void WaitFence(const VkDevice& device, const VkFence& fence, bool reset = true);
+    void CreateCommandPool(const VkDevice& device, uint32_t queue_family_index, VkCommandPoolCreateFlags command_pool_create_flags, VkCommandPool& command_pool);
+    // Reset every command buffer allocated from pool. None may be pending execution.
+    void ResetCommandPool(const VkDevice& device, const VkCommandPool& command_pool);
     void CreateCommandBuffer(const VkDevice& device, const VkCommandPool& command_pool, const VkCommandBufferLevel command_buffer_level, VkCommandBuffer& command_buffer);
     void BeginCommandBuffer(const VkCommandBufferUsageFlags command_buffer_useage_flags, const VkCommandBuffer& command_buffer);
     void BeginCommandBuffer(const VkCommandBufferUsageFlags command_buffer_useage_flags, const VkCommandBufferInheritanceInfo command_buffer_inheritance_info, const VkCommandBuffer& command_buffer);
     void EndCommandBuffer( const VkCommandBuffer& command_buffer );
-    void QueueSubmit(const VkQueue& queue, const std::vector<VkCommandBuffer>& command_buffer_list = {}, const std::vector<VkSemaphore>& signal_semaphore_list = {}, VkPipelineStageFlags wait_dst_stage_flags = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, const std::vector<VkSemaphore>& wait_semaphore_list = {} );
+    void QueueSubmit(const VkQueue& queue, const std::vector<VkCommandBuffer>& command_buffer_list = {}, const std::vector<VkSemaphore>& signal_semaphore_list = {}, VkPipelineStageFlags wait_dst_stage_flags = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, const std::vector<VkSemaphore>& wait_semaphore_list = {}, VkFence fence = VK_NULL_HANDLE );
     void WaitQueue(const VkQueue& queue );
     void ResetCommandBuffer( VkCommandBuffer& command_buffer );
     void FreeCommandBuffer( const VkDevice& device, const VkCommandPool& command_pool, const VkCommandBuffer& command_buffer );